@@ -0,0 +1,38 @@
+#pragma once
+
+#include <defines.h>
+#include <platform/platform.h>
+
+// Keeps the optimizer from discarding a value computed by a benchmark.
+template <typename T> inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Timer {
+  f64 start = hn::platform::get_system_time();
+
+  [[nodiscard]] f64 elapsed() const { return hn::platform::get_system_time() - start; }
+};
+
+/**
+ * Prints a single result line.
+ * @param name The name of the measured case.
+ * @param operations The number of operations performed.
+ * @param seconds The time the operations took.
+ */
+void report(const char *name, u64 operations, f64 seconds);
+
+// Reports a failed correctness check; the run then exits with a non-zero status.
+void fail(const char *message);
+
+// Benchmarks, one per engine module.
+
+void bench_bvh();
+void bench_darray();
+void bench_ecs();
+void bench_event();
+void bench_hash_map();
+void bench_job();
+void bench_math();
+void bench_memory();
+void bench_resource();
@@ -0,0 +1,145 @@
+#include "bench.h"
+#include <core/memory.h>
+#include <cstdio>
+#include <scene/bvh.h>
+
+// 100K randomly moving objects: per-frame updates, box, sphere and frustum queries against a
+// linear scan, and full rebuilds.
+
+using namespace hn::math;
+using namespace hn::scene;
+
+static const u32 object_count = 100000;
+static const u32 frame_count  = 120;
+static const u32 query_count  = 1000;
+static const f32 world_size   = 1000.0f;
+static const f32 step         = 1.0f / 60.0f;
+
+struct Object {
+  vec3 position;
+  vec3 velocity;
+  f32  radius;
+};
+
+static u32 state = 1;
+
+static f32 random_f32(f32 low, f32 high) {
+  state = state * 1664525 + 1013904223;
+  return low + (high - low) * (f32)(state >> 8) / (f32)(1 << 24);
+}
+
+static vec3 random_position() {
+  return {random_f32(0, world_size), random_f32(0, world_size), random_f32(0, world_size)};
+}
+
+static Aabb bounds_of(const Object &object) {
+  vec3 extent = {object.radius, object.radius, object.radius};
+  return {object.position - extent, object.position + extent};
+}
+
+static void bench_queries(const char *label, const Bvh &bvh, u32 *results) {
+  char name[64];
+  u64  found = 0;
+
+  Timer timer;
+  for (u32 i = 0; i < query_count; ++i) {
+    vec3 corner = random_position();
+    found += bvh_query_box(bvh, {corner, corner + vec3{20, 20, 20}}, results, object_count);
+  }
+  snprintf(name, sizeof(name), "%s box query, %llu hits", label, found / query_count);
+  report(name, query_count, timer.elapsed());
+
+  found = 0;
+  timer = Timer{};
+  for (u32 i = 0; i < query_count; ++i) {
+    found += bvh_query_sphere(bvh, random_position(), 25, results, object_count);
+  }
+  snprintf(name, sizeof(name), "%s sphere query, %llu hits", label, found / query_count);
+  report(name, query_count, timer.elapsed());
+
+  // Cameras on the world's edge looking across it.
+  const u32 frustum_count = query_count / 10;
+  mat4      projection    = mat4_perspective(1.0f, 16.0f / 9.0f, 0.1f, 300.0f);
+  found                   = 0;
+  timer                   = Timer{};
+  for (u32 i = 0; i < frustum_count; ++i) {
+    vec3 eye = {random_f32(0, world_size), random_f32(0, world_size), 0};
+    mat4 view = mat4_look_at(eye, random_position(), {0, 1, 0});
+    found += bvh_query_frustum(bvh, frustum_from_matrix(projection * view), results, object_count);
+  }
+  snprintf(name, sizeof(name), "%s frustum query, %llu hits", label, found / frustum_count);
+  report(name, frustum_count, timer.elapsed());
+}
+
+void bench_bvh() {
+  auto objects = (Object *)hn::mem::allocate(object_count * sizeof(Object), hn::mem::TagArray);
+  auto bounds  = (Aabb *)hn::mem::allocate(object_count * sizeof(Aabb), hn::mem::TagArray);
+  auto items   = (u32 *)hn::mem::allocate(object_count * sizeof(u32), hn::mem::TagArray);
+  auto proxies = (ProxyId *)hn::mem::allocate(object_count * sizeof(ProxyId), hn::mem::TagArray);
+  auto results = (u32 *)hn::mem::allocate(object_count * sizeof(u32), hn::mem::TagArray);
+  for (u32 i = 0; i < object_count; ++i) {
+    objects[i] = {random_position(),
+                  {random_f32(-10, 10), random_f32(-10, 10), random_f32(-10, 10)},
+                  random_f32(0.5f, 2.0f)};
+    bounds[i]  = bounds_of(objects[i]);
+    items[i]   = i;
+  }
+  char name[64];
+
+  Bvh bvh;
+  bvh_create(bvh);
+  Timer timer;
+  for (u32 i = 0; i < object_count; ++i) {
+    proxies[i] = bvh_insert(bvh, bounds[i], i);
+  }
+  snprintf(name, sizeof(name), "insert 100K, cost %.0f", bvh_cost(bvh));
+  report(name, object_count, timer.elapsed());
+  bvh_destroy(bvh);
+
+  bvh_create(bvh);
+  timer = Timer{};
+  bvh_insert_bulk(bvh, bounds, items, object_count, proxies);
+  snprintf(name, sizeof(name), "bulk insert 100K, cost %.0f", bvh_cost(bvh));
+  report(name, object_count, timer.elapsed());
+  bench_queries("rebuilt,", bvh, results);
+
+  // A linear scan for reference.
+  timer     = Timer{};
+  u64 found = 0;
+  for (u32 i = 0; i < query_count / 10; ++i) {
+    vec3 corner = random_position();
+    Aabb box    = {corner, corner + vec3{20, 20, 20}};
+    for (u32 k = 0; k < object_count; ++k) {
+      found += overlaps(bvh.nodes[proxies[k]].bounds, box);
+    }
+  }
+  snprintf(name, sizeof(name), "linear scan box query, %llu hits", found / (query_count / 10));
+  report(name, query_count / 10, timer.elapsed());
+
+  timer     = Timer{};
+  u64 moved = 0;
+  for (u32 frame = 0; frame < frame_count; ++frame) {
+    for (u32 i = 0; i < object_count; ++i) {
+      Object &object  = objects[i];
+      object.position = object.position + object.velocity * step;
+      moved += bvh_move(bvh, proxies[i], bounds_of(object));
+    }
+    bvh_refit(bvh);
+  }
+  snprintf(name, sizeof(name), "move + refit, %llu%% moved, cost %.0f",
+           moved * 100 / ((u64)object_count * frame_count), bvh_cost(bvh));
+  report(name, (u64)object_count * frame_count, timer.elapsed());
+  bench_queries("after moves,", bvh, results);
+
+  timer = Timer{};
+  bvh_rebuild(bvh);
+  snprintf(name, sizeof(name), "rebuild 100K, cost %.0f", bvh_cost(bvh));
+  report(name, object_count, timer.elapsed());
+
+  bvh_destroy(bvh);
+  hn::mem::free(results, object_count * sizeof(u32), hn::mem::TagArray);
+  hn::mem::free(proxies, object_count * sizeof(ProxyId), hn::mem::TagArray);
+  hn::mem::free(items, object_count * sizeof(u32), hn::mem::TagArray);
+  hn::mem::free(bounds, object_count * sizeof(Aabb), hn::mem::TagArray);
+  hn::mem::free(objects, object_count * sizeof(Object), hn::mem::TagArray);
+}
@@ -0,0 +1,92 @@
+#include "bench.h"
+#include <container/darray.h>
+#include <container/darray_t.h>
+
+// Push/iterate/erase on the macro darray versus hn::DArray<T>.
+
+static const u64 element_count = 1000000;
+static const u64 erase_count   = 200;
+
+struct Particle {
+  f32 x, y, z;
+  f32 vx, vy, vz;
+};
+
+static void bench_macro() {
+  Timer timer;
+  auto  particles = (Particle *)darray_create(Particle);
+  for (u64 i = 0; i < element_count; ++i) {
+    darray_push(particles, (Particle{(f32)i, 0, 0, 1, 1, 1}));
+  }
+  report("macro darray push", element_count, timer.elapsed());
+
+  timer   = Timer{};
+  f32 sum = 0;
+  for (u64 i = 0; i < darray_length(particles); ++i) {
+    sum += particles[i].x + particles[i].vx;
+  }
+  do_not_optimize(sum);
+  report("macro darray iterate", element_count, timer.elapsed());
+
+  timer = Timer{};
+  Particle popped{};
+  for (u64 i = 0; i < erase_count; ++i) {
+    darray_pop_at(particles, (i * 7919) % darray_length(particles), &popped);
+  }
+  report("macro darray erase (ordered)", erase_count, timer.elapsed());
+
+  darray_destroy(particles);
+}
+
+static void bench_template() {
+  Timer                timer;
+  hn::DArray<Particle> particles;
+  for (u64 i = 0; i < element_count; ++i) {
+    particles.emplace_back(Particle{(f32)i, 0, 0, 1, 1, 1});
+  }
+  report("DArray<T> emplace_back", element_count, timer.elapsed());
+
+  timer   = Timer{};
+  f32 sum = 0;
+  for (const auto &particle : particles) {
+    sum += particle.x + particle.vx;
+  }
+  do_not_optimize(sum);
+  report("DArray<T> iterate", element_count, timer.elapsed());
+
+  timer = Timer{};
+  for (u64 i = 0; i < erase_count; ++i) {
+    particles.remove((i * 7919) % particles.size());
+  }
+  report("DArray<T> erase (ordered)", erase_count, timer.elapsed());
+
+  timer = Timer{};
+  for (u64 i = 0; i < erase_count; ++i) {
+    particles.swap_remove((i * 7919) % particles.size());
+  }
+  report("DArray<T> swap_remove", erase_count, timer.elapsed());
+
+  timer = Timer{};
+  hn::DArray<Particle> bulk;
+  bulk.resize_uninitialized(element_count);
+  for (u64 i = 0; i < element_count; ++i) {
+    bulk[i] = Particle{(f32)i, 0, 0, 1, 1, 1};
+  }
+  report("DArray<T> resize_uninitialized + fill", element_count, timer.elapsed());
+
+  timer = Timer{};
+  hn::DArray<u32, 16> small;
+  for (u64 i = 0; i < element_count; ++i) {
+    small.clear();
+    for (u32 j = 0; j < 16; ++j) {
+      small.push_back(j);
+    }
+  }
+  do_not_optimize(small[15]);
+  report("DArray<T, 16> inline push x16", element_count * 16, timer.elapsed());
+}
+
+void bench_darray() {
+  bench_macro();
+  bench_template();
+}
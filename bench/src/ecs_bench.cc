@@ -0,0 +1,177 @@
+#include "bench.h"
+#include <core/job.h>
+#include <core/memory.h>
+#include <cstdio>
+#include <ecs/ecs.h>
+#include <thread>
+
+// Iterating 1M entities through queries of 2, 3 and 4 components, single-threaded and across the
+// job system, against the array-of-structs object list games keep today; plus bulk creation and
+// deferred destruction.
+
+static const u32 entity_count = 1000000;
+static const u32 iterations   = 20;
+static const f32 step         = 1.0f / 60.0f;
+
+struct Position {
+  f32 x, y, z;
+};
+
+struct Velocity {
+  f32 x, y, z;
+};
+
+struct Acceleration {
+  f32 x, y, z;
+};
+
+struct Lifetime {
+  f32 remaining;
+};
+
+// A typical game object: the simulated fields next to everything else it carries.
+struct GameObject {
+  Position     position;
+  Velocity     velocity;
+  Acceleration acceleration;
+  Lifetime     lifetime;
+  f32          rotation[4];
+  f32          scale[3];
+  u32          flags;
+  void        *mesh;
+  void        *material;
+  char         name[32];
+};
+
+static void integrate_position(const hn::ecs::ChunkView &chunk, void *data) {
+  auto position = chunk.get<Position>();
+  auto velocity = chunk.get<Velocity>();
+  for (u32 i = 0; i < chunk.count; ++i) {
+    position[i].x += velocity[i].x * step;
+    position[i].y += velocity[i].y * step;
+    position[i].z += velocity[i].z * step;
+  }
+}
+
+static void integrate_velocity(const hn::ecs::ChunkView &chunk, void *data) {
+  auto position     = chunk.get<Position>();
+  auto velocity     = chunk.get<Velocity>();
+  auto acceleration = chunk.get<Acceleration>();
+  for (u32 i = 0; i < chunk.count; ++i) {
+    velocity[i].x += acceleration[i].x * step;
+    velocity[i].y += acceleration[i].y * step;
+    velocity[i].z += acceleration[i].z * step;
+    position[i].x += velocity[i].x * step;
+    position[i].y += velocity[i].y * step;
+    position[i].z += velocity[i].z * step;
+  }
+}
+
+static void integrate_all(const hn::ecs::ChunkView &chunk, void *data) {
+  integrate_velocity(chunk, data);
+  auto lifetime = chunk.get<Lifetime>();
+  for (u32 i = 0; i < chunk.count; ++i) {
+    lifetime[i].remaining -= step;
+  }
+}
+
+// Queues the entities whose lifetime ran out for destruction.
+static void expire(const hn::ecs::ChunkView &chunk, void *data) {
+  auto commands = (hn::ecs::CommandBuffer *)data;
+  auto lifetime = chunk.get<Lifetime>();
+  for (u32 i = 0; i < chunk.count; ++i) {
+    if (lifetime[i].remaining <= 0) {
+      hn::ecs::command_destroy(*commands, chunk.entities[i]);
+    }
+  }
+}
+
+static void fill(const hn::ecs::ChunkView &chunk, void *data) {
+  auto velocity     = chunk.get<Velocity>();
+  auto acceleration = chunk.get<Acceleration>();
+  auto lifetime     = chunk.get<Lifetime>();
+  auto next         = (u32 *)data;
+  for (u32 i = 0; i < chunk.count; ++i, ++*next) {
+    velocity[i]     = {1, 2, 3};
+    acceleration[i] = {0, -9.8f, 0};
+    // Every tenth entity expires in the destruction case.
+    lifetime[i] = {*next % 10 == 0 ? 0.0f : 100.0f};
+  }
+}
+
+static void run_query(const char *name, hn::ecs::World &world, const hn::ecs::Query &query,
+                      hn::ecs::PFN_chunk callback, bool parallel) {
+  u32   count = hn::ecs::count(world, query);
+  Timer timer;
+  for (u32 i = 0; i < iterations; ++i) {
+    if (parallel) {
+      hn::ecs::for_each_chunk_parallel(world, query, callback, nullptr);
+    } else {
+      hn::ecs::for_each_chunk(world, query, callback, nullptr);
+    }
+  }
+  report(name, (u64)count * iterations, timer.elapsed());
+}
+
+static void bench_array_of_structs() {
+  auto objects = (GameObject *)hn::mem::allocate(entity_count * sizeof(GameObject),
+                                                 hn::mem::TagArray);
+  for (u32 i = 0; i < entity_count; ++i) {
+    objects[i].velocity     = {1, 2, 3};
+    objects[i].acceleration = {0, -9.8f, 0};
+  }
+
+  Timer timer;
+  for (u32 k = 0; k < iterations; ++k) {
+    for (u32 i = 0; i < entity_count; ++i) {
+      GameObject &object = objects[i];
+      object.position.x += object.velocity.x * step;
+      object.position.y += object.velocity.y * step;
+      object.position.z += object.velocity.z * step;
+    }
+  }
+  do_not_optimize(objects[entity_count - 1].position);
+  report("array of structs, position += velocity", (u64)entity_count * iterations,
+         timer.elapsed());
+
+  hn::mem::free(objects, entity_count * sizeof(GameObject), hn::mem::TagArray);
+}
+
+void bench_ecs() {
+  using namespace hn::ecs;
+
+  World world;
+  world_create(world);
+
+  Timer timer;
+  create(world, signature<Position, Velocity, Acceleration, Lifetime>(), entity_count);
+  report("create 1M entities, 4 components", entity_count, timer.elapsed());
+  u32 next = 0;
+  for_each_chunk(world, Query{signature<Velocity, Acceleration, Lifetime>(), {}}, fill, &next);
+
+  bench_array_of_structs();
+  run_query("query 2 components", world, Query{signature<Position, Velocity>(), {}},
+            integrate_position, false);
+  run_query("query 3 components", world,
+            Query{signature<Position, Velocity, Acceleration>(), {}}, integrate_velocity, false);
+  run_query("query 4 components", world,
+            Query{signature<Position, Velocity, Acceleration, Lifetime>(), {}}, integrate_all,
+            false);
+
+  u32 threads = std::thread::hardware_concurrency();
+  hn::job::initialize(threads);
+  char name[64];
+  snprintf(name, sizeof(name), "query 4 components, %u threads", hn::job::get_thread_count());
+  run_query(name, world, Query{signature<Position, Velocity, Acceleration, Lifetime>(), {}},
+            integrate_all, true);
+
+  CommandBuffer commands;
+  timer = Timer{};
+  for_each_chunk_parallel(world, Query{signature<Lifetime>(), {}}, expire, &commands);
+  flush(world, commands);
+  snprintf(name, sizeof(name), "deferred destroy, %u left", world.entity_count);
+  report(name, entity_count / 10, timer.elapsed());
+  hn::job::terminate();
+
+  world_destroy(world);
+}
@@ -0,0 +1,145 @@
+#include "bench.h"
+#include <atomic>
+#include <core/event.h>
+#include <cstdio>
+#include <thread>
+
+// Immediate fire versus the deferred queue, listener table churn, and a multi-producer stress run
+// of post_from_thread.
+
+static const u16 bench_code     = 0x1234;
+static const u64 event_count    = 1000000;
+static const u32 producer_count = 8;
+static const u64 per_producer   = 250000;
+
+static u64 received = 0;
+
+static bool on_count(u16 code, void *sender, void *listener, const hn::event::Context &ctx) {
+  received++;
+  return false;
+}
+
+// Checks that each producer's events arrive exactly once and in order.
+struct ProducerCheck {
+  u64 next[producer_count];
+  u64 out_of_order;
+};
+
+static bool on_check(u16 code, void *sender, void *listener, const hn::event::Context &ctx) {
+  auto check    = (ProducerCheck *)listener;
+  u32  producer = ctx.data.u32[0];
+  u32  sequence = ctx.data.u32[1];
+  if (sequence != check->next[producer]) {
+    check->out_of_order++;
+  }
+  check->next[producer] = sequence + 1;
+  received++;
+  return false;
+}
+
+static void bench_single_thread() {
+  auto handle = hn::event::register_to_listen(bench_code, nullptr, on_count);
+
+  hn::event::Context ctx{};
+
+  received = 0;
+  Timer timer;
+  for (u64 i = 0; i < event_count; ++i) {
+    hn::event::fire(bench_code, nullptr, ctx);
+  }
+  report("fire", received, timer.elapsed());
+
+  received = 0;
+  timer    = Timer{};
+  for (u64 i = 0; i < event_count; ++i) {
+    if (!hn::event::post(bench_code, nullptr, ctx)) {
+      hn::event::dispatch();
+      hn::event::post(bench_code, nullptr, ctx);
+    }
+  }
+  hn::event::dispatch();
+  report("post + batched dispatch", received, timer.elapsed());
+
+  hn::event::unregister_from_listen(handle);
+}
+
+static void bench_listener_table() {
+  const u32                 listener_count = 64;
+  hn::event::ListenerHandle handles[listener_count];
+  for (u32 i = 0; i < listener_count; ++i) {
+    handles[i] = hn::event::register_to_listen(bench_code, nullptr, on_count, (i32)(i % 3));
+  }
+
+  received = 0;
+  Timer              timer;
+  hn::event::Context ctx{};
+  for (u64 i = 0; i < event_count / listener_count; ++i) {
+    hn::event::fire(bench_code, nullptr, ctx);
+  }
+  report("fire, 64 listeners (per listener call)", received, timer.elapsed());
+
+  timer = Timer{};
+  for (u64 i = 0; i < event_count; ++i) {
+    u32 slot = i % listener_count;
+    hn::event::unregister_from_listen(handles[slot]);
+    handles[slot] = hn::event::register_to_listen(bench_code, nullptr, on_count, (i32)(i % 3));
+  }
+  report("unregister + register, 64 listeners", event_count, timer.elapsed());
+
+  for (auto handle : handles) {
+    hn::event::unregister_from_listen(handle);
+  }
+}
+
+static void bench_producers() {
+  ProducerCheck check{};
+  auto          handle = hn::event::register_to_listen(bench_code, &check, on_check);
+
+  received = 0;
+  std::atomic<u64> retries{0};
+  Timer            timer;
+  std::thread      producers[producer_count];
+  for (u32 p = 0; p < producer_count; ++p) {
+    producers[p] = std::thread([p, &retries] {
+      hn::event::Context ctx{};
+      ctx.data.u32[0] = p;
+      for (u32 i = 0; i < per_producer; ++i) {
+        ctx.data.u32[1] = i;
+        while (!hn::event::post_from_thread(bench_code, nullptr, ctx)) {
+          retries.fetch_add(1, std::memory_order_relaxed);
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  const u64 expected = producer_count * per_producer;
+  while (received < expected) {
+    hn::event::dispatch();
+  }
+  f64 elapsed = timer.elapsed();
+  for (auto &producer : producers) {
+    producer.join();
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "post_from_thread, %u producers", producer_count);
+  report(name, received, elapsed);
+  printf("  %.2f M events/sec, %llu full-queue retries\n", received / elapsed / 1000000.0,
+         retries.load());
+  if (check.out_of_order > 0) {
+    char message[64];
+    snprintf(message, sizeof(message), "%llu events out of order", check.out_of_order);
+    fail(message);
+  }
+
+  hn::event::unregister_from_listen(handle);
+}
+
+void bench_event() {
+  hn::event::initialize();
+  bench_single_thread();
+  bench_listener_table();
+  bench_producers();
+  hn::event::terminate();
+}
@@ -0,0 +1,81 @@
+#include "bench.h"
+#include <container/hash_map.h>
+#include <core/memory.h>
+#include <cstdio>
+#include <unordered_map>
+
+// Insert, lookup (hit and miss) and erase of u64 keys in hn::HashMap from 1K to 10M entries,
+// against std::unordered_map up to 1M.
+
+static const u64 operations_per_case = 10000000;
+
+// Runs each case over enough rounds that small maps are timed over as many operations as large.
+template <typename Map> static void bench_map(const char *label, const u64 *keys,
+                                              const u64 *missing, u64 count) {
+  u64  rounds = operations_per_case / count > 1 ? operations_per_case / count : 1;
+  f64  insert = 0, hit = 0, miss = 0, erase = 0;
+  u64  found  = 0;
+  char name[64];
+
+  for (u64 round = 0; round < rounds; ++round) {
+    Map   map;
+    Timer timer;
+    for (u64 i = 0; i < count; ++i) {
+      map[keys[i]] = i;
+    }
+    insert += timer.elapsed();
+
+    // Hits in a different order than the inserts, so they do not walk memory sequentially.
+    timer = Timer{};
+    for (u64 i = 0; i < count; ++i) {
+      found += map.find(keys[(i * 7919) % count]) != map.end();
+    }
+    hit += timer.elapsed();
+
+    timer = Timer{};
+    for (u64 i = 0; i < count; ++i) {
+      found += map.find(missing[i]) != map.end();
+    }
+    miss += timer.elapsed();
+
+    timer = Timer{};
+    for (u64 i = 0; i < count; ++i) {
+      map.erase(keys[i]);
+    }
+    erase += timer.elapsed();
+  }
+  do_not_optimize(found);
+
+  const char *cases[]   = {"insert", "lookup hit", "lookup miss", "erase"};
+  f64         seconds[] = {insert, hit, miss, erase};
+  for (u32 i = 0; i < 4; ++i) {
+    snprintf(name, sizeof(name), "%s %s, %lluK", label, cases[i], count / 1000);
+    report(name, count * rounds, seconds[i]);
+  }
+}
+
+// hn::HashMap::find returns a pointer; this gives it the std::unordered_map shape used above.
+struct HnMap : hn::HashMap<u64, u64> {
+  u64 *find(u64 key) { return hn::HashMap<u64, u64>::find(key); }
+  u64 *end() { return nullptr; }
+};
+
+void bench_hash_map() {
+  const u64 max_count = 10000000;
+  auto      keys      = (u64 *)hn::mem::allocate(max_count * sizeof(u64), hn::mem::TagArray);
+  auto      missing   = (u64 *)hn::mem::allocate(max_count * sizeof(u64), hn::mem::TagArray);
+  for (u64 i = 0; i < max_count; ++i) {
+    keys[i]    = hn::hash_mix(i + 1);
+    missing[i] = hn::hash_mix(i + 1 + (1ull << 40));
+  }
+
+  for (u64 count = 1000; count <= max_count; count *= 10) {
+    bench_map<HnMap>("HashMap", keys, missing, count);
+    if (count <= 1000000) {
+      bench_map<std::unordered_map<u64, u64>>("unordered_map", keys, missing, count);
+    }
+  }
+
+  hn::mem::free(missing, max_count * sizeof(u64), hn::mem::TagArray);
+  hn::mem::free(keys, max_count * sizeof(u64), hn::mem::TagArray);
+}
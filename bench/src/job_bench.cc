@@ -0,0 +1,82 @@
+#include "bench.h"
+#include <cmath>
+#include <core/job.h>
+#include <core/memory.h>
+#include <cstdio>
+#include <thread>
+
+// parallel_for scaling from 1 to N threads on a synthetic compute workload, plus raw job overhead.
+
+static const u32 item_count = 1 << 22;
+static const u32 batch_size = 4096;
+static const u64 job_count  = 1000000;
+
+struct Workload {
+  f32 *input;
+  f32 *output;
+};
+
+static void compute(u32 begin, u32 end, void *data) {
+  auto work = (Workload *)data;
+  for (u32 i = begin; i < end; ++i) {
+    f32 x = work->input[i];
+    for (u32 k = 0; k < 16; ++k) {
+      x = sqrtf(x * x + 1.0f) * 0.5f;
+    }
+    work->output[i] = x;
+  }
+}
+
+static void empty_job(void *data) {}
+
+void bench_job() {
+  Workload work{};
+  work.input  = (f32 *)hn::mem::allocate(item_count * sizeof(f32), hn::mem::TagArray);
+  work.output = (f32 *)hn::mem::allocate(item_count * sizeof(f32), hn::mem::TagArray);
+  for (u32 i = 0; i < item_count; ++i) {
+    work.input[i] = (f32)i;
+  }
+
+  u32 max_threads = std::thread::hardware_concurrency();
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+
+  // 1, 2, 4, ... threads, always ending with every hardware thread.
+  f64 single = 0;
+  for (u32 threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+    hn::job::initialize(threads);
+
+    Timer timer;
+    hn::job::parallel_for(item_count, batch_size, compute, &work);
+    f64 elapsed = timer.elapsed();
+    if (threads == 1) {
+      single = elapsed;
+    }
+    do_not_optimize(work.output[item_count - 1]);
+
+    char name[64];
+    snprintf(name, sizeof(name), "parallel_for, %u threads (%.2fx)", threads, single / elapsed);
+    report(name, item_count, elapsed);
+
+    timer = Timer{};
+    hn::job::Counter counter;
+    for (u64 i = 0; i < job_count; ++i) {
+      hn::job::run(empty_job, nullptr, &counter);
+      if ((i & 1023) == 1023) {
+        hn::job::wait(counter);
+      }
+    }
+    hn::job::wait(counter);
+    snprintf(name, sizeof(name), "run + wait empty jobs, %u threads", threads);
+    report(name, job_count, timer.elapsed());
+
+    hn::job::terminate();
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  hn::mem::free(work.input, item_count * sizeof(f32), hn::mem::TagArray);
+  hn::mem::free(work.output, item_count * sizeof(f32), hn::mem::TagArray);
+}
@@ -0,0 +1,52 @@
+#include "bench.h"
+#include <core/memory.h>
+#include <cstdio>
+#include <cstring>
+
+struct Benchmark {
+  const char *name;
+  void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    {"bvh", bench_bvh},
+    {"darray", bench_darray},
+    {"ecs", bench_ecs},
+    {"event", bench_event},
+    {"hash_map", bench_hash_map},
+    {"job", bench_job},
+    {"math", bench_math},
+    {"memory", bench_memory},
+    {"resource", bench_resource},
+};
+
+static bool failed = false;
+
+void report(const char *name, u64 operations, f64 seconds) {
+  printf("  %-40s %12llu ops %10.3f ms %10.2f ns/op\n", name, operations, seconds * 1000.0,
+         seconds * 1000000000.0 / (f64)operations);
+}
+
+void fail(const char *message) {
+  printf("  FAILED: %s\n", message);
+  failed = true;
+}
+
+// Runs every benchmark, or only those named on the command line.
+int main(int argc, char **argv) {
+  hn::mem::initialize();
+
+  for (const auto &benchmark : benchmarks) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      selected |= strcmp(argv[i], benchmark.name) == 0;
+    }
+    if (selected) {
+      printf("%s\n", benchmark.name);
+      benchmark.run();
+    }
+  }
+
+  hn::mem::terminate();
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+#include "bench.h"
+#include <bit>
+#include <core/memory.h>
+#include <cstdio>
+#include <math/transform.h>
+
+// World matrices for transform hierarchies of 10k and 100k nodes, against the scalar version
+// written without hn::math; plus raw 4x4 matrix products.
+
+using namespace hn::math;
+
+static const u32 iterations = 20;
+
+// The scalar reference: column-major float[16] matrices.
+struct NaiveMatrix {
+  f32 m[16];
+};
+
+static void naive_compose(const vec3 &t, const quat &r, const vec3 &s, NaiveMatrix &out) {
+  f32 xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+  f32 xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+  f32 wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+  f32 rotation[9] = {1 - 2 * (yy + zz), 2 * (xy + wz),     2 * (xz - wy),
+                     2 * (xy - wz),     1 - 2 * (xx + zz), 2 * (yz + wx),
+                     2 * (xz + wy),     2 * (yz - wx),     1 - 2 * (xx + yy)};
+  f32 scale[3]    = {s.x, s.y, s.z};
+  for (u32 column = 0; column < 3; ++column) {
+    for (u32 row = 0; row < 3; ++row) {
+      out.m[column * 4 + row] = rotation[column * 3 + row] * scale[column];
+    }
+    out.m[column * 4 + 3] = 0;
+  }
+  out.m[12] = t.x;
+  out.m[13] = t.y;
+  out.m[14] = t.z;
+  out.m[15] = 1;
+}
+
+static void naive_multiply(const NaiveMatrix &a, const NaiveMatrix &b, NaiveMatrix &out) {
+  for (u32 column = 0; column < 4; ++column) {
+    for (u32 row = 0; row < 4; ++row) {
+      f32 sum = 0;
+      for (u32 k = 0; k < 4; ++k) {
+        sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+      }
+      out.m[column * 4 + row] = sum;
+    }
+  }
+}
+
+static void naive_update(const vec3 *positions, const quat *rotations, const vec3 *scales,
+                         const u32 *parents, u32 count, NaiveMatrix *out_world) {
+  for (u32 i = 0; i < count; ++i) {
+    NaiveMatrix local;
+    naive_compose(positions[i], rotations[i], scales[i], local);
+    if (parents[i] == no_parent) {
+      out_world[i] = local;
+    } else {
+      naive_multiply(out_world[parents[i]], local, out_world[i]);
+    }
+  }
+}
+
+// A forest of shallow trees: every node's parent is a few nodes back, like skeletons and the
+// attachments of scene objects.
+static void build(TransformHierarchy &hierarchy, u32 count) {
+  transform_hierarchy_create(hierarchy, count);
+  u32 seed = 1;
+  for (u32 i = 0; i < count; ++i) {
+    seed       = seed * 1664525 + 1013904223;
+    u32 parent = i % 64 == 0 ? no_parent : i - 1 - seed % (i % 64);
+    f32 angle  = (f32)(seed >> 8) / (f32)(1 << 24) * pi;
+    transform_hierarchy_add(hierarchy, parent, {(f32)(i % 7), 1, -2},
+                            quat_from_axis_angle(normalize(vec3{1, 2, 3}), angle),
+                            {1, 1.5f, 1});
+  }
+}
+
+static void bench_hierarchy(u32 count) {
+  TransformHierarchy hierarchy;
+  build(hierarchy, count);
+  char name[64];
+
+  auto naive = (NaiveMatrix *)hn::mem::allocate(count * sizeof(NaiveMatrix), hn::mem::TagArray);
+  Timer timer;
+  for (u32 k = 0; k < iterations; ++k) {
+    naive_update(hierarchy.positions, hierarchy.rotations, hierarchy.scales, hierarchy.parents,
+                 count, naive);
+  }
+  do_not_optimize(naive[count - 1]);
+  snprintf(name, sizeof(name), "naive scalar, %uk nodes", count / 1000);
+  report(name, (u64)count * iterations, timer.elapsed());
+
+  timer = Timer{};
+  for (u32 k = 0; k < iterations; ++k) {
+    transform_hierarchy_update(hierarchy);
+  }
+  do_not_optimize(hierarchy.world[count - 1]);
+  snprintf(name, sizeof(name), "update_transforms, %uk nodes", count / 1000);
+  report(name, (u64)count * iterations, timer.elapsed());
+
+  auto local = (mat4 *)hn::mem::allocate_aligned(count * sizeof(mat4), alignof(mat4),
+                                                 hn::mem::TagArray);
+  timer      = Timer{};
+  for (u32 k = 0; k < iterations; ++k) {
+    compose_transforms(hierarchy.positions, hierarchy.rotations, hierarchy.scales, count, local);
+    propagate_transforms(local, hierarchy.parents, count, hierarchy.world);
+  }
+  do_not_optimize(hierarchy.world[count - 1]);
+  snprintf(name, sizeof(name), "compose + propagate, %uk nodes", count / 1000);
+  report(name, (u64)count * iterations, timer.elapsed());
+
+  hn::mem::free_aligned(local, count * sizeof(mat4), alignof(mat4), hn::mem::TagArray);
+  hn::mem::free(naive, count * sizeof(NaiveMatrix), hn::mem::TagArray);
+  transform_hierarchy_destroy(hierarchy);
+}
+
+static void bench_multiply() {
+  const u32   count = 1024;
+  mat4        matrices[count];
+  NaiveMatrix naive_matrices[count];
+  for (u32 i = 0; i < count; ++i) {
+    matrices[i] = mat4_compose({(f32)i, 0, 1}, quat_from_axis_angle({0, 1, 0}, (f32)i), {1, 1, 1});
+  }
+  // The same matrices in the reference layout, copied up front so neither loop pays for it.
+  for (u32 i = 0; i < count; ++i) {
+    naive_matrices[i] = std::bit_cast<NaiveMatrix>(matrices[i]);
+  }
+  const u32 rounds = 1000;
+
+  NaiveMatrix naive = {{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+  Timer       timer;
+  for (u32 k = 0; k < rounds; ++k) {
+    for (u32 i = 0; i < count; ++i) {
+      NaiveMatrix next;
+      naive_multiply(naive, naive_matrices[i], next);
+      naive = next;
+    }
+  }
+  do_not_optimize(naive);
+  report("naive mat4 * mat4", (u64)count * rounds, timer.elapsed());
+
+  mat4 product = mat4_identity();
+  timer        = Timer{};
+  for (u32 k = 0; k < rounds; ++k) {
+    for (u32 i = 0; i < count; ++i) {
+      product = product * matrices[i];
+    }
+  }
+  do_not_optimize(product);
+  report("mat4 * mat4", (u64)count * rounds, timer.elapsed());
+
+  product = mat4_identity();
+  timer   = Timer{};
+  for (u32 k = 0; k < rounds; ++k) {
+    for (u32 i = 0; i < count; ++i) {
+      product = mul_affine(product, matrices[i]);
+    }
+  }
+  do_not_optimize(product);
+  report("mul_affine", (u64)count * rounds, timer.elapsed());
+}
+
+void bench_math() {
+  bench_multiply();
+  bench_hierarchy(10000);
+  bench_hierarchy(100000);
+}
@@ -0,0 +1,70 @@
+#include "bench.h"
+#include <container/darray.h>
+#include <container/darray_t.h>
+#include <core/memory.h>
+
+// Growing arrays to 100 MB by doubling: the old copy-through path versus in-place reallocation.
+
+static const u64 target_size  = 100 * 1024 * 1024;
+static const u64 initial_size = 4096;
+
+// What darray::_resize used to do: a fresh zeroed block, zeroed again, then copy and free.
+static void bench_copy_through() {
+  Timer timer;
+  u64   size  = initial_size;
+  u8   *block = (u8 *)hn::mem::allocate(size, hn::mem::TagArray);
+  u64   steps = 0;
+  while (size < target_size) {
+    u8 *grown = (u8 *)hn::mem::allocate(size * 2, hn::mem::TagArray);
+    hn::mem::set(grown, 0, size * 2);
+    hn::mem::copy(grown, block, size);
+    hn::mem::free(block, size, hn::mem::TagArray);
+    block = grown;
+    size *= 2;
+    steps++;
+  }
+  do_not_optimize(block[size - 1]);
+  report("copy-through growth to 100 MB", steps, timer.elapsed());
+  hn::mem::free(block, size, hn::mem::TagArray);
+}
+
+static void bench_reallocate() {
+  Timer timer;
+  u64   size  = initial_size;
+  u8   *block = (u8 *)hn::mem::allocate(size, hn::mem::TagArray, hn::mem::AllocateUninitialized);
+  u64   steps = 0;
+  while (size < target_size) {
+    block = (u8 *)hn::mem::reallocate(block, size, size * 2, 0, hn::mem::TagArray,
+                                      hn::mem::AllocateUninitialized);
+    size *= 2;
+    steps++;
+  }
+  do_not_optimize(block);
+  report("in-place reallocate growth to 100 MB", steps, timer.elapsed());
+  hn::mem::free(block, size, hn::mem::TagArray);
+}
+
+static void bench_darray_push() {
+  const u64 count = target_size / sizeof(u64);
+
+  Timer timer;
+  auto  values = (u64 *)darray_create(u64);
+  for (u64 i = 0; i < count; ++i) {
+    darray_push(values, i);
+  }
+  report("macro darray push to 100 MB", count, timer.elapsed());
+  darray_destroy(values);
+
+  timer = Timer{};
+  hn::DArray<u64> array;
+  for (u64 i = 0; i < count; ++i) {
+    array.push_back(i);
+  }
+  report("DArray<T> push_back to 100 MB", count, timer.elapsed());
+}
+
+void bench_memory() {
+  bench_copy_through();
+  bench_reallocate();
+  bench_darray_push();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "defines.h"
+#include <initializer_list>
+
+namespace hn {
+
+/**
+ * Fixed-size set of bits packed into 64-bit words, so set operations touch a word at a time. An
+ * aggregate: `BitSet<N> bits{}` is empty. Bits past `Bits` in the last word are always clear.
+ * @tparam Bits The number of bits.
+ */
+template <u32 Bits> struct BitSet {
+  static constexpr u32 word_count = (Bits + 63) / 64;
+
+  u64 words[word_count];
+
+  static BitSet of(std::initializer_list<u32> bits) {
+    BitSet set{};
+    for (u32 bit : bits) {
+      set.set(bit);
+    }
+    return set;
+  }
+
+  bool test(u32 bit) const { return words[bit / 64] >> (bit % 64) & 1; }
+  void set(u32 bit) { words[bit / 64] |= 1ull << (bit % 64); }
+  void reset(u32 bit) { words[bit / 64] &= ~(1ull << (bit % 64)); }
+
+  bool any() const {
+    u64 bits = 0;
+    for (u32 i = 0; i < word_count; ++i) {
+      bits |= words[i];
+    }
+    return bits != 0;
+  }
+
+  // Whether every bit of `mask` is set here.
+  bool contains(const BitSet &mask) const {
+    u64 missing = 0;
+    for (u32 i = 0; i < word_count; ++i) {
+      missing |= mask.words[i] & ~words[i];
+    }
+    return missing == 0;
+  }
+
+  // Whether any bit of `mask` is set here.
+  bool intersects(const BitSet &mask) const { return (*this & mask).any(); }
+
+  BitSet operator&(const BitSet &other) const {
+    BitSet result;
+    for (u32 i = 0; i < word_count; ++i) {
+      result.words[i] = words[i] & other.words[i];
+    }
+    return result;
+  }
+
+  BitSet operator|(const BitSet &other) const {
+    BitSet result;
+    for (u32 i = 0; i < word_count; ++i) {
+      result.words[i] = words[i] | other.words[i];
+    }
+    return result;
+  }
+
+  // This set without the bits of `other`.
+  BitSet operator-(const BitSet &other) const {
+    BitSet result;
+    for (u32 i = 0; i < word_count; ++i) {
+      result.words[i] = words[i] & ~other.words[i];
+    }
+    return result;
+  }
+
+  bool operator==(const BitSet &other) const {
+    u64 difference = 0;
+    for (u32 i = 0; i < word_count; ++i) {
+      difference |= words[i] ^ other.words[i];
+    }
+    return difference == 0;
+  }
+};
+
+} // namespace hn
@@ -4,23 +4,34 @@
 
 namespace hn::darray {
 
-void *_create(u64 length, u64 stride) {
-  u64  header_size = FieldCount * sizeof(u64);
+// Bytes in front of the elements: the header, padded so the elements land on `alignment`.
+static u64 _header_size(u64 alignment) {
+  u64 header_size = FieldCount * sizeof(u64);
+  return (header_size + alignment - 1) & ~(alignment - 1);
+}
+
+void *_create(u64 length, u64 stride, u64 alignment) {
+  if (alignment < sizeof(u64)) {
+    alignment = sizeof(u64);
+  }
+  u64  header_size = _header_size(alignment);
   u64  array_size  = length * stride;
   u64  total_size  = header_size + array_size;
-  u64 *array       = (u64 *)hn::mem::allocate(total_size, hn::mem::TagDArray);
-  hn::mem::set(array, 0, total_size);
-  array[Capacity] = length;
-  array[Length]   = 0;
-  array[Stride]   = stride;
-  return (void *)(array + FieldCount);
+  u8  *block       = (u8 *)hn::mem::allocate_aligned(total_size, alignment, hn::mem::TagDArray);
+  u64 *header       = (u64 *)(block + header_size) - FieldCount;
+  header[Capacity]  = length;
+  header[Length]    = 0;
+  header[Stride]    = stride;
+  header[Alignment] = alignment;
+  return (void *)(block + header_size);
 }
 
 void _destroy(void *array) {
   u64 *header      = (u64 *)array - FieldCount;
-  u64  header_size = FieldCount * sizeof(u64);
+  u64  header_size = _header_size(header[Alignment]);
   u64  total_size  = header_size + header[Capacity] * header[Stride];
-  hn::mem::free(header, total_size, hn::mem::TagDArray);
+  hn::mem::free_aligned((u8 *)array - header_size, total_size, header[Alignment],
+                        hn::mem::TagDArray);
   array = nullptr;
 }
 
@@ -35,13 +46,27 @@ void _field_set(void *array, u64 field, u64 value) {
 }
 
 void *_resize(void *array) {
-  u64   length = darray_length(array);
-  u64   stride = darray_stride(array);
-  void *temp   = _create((DARRAY_RESIZE_FACTOR * darray_capacity(array)), stride);
-  hn::mem::copy(temp, array, length * stride);
-  _field_set(temp, Length, length);
-  _destroy(array);
-  return temp;
+  u64 *header      = (u64 *)array - FieldCount;
+  u64  alignment   = header[Alignment];
+  u64  header_size = _header_size(alignment);
+  u64  capacity    = DARRAY_RESIZE_FACTOR * header[Capacity];
+  if (capacity == 0) {
+    capacity = DARRAY_DEFAULT_CAPACITY;
+  }
+  u64 old_size = header_size + header[Capacity] * header[Stride];
+  u64 new_size = header_size + capacity * header[Stride];
+
+  // Grow the whole block, header included, in place if the allocator can. The elements past the
+  // current length are about to be written, so the new space is left uninitialized.
+  u8 *block = (u8 *)hn::mem::reallocate((u8 *)array - header_size, old_size, new_size, alignment,
+                                        hn::mem::TagDArray, hn::mem::AllocateUninitialized);
+  if (!block) {
+    // Leave the array as it was; callers see that the capacity did not change.
+    return array;
+  }
+  array = block + header_size;
+  _field_set(array, Capacity, capacity);
+  return array;
 }
 
 void *_push(void *array, const void *value_ptr) {
@@ -49,6 +74,10 @@ void *_push(void *array, const void *value_ptr) {
   u64 stride = darray_stride(array);
   if (length >= darray_capacity(array)) {
     array = _resize(array);
+    if (length >= darray_capacity(array)) {
+      HN_error("Failed to grow the array past %llu elements.", length);
+      return array;
+    }
   }
 
   u64 addr = (u64)array;
@@ -97,6 +126,10 @@ void *_insert_at(void *array, u64 index, void *value_ptr) {
   }
   if (length >= darray_capacity(array)) {
     array = _resize(array);
+    if (length >= darray_capacity(array)) {
+      HN_error("Failed to grow the array past %llu elements.", length);
+      return array;
+    }
   }
 
   u64 addr = (u64)array;
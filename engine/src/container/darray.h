@@ -4,15 +4,17 @@
 
 /**
  * Memory layout:
+ * - padding: Only present for arrays aligned beyond the header size.
  * - u64 capacity: Number elements that can be held.
  * - u64 length: Number of elements currently contained.
  * - u64 stride: Size of each element in bytes.
+ * - u64 alignment: Alignment of the elements in bytes.
  * - void* elements.
  */
 
 namespace hn::darray {
 
-enum { Capacity, Length, Stride, FieldCount };
+enum { Capacity, Length, Stride, Alignment, FieldCount };
 
 /**
  * Creates a new darray of the given length and stride.
@@ -20,9 +22,10 @@ enum { Capacity, Length, Stride, FieldCount };
  * @note Avoid using this directly; use the darray_create macro instead.
  * @param length The default number of elements in the array.
  * @param stride The size of each array element.
+ * @param alignment The boundary the elements start on; a power of two. Zero uses the default.
  * @returns A pointer representing the block of memory containing the array.
  */
-void *_create(u64 length, u64 stride);
+void *_create(u64 length, u64 stride, u64 alignment = 0);
 void  _destroy(void *array);
 
 /**
@@ -107,6 +110,18 @@ void *_insert_at(void *array, u64 index, void *value_ptr);
  */
 #define darray_reserve(type, capacity) hn::darray::_create(capacity, sizeof(type))
 
+/**
+ * Creates a new darray of the given type with the provided capacity, whose elements start on the
+ * given boundary. The alignment is kept across resizes.
+ * Performs a dynamic memory allocation.
+ * @param type The type to be used to create the darray.
+ * @param capacity The number of elements the darray can initially hold (can be resized).
+ * @param alignment The element alignment in bytes, e.g. 16 or 32 for SIMD or 64 for a cache line.
+ * @returns A pointer to the array's memory block.
+ */
+#define darray_reserve_aligned(type, capacity, alignment)                                          \
+  hn::darray::_create(capacity, sizeof(type), alignment)
+
 /**
  * Destroys the provided array, freeing any memory allocated by it.
  * @param array The array to be destroyed.
@@ -183,6 +198,13 @@ void *_insert_at(void *array, u64 index, void *value_ptr);
  */
 #define darray_stride(array) hn::darray::_field_get(array, hn::darray::Stride)
 
+/**
+ * Gets the alignment of the given array's elements.
+ * @param array The array to obtain the alignment of.
+ * @returns The element alignment of the given array.
+ */
+#define darray_alignment(array) hn::darray::_field_get(array, hn::darray::Alignment)
+
 /**
  * Sets the length of the given array. This ensures the array has the required capacity to be able
  * to set entries directly, for instance. Can trigger an internal reallocation.
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "core/log.h"
+#include "core/memory.h"
+#include "defines.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hn {
+
+namespace detail {
+
+// Element storage kept inside the array object itself, used before the first heap allocation.
+template <typename T, u64 Capacity> struct DArrayInlineStorage {
+  alignas(T) u8 bytes[Capacity * sizeof(T)];
+
+  T *data() { return reinterpret_cast<T *>(bytes); }
+};
+
+template <typename T> struct DArrayInlineStorage<T, 0> {
+  T *data() { return nullptr; }
+};
+
+} // namespace detail
+
+/**
+ * Type-safe dynamic array. Unlike the macro darray, elements are move-constructed on growth, so any
+ * movable type can be stored, and size/capacity are plain members that inline away.
+ * Memory is allocated through hn::mem under the given tag.
+ * @tparam T The element type.
+ * @tparam InlineCapacity Elements held inside the object before spilling to the heap.
+ */
+template <typename T, u64 InlineCapacity = 0> class DArray {
+public:
+  explicit DArray(mem::Tag tag = mem::TagDArray, f32 growth_factor = 2.0f)
+      : _capacity(InlineCapacity), _growth_factor(growth_factor), _tag(tag) {
+    // _inline is declared last, so it is only constructed once the body runs.
+    _data = _inline.data();
+  }
+
+  DArray(const DArray &)            = delete;
+  DArray &operator=(const DArray &) = delete;
+
+  DArray(DArray &&other) noexcept : DArray(other._tag, other._growth_factor) { _take(other); }
+
+  DArray &operator=(DArray &&other) noexcept {
+    if (this != &other) {
+      _release();
+      _tag           = other._tag;
+      _growth_factor = other._growth_factor;
+      _take(other);
+    }
+    return *this;
+  }
+
+  ~DArray() { _release(); }
+
+  T       *data() { return _data; }
+  const T *data() const { return _data; }
+  u64      size() const { return _size; }
+  u64      capacity() const { return _capacity; }
+  bool     empty() const { return _size == 0; }
+
+  T       &operator[](u64 index) { return _data[index]; }
+  const T &operator[](u64 index) const { return _data[index]; }
+  T       &back() { return _data[_size - 1]; }
+
+  T       *begin() { return _data; }
+  T       *end() { return _data + _size; }
+  const T *begin() const { return _data; }
+  const T *end() const { return _data + _size; }
+
+  /**
+   * Ensures room for at least the given number of elements without further allocation.
+   * @param capacity The number of elements to make room for.
+   */
+  void reserve(u64 capacity) {
+    if (capacity > _capacity) {
+      _reallocate(capacity);
+    }
+  }
+
+  template <typename... Args> T &emplace_back(Args &&...args) {
+    if (_size == _capacity) {
+      _grow(_size + 1);
+    }
+    T *element = new (_data + _size) T(std::forward<Args>(args)...);
+    _size++;
+    return *element;
+  }
+
+  void push_back(const T &value) { emplace_back(value); }
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  void pop_back() {
+    _size--;
+    _data[_size].~T();
+  }
+
+  /**
+   * Removes the element at the given index by moving the last element into its place.
+   * O(1), but does not preserve order.
+   * @param index The index of the element to remove.
+   */
+  void swap_remove(u64 index) {
+    if (index != _size - 1) {
+      _data[index] = std::move(_data[_size - 1]);
+    }
+    pop_back();
+  }
+
+  /**
+   * Removes the element at the given index, shifting the following elements in by one.
+   * @param index The index of the element to remove.
+   */
+  void remove(u64 index) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      memmove(_data + index, _data + index + 1, (_size - index - 1) * sizeof(T));
+      _size--;
+    } else {
+      for (u64 i = index; i + 1 < _size; ++i) {
+        _data[i] = std::move(_data[i + 1]);
+      }
+      pop_back();
+    }
+  }
+
+  /**
+   * Appends copies of the given elements, growing at most once.
+   * @param values The elements to copy.
+   * @param count The number of elements.
+   */
+  void append(const T *values, u64 count) {
+    if (_size + count > _capacity) {
+      _grow(_size + count);
+    }
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      mem::copy(_data + _size, values, count * sizeof(T));
+    } else {
+      for (u64 i = 0; i < count; ++i) {
+        new (_data + _size + i) T(values[i]);
+      }
+    }
+    _size += count;
+  }
+
+  /**
+   * Sets the size without constructing the new elements, for callers that fill them directly.
+   * @param size The new number of elements.
+   */
+  void resize_uninitialized(u64 size) {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+                  "resize_uninitialized requires a trivial element type.");
+    reserve(size);
+    _size = size;
+  }
+
+  void resize(u64 size) {
+    reserve(size);
+    for (u64 i = _size; i < size; ++i) {
+      new (_data + i) T();
+    }
+    for (u64 i = size; i < _size; ++i) {
+      _data[i].~T();
+    }
+    _size = size;
+  }
+
+  void clear() {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (u64 i = 0; i < _size; ++i) {
+        _data[i].~T();
+      }
+    }
+    _size = 0;
+  }
+
+private:
+  bool _is_inline() const { return InlineCapacity > 0 && _data == _inline_data(); }
+  T   *_inline_data() const { return const_cast<DArray *>(this)->_inline.data(); }
+
+  void _grow(u64 required) {
+    u64 capacity = (u64)(_capacity * _growth_factor);
+    if (capacity < required) {
+      capacity = required;
+    }
+    _reallocate(capacity);
+  }
+
+  // Growth has no way to report failure, and carrying on would write past the old storage.
+  [[noreturn]] void _out_of_memory(u64 capacity) {
+    HN_fatal("DArray failed to grow to %llu elements of %llu bytes.", capacity, (u64)sizeof(T));
+    std::abort();
+  }
+
+  void _reallocate(u64 capacity) {
+    // Trivial elements on the heap can be grown in place.
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (_data && !_is_inline()) {
+        T *data = (T *)mem::reallocate(_data, _capacity * sizeof(T), capacity * sizeof(T),
+                                       alignof(T), _tag, mem::AllocateUninitialized);
+        if (!data) {
+          _out_of_memory(capacity);
+        }
+        _data     = data;
+        _capacity = capacity;
+        return;
+      }
+    }
+
+    T *data = (T *)mem::allocate_aligned(capacity * sizeof(T), alignof(T), _tag,
+                                         mem::AllocateUninitialized);
+    if (!data) {
+      _out_of_memory(capacity);
+    }
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (_size) {
+        mem::copy(data, _data, _size * sizeof(T));
+      }
+    } else {
+      for (u64 i = 0; i < _size; ++i) {
+        new (data + i) T(std::move(_data[i]));
+        _data[i].~T();
+      }
+    }
+    _free_storage();
+    _data     = data;
+    _capacity = capacity;
+  }
+
+  void _free_storage() {
+    if (_data && !_is_inline()) {
+      mem::free_aligned(_data, _capacity * sizeof(T), alignof(T), _tag);
+    }
+  }
+
+  void _release() {
+    clear();
+    _free_storage();
+    _data     = _inline_data();
+    _capacity = InlineCapacity;
+  }
+
+  // Steals the other array's elements, leaving it empty. Expects this array to be empty.
+  void _take(DArray &other) {
+    if (other._is_inline()) {
+      for (u64 i = 0; i < other._size; ++i) {
+        emplace_back(std::move(other._data[i]));
+      }
+      other.clear();
+      return;
+    }
+    _data           = other._data;
+    _size           = other._size;
+    _capacity       = other._capacity;
+    other._data     = other._inline_data();
+    other._size     = 0;
+    other._capacity = InlineCapacity;
+  }
+
+  T       *_data     = nullptr;
+  u64      _size     = 0;
+  u64      _capacity = 0;
+  f32      _growth_factor;
+  mem::Tag _tag;
+
+  [[no_unique_address]] detail::DArrayInlineStorage<T, InlineCapacity> _inline;
+};
+
+} // namespace hn
@@ -0,0 +1,443 @@
+#pragma once
+
+#include "core/log.h"
+#include "core/memory.h"
+#include "defines.h"
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HN_HASH_MAP_SSE 1
+#else
+#define HN_HASH_MAP_SSE 0
+#endif
+
+namespace hn {
+
+// Spreads the bits of a 64-bit value over the whole word (the SplitMix64 finalizer).
+inline u64 hash_mix(u64 value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ull;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebull;
+  value ^= value >> 31;
+  return value;
+}
+
+inline u64 hash_bytes(const void *data, u64 size, u64 seed = 0) {
+  const u8 *bytes = (const u8 *)data;
+  u64       hash  = seed ^ (size * 0x9e3779b97f4a7c15ull);
+  for (; size >= 8; bytes += 8, size -= 8) {
+    u64 word;
+    memcpy(&word, bytes, 8);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
+  }
+  if (size) {
+    u64 word = 0;
+    memcpy(&word, bytes, size);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+  }
+  return hash_mix(hash);
+}
+
+// The default hash: integers, enums and pointers by value.
+template <typename K> struct Hasher {
+  static_assert(std::is_integral_v<K> || std::is_enum_v<K> || std::is_pointer_v<K>,
+                "No default hash for this key type; pass one to HashMap.");
+
+  u64 operator()(K key) const { return hash_mix((u64)key); }
+};
+
+// Hash and equality for null-terminated string keys, compared by contents.
+struct CStringHasher {
+  u64 operator()(const char *key) const { return hash_bytes(key, strlen(key)); }
+};
+
+struct CStringEqual {
+  bool operator()(const char *a, const char *b) const { return strcmp(a, b) == 0; }
+};
+
+namespace detail {
+
+// A slot's control byte: its key's 7-bit hash fragment while full, or one of these (negative).
+const i8 control_empty   = -128;
+const i8 control_deleted = -2;
+
+// Sixteen consecutive control bytes, compared against a value in one instruction.
+struct ControlGroup {
+  static constexpr u32 width = 16;
+
+#if HN_HASH_MAP_SSE
+  __m128i bytes;
+
+  explicit ControlGroup(const i8 *control) : bytes(_mm_loadu_si128((const __m128i *)control)) {}
+
+  // Bit i is set if byte i equals `value`.
+  u32 match(i8 value) const {
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value)));
+  }
+
+  // Empty and deleted are the only negative control bytes.
+  u32 match_free() const { return (u32)_mm_movemask_epi8(bytes); }
+#else
+  i8 bytes[width];
+
+  explicit ControlGroup(const i8 *control) { memcpy(bytes, control, width); }
+
+  u32 match(i8 value) const {
+    u32 bits = 0;
+    for (u32 i = 0; i < width; ++i) {
+      bits |= (u32)(bytes[i] == value) << i;
+    }
+    return bits;
+  }
+
+  u32 match_free() const {
+    u32 bits = 0;
+    for (u32 i = 0; i < width; ++i) {
+      bits |= (u32)(bytes[i] < 0) << i;
+    }
+    return bits;
+  }
+#endif
+
+  u32 match_empty() const { return match(control_empty); }
+};
+
+} // namespace detail
+
+/**
+ * Open-addressing hash map in the Swiss table layout: entries live in one flat array next to an
+ * array of control bytes, each holding 7 bits of its entry's hash. A lookup compares the control
+ * bytes of 16 slots at once and only touches entries whose fragment matches, so misses rarely
+ * read an entry at all. Erasing leaves a tombstone only when a probe could have passed the slot
+ * on its way to another key; tombstones are dropped when the map rehashes. Growing moves entries
+ * and invalidates pointers to them.
+ * Memory is allocated through hn::mem under the given tag.
+ * @tparam K The key type.
+ * @tparam V The value type.
+ * @tparam Hash Maps a key to a u64; the low 7 bits feed the control bytes, the rest the position.
+ * @tparam Equal Compares two keys.
+ */
+template <typename K, typename V, typename Hash = Hasher<K>, typename Equal = std::equal_to<K>>
+class HashMap {
+public:
+  struct Entry {
+    K key; // Do not modify while the entry is in the map.
+    V value;
+  };
+
+  template <typename M, typename E> class Iterator {
+  public:
+    Iterator(M *map, u64 index) : _map(map), _index(index) { _skip_free(); }
+
+    E &operator*() const { return _map->_entries[_index]; }
+    E *operator->() const { return &_map->_entries[_index]; }
+
+    Iterator &operator++() {
+      ++_index;
+      _skip_free();
+      return *this;
+    }
+
+    bool operator!=(const Iterator &other) const { return _index != other._index; }
+
+  private:
+    void _skip_free() {
+      while (_index < _map->_capacity && _map->_control[_index] < 0) {
+        ++_index;
+      }
+    }
+
+    M  *_map;
+    u64 _index;
+  };
+
+  explicit HashMap(mem::Tag tag = mem::TagMap) : _tag(tag) {}
+
+  HashMap(const HashMap &)            = delete;
+  HashMap &operator=(const HashMap &) = delete;
+
+  HashMap(HashMap &&other) noexcept : _tag(other._tag) { _take(other); }
+
+  HashMap &operator=(HashMap &&other) noexcept {
+    if (this != &other) {
+      _release();
+      _tag = other._tag;
+      _take(other);
+    }
+    return *this;
+  }
+
+  ~HashMap() { _release(); }
+
+  u64  size() const { return _size; }
+  u64  capacity() const { return _capacity; }
+  bool empty() const { return _size == 0; }
+
+  Iterator<HashMap, Entry>             begin() { return {this, 0}; }
+  Iterator<HashMap, Entry>             end() { return {this, _capacity}; }
+  Iterator<const HashMap, const Entry> begin() const { return {this, 0}; }
+  Iterator<const HashMap, const Entry> end() const { return {this, _capacity}; }
+
+  // The value stored under the key, or nullptr.
+  V *find(const K &key) {
+    u64 index = _find(key, Hash{}(key));
+    return index == _capacity ? nullptr : &_entries[index].value;
+  }
+
+  const V *find(const K &key) const { return const_cast<HashMap *>(this)->find(key); }
+  bool     contains(const K &key) const { return find(key) != nullptr; }
+
+  /**
+   * Stores the value under the key, replacing any value already there.
+   * @returns True if the key is new; false if it was replaced.
+   */
+  bool insert(const K &key, V value) {
+    u64 hash  = Hash{}(key);
+    u64 index = _find(key, hash);
+    if (index != _capacity) {
+      _entries[index].value = std::move(value);
+      return false;
+    }
+    new (_claim(hash)) Entry{key, std::move(value)};
+    return true;
+  }
+
+  // The value stored under the key, default-constructed first if the key is new.
+  V &operator[](const K &key) {
+    u64 hash  = Hash{}(key);
+    u64 index = _find(key, hash);
+    if (index != _capacity) {
+      return _entries[index].value;
+    }
+    return (new (_claim(hash)) Entry{key, V()})->value;
+  }
+
+  // Removes the key. Returns false if it was not in the map.
+  bool erase(const K &key) {
+    u64 index = _find(key, Hash{}(key));
+    if (index == _capacity) {
+      return false;
+    }
+    _entries[index].~Entry();
+    _size--;
+
+    // A probe only continues past a group without empty slots. If the run of full slots around
+    // this one is shorter than a group, no group that contains it is full, so no probe has passed
+    // it and the slot can become empty again instead of a tombstone.
+    const u32 width        = detail::ControlGroup::width;
+    u64       before       = (index - width) & _mask;
+    u32       empty_after  = detail::ControlGroup(_control + index).match_empty();
+    u32       empty_before = detail::ControlGroup(_control + before).match_empty();
+    bool      was_never_full =
+        empty_before && empty_after &&
+        std::countr_zero(empty_after) + std::countl_zero((u16)empty_before) < (i32)width;
+    if (was_never_full) {
+      _set_control(index, detail::control_empty);
+      _growth_left++;
+    } else {
+      _set_control(index, detail::control_deleted);
+    }
+    return true;
+  }
+
+  /**
+   * Ensures room for at least the given number of entries without rehashing.
+   * @param count The number of entries to make room for.
+   */
+  void reserve(u64 count) {
+    if (count > _max_load(_capacity)) {
+      _rehash(_capacity_for(count));
+    }
+  }
+
+  /**
+   * Rebuilds the table, dropping tombstones.
+   * @param capacity The number of slots; rounded up to a power of two that fits the entries.
+   */
+  void rehash(u64 capacity) {
+    u64 minimum = _capacity_for(_size);
+    _rehash(capacity > minimum ? std::bit_ceil(capacity) : minimum);
+  }
+
+  void clear() {
+    _destroy_entries();
+    if (_capacity) {
+      memset(_control, detail::control_empty, _capacity + detail::ControlGroup::width);
+    }
+    _size        = 0;
+    _growth_left = _max_load(_capacity);
+  }
+
+private:
+  // Tables stay at most 7/8 full.
+  static u64 _max_load(u64 capacity) { return capacity - capacity / 8; }
+
+  static u64 _capacity_for(u64 count) {
+    u64 capacity = detail::ControlGroup::width;
+    while (_max_load(capacity) < count) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  static u64 _alignment() { return alignof(Entry) > 16 ? alignof(Entry) : 16; }
+
+  // Entries first, then the control bytes, the first group's repeated at the end so that a group
+  // can be loaded from any slot without wrapping.
+  static u64 _allocation_size(u64 capacity) {
+    return capacity * sizeof(Entry) + capacity + detail::ControlGroup::width;
+  }
+
+  // The key's slot, or _capacity if it is not in the map.
+  u64 _find(const K &key, u64 hash) const {
+    if (_capacity == 0) {
+      return 0;
+    }
+    i8  fragment = (i8)(hash & 0x7f);
+    u64 position = (hash >> 7) & _mask;
+    // Triangular steps over whole groups visit every group of a power-of-two table.
+    for (u64 step = detail::ControlGroup::width;; step += detail::ControlGroup::width) {
+      detail::ControlGroup group(_control + position);
+      for (u32 bits = group.match(fragment); bits; bits &= bits - 1) {
+        u64 index = (position + std::countr_zero(bits)) & _mask;
+        if (Equal{}(_entries[index].key, key)) {
+          return index;
+        }
+      }
+      if (group.match_empty()) {
+        return _capacity;
+      }
+      position = (position + step) & _mask;
+    }
+  }
+
+  // Marks a free slot on the key's probe sequence as taken and returns it for construction.
+  Entry *_claim(u64 hash) {
+    if (_growth_left == 0) {
+      // Rehash in place when tombstones fill half of the load; grow otherwise.
+      _rehash(_size * 2 > _max_load(_capacity) || _capacity == 0
+                  ? _capacity_for(_size + 1)
+                  : _capacity);
+    }
+    u64 index = _find_free(hash);
+    if (_control[index] == detail::control_empty) {
+      _growth_left--;
+    }
+    _set_control(index, (i8)(hash & 0x7f));
+    _size++;
+    return &_entries[index];
+  }
+
+  u64 _find_free(u64 hash) const {
+    u64 position = (hash >> 7) & _mask;
+    for (u64 step = detail::ControlGroup::width;; step += detail::ControlGroup::width) {
+      u32 bits = detail::ControlGroup(_control + position).match_free();
+      if (bits) {
+        return (position + std::countr_zero(bits)) & _mask;
+      }
+      position = (position + step) & _mask;
+    }
+  }
+
+  void _set_control(u64 index, i8 value) {
+    _control[index] = value;
+    if (index < detail::ControlGroup::width) {
+      _control[_capacity + index] = value;
+    }
+  }
+
+  void _rehash(u64 capacity) {
+    Entry *entries  = _entries;
+    i8    *control  = _control;
+    u64    previous = _capacity;
+
+    _entries = (Entry *)mem::allocate_aligned(_allocation_size(capacity), _alignment(), _tag,
+                                              mem::AllocateUninitialized);
+    if (!_entries) {
+      // Inserts have no way to report failure, and carrying on would write through null.
+      HN_fatal("HashMap failed to grow to %llu slots.", capacity);
+      std::abort();
+    }
+    _control = (i8 *)(_entries + capacity);
+    memset(_control, detail::control_empty, capacity + detail::ControlGroup::width);
+    _capacity    = capacity;
+    _mask        = capacity - 1;
+    _growth_left = _max_load(capacity) - _size;
+
+    for (u64 i = 0; i < previous; ++i) {
+      if (control[i] < 0) {
+        continue;
+      }
+      u64 hash  = Hash{}(entries[i].key);
+      u64 index = _find_free(hash);
+      _set_control(index, (i8)(hash & 0x7f));
+      if constexpr (std::is_trivially_copyable_v<Entry>) {
+        memcpy((void *)&_entries[index], &entries[i], sizeof(Entry));
+      } else {
+        new (&_entries[index]) Entry(std::move(entries[i]));
+        entries[i].~Entry();
+      }
+    }
+    if (entries) {
+      mem::free_aligned(entries, _allocation_size(previous), _alignment(), _tag);
+    }
+  }
+
+  void _destroy_entries() {
+    if constexpr (!std::is_trivially_destructible_v<Entry>) {
+      for (u64 i = 0; i < _capacity; ++i) {
+        if (_control[i] >= 0) {
+          _entries[i].~Entry();
+        }
+      }
+    }
+  }
+
+  void _release() {
+    _destroy_entries();
+    if (_entries) {
+      mem::free_aligned(_entries, _allocation_size(_capacity), _alignment(), _tag);
+    }
+    _entries     = nullptr;
+    _control     = nullptr;
+    _capacity    = 0;
+    _mask        = 0;
+    _size        = 0;
+    _growth_left = 0;
+  }
+
+  // Steals the other map's table, leaving it empty. Expects this map to be empty.
+  void _take(HashMap &other) {
+    _entries           = other._entries;
+    _control           = other._control;
+    _capacity          = other._capacity;
+    _mask              = other._mask;
+    _size              = other._size;
+    _growth_left       = other._growth_left;
+    other._entries     = nullptr;
+    other._control     = nullptr;
+    other._capacity    = 0;
+    other._mask        = 0;
+    other._size        = 0;
+    other._growth_left = 0;
+  }
+
+  Entry   *_entries     = nullptr;
+  i8      *_control     = nullptr;
+  u64      _capacity    = 0;
+  u64      _mask        = 0;
+  u64      _size        = 0;
+  u64      _growth_left = 0; // Empty slots that may still be filled before rehashing.
+  mem::Tag _tag;
+};
+
+} // namespace hn
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "core/memory.h"
+#include "defines.h"
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+namespace hn {
+
+/**
+ * Bounded multi-producer, single-consumer queue. Any number of threads may push concurrently
+ * without locks; a single thread pops. Each slot carries a sequence number telling producers and
+ * the consumer whose turn it is, so a push is one compare-and-swap plus a copy.
+ * Memory is allocated through hn::mem under the given tag.
+ * @tparam T The element type; must be trivially copyable.
+ */
+template <typename T> class MpscQueue {
+  static_assert(std::is_trivially_copyable_v<T>, "MpscQueue requires a trivially copyable type.");
+
+public:
+  MpscQueue()                             = default;
+  MpscQueue(const MpscQueue &)            = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+  ~MpscQueue() { destroy(); }
+
+  /**
+   * Allocates the slots.
+   * @param capacity The number of elements the queue can hold; a power of two.
+   * @param tag The tag the slots are accounted under.
+   * @returns True on success; otherwise false.
+   */
+  bool create(u64 capacity, mem::Tag tag) {
+    if (capacity == 0 || (capacity & (capacity - 1))) {
+      return false;
+    }
+    _cells = (Cell *)mem::allocate_aligned(capacity * sizeof(Cell), alignof(Cell), tag,
+                                           mem::AllocateUninitialized);
+    if (!_cells) {
+      return false;
+    }
+    for (u64 i = 0; i < capacity; ++i) {
+      new (&_cells[i].sequence) std::atomic<u64>(i);
+    }
+    _mask = capacity - 1;
+    _tag  = tag;
+    _enqueue.store(0, std::memory_order_relaxed);
+    _dequeue = 0;
+    return true;
+  }
+
+  void destroy() {
+    if (_cells) {
+      mem::free_aligned(_cells, (_mask + 1) * sizeof(Cell), alignof(Cell), _tag);
+      _cells = nullptr;
+    }
+  }
+
+  /**
+   * Pushes a copy of the value. Safe to call from any thread.
+   * @returns True if pushed; false if the queue is full.
+   */
+  bool push(const T &value) {
+    u64   position = _enqueue.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell         = &_cells[position & _mask];
+      u64 sequence = cell->sequence.load(std::memory_order_acquire);
+      i64 diff     = (i64)sequence - (i64)position;
+      if (diff == 0) {
+        // The slot is free for this position; claim it.
+        if (_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The consumer has not freed this slot yet: full.
+        return false;
+      } else {
+        position = _enqueue.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = value;
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Pushes copies of the values into consecutive slots, so the consumer pops them back to back
+   * even while other threads push. Safe to call from any thread.
+   * @returns True if pushed; false, pushing none of them, if the queue lacks room for all.
+   */
+  bool push_range(const T *values, u64 count) {
+    if (count == 0) {
+      return true;
+    }
+    if (count > _mask + 1) {
+      return false;
+    }
+    u64 position = _enqueue.load(std::memory_order_relaxed);
+    while (true) {
+      u64 sequence = _cells[position & _mask].sequence.load(std::memory_order_acquire);
+      i64 diff     = (i64)sequence - (i64)position;
+      if (diff == 0) {
+        // The consumer frees slots in order, so if the last one is free, all of them are.
+        u64 last = position + count - 1;
+        if (_cells[last & _mask].sequence.load(std::memory_order_acquire) != last) {
+          return false;
+        }
+        if (_enqueue.compare_exchange_weak(position, position + count,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = _enqueue.load(std::memory_order_relaxed);
+      }
+    }
+    for (u64 i = 0; i < count; ++i) {
+      Cell *cell  = &_cells[(position + i) & _mask];
+      cell->value = values[i];
+      cell->sequence.store(position + i + 1, std::memory_order_release);
+    }
+    return true;
+  }
+
+  /**
+   * Pops the oldest fully-pushed value. Must only be called from the consumer thread.
+   * @returns True if a value was popped; false if the queue is empty.
+   */
+  bool pop(T &out_value) {
+    Cell *cell     = &_cells[_dequeue & _mask];
+    u64   sequence = cell->sequence.load(std::memory_order_acquire);
+    if (sequence != _dequeue + 1) {
+      return false;
+    }
+    out_value = cell->value;
+    // Hand the slot back to producers for the next lap.
+    cell->sequence.store(_dequeue + _mask + 1, std::memory_order_release);
+    _dequeue++;
+    return true;
+  }
+
+  u64 capacity() const { return _cells ? _mask + 1 : 0; }
+
+private:
+  struct Cell {
+    std::atomic<u64> sequence;
+    T                value;
+  };
+
+  Cell    *_cells = nullptr;
+  u64      _mask  = 0;
+  mem::Tag _tag   = mem::TagUnknown;
+  // Producers and the consumer work on separate cache lines.
+  alignas(64) std::atomic<u64> _enqueue{0};
+  alignas(64) u64 _dequeue = 0;
+};
+
+} // namespace hn
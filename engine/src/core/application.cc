@@ -2,9 +2,17 @@
 #include "event.h"
 #include "game_types.h"
 #include "input.h"
+#include "job.h"
 #include "log.h"
 #include "memory.h"
+#include "metrics.h"
 #include "platform/platform.h"
+#include "profile.h"
+#include "resource.h"
+#include "strings.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
 
 namespace hn::application {
 
@@ -15,16 +23,68 @@ struct State {
   platform::State platform{};
   u16             width     = 120;
   u16             height    = 120;
-  f32             last_time = 0;
+  f64             last_time = 0;
+  // Fixed timestep: simulated time owed to the game, and its fraction of a step after updating.
+  f64 accumulator = 0;
+  f32 alpha       = 0;
+  // Frame limiter: when the next frame is due, and running estimates of how far platform::sleep_us
+  // overshoots (mean and mean absolute deviation).
+  f64 next_frame_time     = 0;
+  f64 oversleep_mean      = 0.0002;
+  f64 oversleep_deviation = 0.0001;
+  // Benchmark mode: per-frame times in seconds, `benchmark_frames` entries.
+  f64 *frame_times = nullptr;
+  u32  frame_count = 0;
+  // Handles of the application's own event listeners.
+  event::ListenerHandle listeners[3]{};
+  // Metrics fed by the loop, and per-tag memory gauges refreshed before each snapshot.
+  metrics::MetricHandle frame_time_metric = metrics::invalid_metric;
+  metrics::MetricHandle memory_metrics[mem::TagMax]{};
+  metrics::MetricHandle memory_total_metric = metrics::invalid_metric;
 };
 
 static State app_state{};
 
+// How far create() got: each stage is up once its subsystem has initialized.
+enum CreateStage {
+  StageNone,
+  StageProfile,
+  StageMetrics,
+  StageStrings,
+  StageFrameArena,
+  StageEvent,
+  StageInput,
+  StageJob,
+  StageResource,
+  StageListeners, // The application's listeners and benchmark buffer.
+  StagePlatform,
+};
+
+// Default size of the per-frame scratch arena.
+const u64 default_frame_arena_size = 4 * 1024 * 1024;
+
+// Longest frame delta fed to the simulation, so a stall does not trigger a burst of catch-up steps.
+const f64 max_frame_delta = 0.25;
+
+// Most fixed steps simulated in one frame; time owed beyond that is dropped.
+const u32 max_fixed_steps = 8;
+
+// Upper bound on the time the frame limiter spins instead of sleeping, and on any single oversleep
+// sample, so a scheduler hiccup does not turn the limiter into a busy loop.
+const f64 max_spin_time = 0.002;
+
 // Event handlers.
 
 bool on_event(u16 code, void *sender, void *listener, const event::Context &ctx);
 bool on_key(u16 code, void *sender, void *listener, const event::Context &ctx);
 
+void report_benchmark();
+void collect_memory_metrics(void *data);
+bool update_game(f64 delta_time);
+bool render_game(f64 delta_time);
+void limit_frame_rate(f64 frame_period);
+void unwind_create(CreateStage reached);
+
 bool create(Game &game) {
   static bool initialized = false;
   if (initialized) {
@@ -33,32 +93,115 @@ bool create(Game &game) {
 
   app_state.game = &game;
 
+  // Sample from the start so subsystem setup is covered too.
+  if (game.config.alloc_sample_rate > 0 || game.config.alloc_sample_threshold > 0) {
+    mem::allocation_sampling_start(game.config.alloc_sample_rate,
+                                   game.config.alloc_sample_threshold);
+  }
+
   // Initialize subsystems.
-  log::initialize();
+  if (!log::initialize(game.config.binary_log_path)) {
+    HN_error("Logger failed to initialize. Application cannot continue.");
+    return false;
+  }
+  if (!profile::initialize()) {
+    HN_error("Profiler failed to initialize. Application cannot continue.");
+    unwind_create(StageNone);
+    return false;
+  }
+  profile::set_thread_name("Main");
+  if (!metrics::initialize(game.config.metrics_path, game.config.metrics_interval)) {
+    HN_error("Metrics registry failed to initialize. Application cannot continue.");
+    unwind_create(StageProfile);
+    return false;
+  }
+  app_state.frame_time_metric   = metrics::register_histogram("frame.time");
+  app_state.memory_total_metric = metrics::register_gauge("mem.total.bytes");
+  for (u32 tag = 0; tag < mem::TagMax; ++tag) {
+    char name[metrics::max_name_length];
+    snprintf(name, sizeof(name), "mem.%s.bytes", mem::get_tag_name((mem::Tag)tag));
+    app_state.memory_metrics[tag] = metrics::register_gauge(name);
+  }
+  metrics::add_collector(collect_memory_metrics, nullptr);
+  if (!strings::initialize()) {
+    HN_error("String table failed to initialize. Application cannot continue.");
+    unwind_create(StageMetrics);
+    return false;
+  }
+  u64 frame_arena_size = game.config.frame_arena_size ? game.config.frame_arena_size
+                                                      : default_frame_arena_size;
+  if (!mem::frame_arena_initialize(frame_arena_size)) {
+    HN_error("Frame arena failed to initialize. Application cannot continue.");
+    unwind_create(StageStrings);
+    return false;
+  }
   if (!event::initialize()) {
     HN_error("Event system failed to initialize. Application cannot continue.");
+    unwind_create(StageFrameArena);
     return false;
   }
   if (!input::initialize()) {
     HN_error("Input system failed to initialize. Application cannot continue.");
+    unwind_create(StageEvent);
+    return false;
+  }
+  if (game.config.input_replay_path) {
+    if (!input::replay_start(game.config.input_replay_path, game.config.fixed_timestep)) {
+      unwind_create(StageInput);
+      return false;
+    }
+  } else if (game.config.input_record_path) {
+    if (!input::record_start(game.config.input_record_path, game.config.fixed_timestep)) {
+      unwind_create(StageInput);
+      return false;
+    }
+  }
+  if (!job::initialize(game.config.job_threads)) {
+    HN_error("Job system failed to initialize. Application cannot continue.");
+    unwind_create(StageInput);
+    return false;
+  }
+  resource::Config resource_config{};
+  if (game.config.resource_cache_budget > 0) {
+    resource_config.cache_budget = game.config.resource_cache_budget;
+  }
+  if (!resource::initialize(resource_config)) {
+    HN_error("Resource system failed to initialize. Application cannot continue.");
+    unwind_create(StageJob);
     return false;
   }
 
-  event::register_to_listen(event::SystemEventCode::ApplicationQuit, nullptr, on_event);
-  event::register_to_listen(event::SystemEventCode::KeyPressed, nullptr, on_key);
-  event::register_to_listen(event::SystemEventCode::KeyReleased, nullptr, on_key);
+  app_state.listeners[0] =
+      event::register_to_listen(event::SystemEventCode::ApplicationQuit, nullptr, on_event);
+  app_state.listeners[1] =
+      event::register_to_listen(event::SystemEventCode::KeyPressed, nullptr, on_key);
+  app_state.listeners[2] =
+      event::register_to_listen(event::SystemEventCode::KeyReleased, nullptr, on_key);
 
   app_state.is_running   = true;
   app_state.is_suspended = false;
 
+  if (game.config.benchmark_frames > 0) {
+    app_state.frame_times = (f64 *)mem::allocate(game.config.benchmark_frames * sizeof(f64),
+                                                 mem::TagArray);
+    if (!app_state.frame_times) {
+      HN_error("No memory to time %u benchmark frames.", game.config.benchmark_frames);
+      unwind_create(StageListeners);
+      return false;
+    }
+  }
+
+  app_state.platform.headless = game.config.headless;
   if (!platform::initialize(&app_state.platform, game.config.name, game.config.x, game.config.y,
                             game.config.width, game.config.height)) {
+    unwind_create(StageListeners);
     return false;
   }
 
   // Initialize the game.
   if (!game.initialize(&game)) {
     HN_error("Game failed to initialize.");
+    unwind_create(StagePlatform);
     return false;
   }
 
@@ -67,20 +210,102 @@ bool create(Game &game) {
   return true;
 }
 
+// Takes down what a failed create() brought up, in reverse order. The log stays up so the caller
+// can still report the failure.
+void unwind_create(CreateStage reached) {
+  if (reached >= StagePlatform) {
+    platform::terminate(&app_state.platform);
+  }
+  if (reached >= StageListeners) {
+    for (auto &listener : app_state.listeners) {
+      event::unregister_from_listen(listener);
+      listener = event::invalid_listener;
+    }
+    if (app_state.frame_times) {
+      mem::free(app_state.frame_times, app_state.game->config.benchmark_frames * sizeof(f64),
+                mem::TagArray);
+      app_state.frame_times = nullptr;
+    }
+  }
+  if (reached >= StageResource) {
+    resource::terminate();
+  }
+  if (reached >= StageJob) {
+    job::terminate();
+  }
+  if (reached >= StageInput) {
+    input::terminate();
+  }
+  if (reached >= StageEvent) {
+    event::terminate();
+  }
+  if (reached >= StageFrameArena) {
+    mem::frame_arena_terminate();
+  }
+  if (reached >= StageStrings) {
+    strings::terminate();
+  }
+  if (reached >= StageMetrics) {
+    metrics::terminate();
+  }
+  if (reached >= StageProfile) {
+    profile::terminate();
+  }
+  mem::allocation_sampling_stop();
+
+  // The game state is the application's to free, as after run().
+  platform::free(app_state.game->state);
+  app_state.game->state = nullptr;
+}
+
 bool run() {
-  HN_debug("%s", hn::mem::get_memory_usage());
+  mem::MemoryUsage usage{};
+  char             usage_report[2048];
+  mem::get_memory_usage(usage);
+  mem::format_memory_usage(usage, usage_report, sizeof(usage_report));
+  HN_debug("%s", usage_report);
+
+  const application::Config &config           = app_state.game->config;
+  const u32                  benchmark_frames = config.benchmark_frames;
+  // The benchmark measures the loop itself, so it always runs unthrottled.
+  const f64 frame_period =
+      config.target_frame_rate > 0 && benchmark_frames == 0 ? 1.0 / config.target_frame_rate : 0;
+
+  app_state.last_time       = platform::get_system_time();
+  app_state.next_frame_time = app_state.last_time;
 
   while (app_state.is_running) {
-    if (!platform::poll_events(&app_state.platform)) {
-      app_state.is_running = false;
+    HN_PROFILE_FRAME();
+    f64 frame_start     = platform::get_system_time();
+    f64 delta_time      = frame_start - app_state.last_time;
+    app_state.last_time = frame_start;
+
+    if (input::is_replaying()) {
+      // The recording stands in for the OS, delta time included, so the simulation repeats.
+      if (!input::replay_frame(delta_time)) {
+        HN_info("Input replay finished.");
+        app_state.is_running = false;
+        break;
+      }
+    } else {
+      if (!platform::poll_events(&app_state.platform)) {
+        app_state.is_running = false;
+      }
+      // The OS input gathered since the last frame, in one coalesced batch.
+      input::apply_queued();
     }
+    input::begin_frame();
+    // Deliver the events posted since the last frame, including this frame's OS input.
+    event::dispatch();
+    // Completion callbacks of the loads finished since the last frame.
+    resource::update();
     if (!app_state.is_suspended) {
-      if (!app_state.game->update(app_state.game, 0)) {
+      if (!update_game(delta_time)) {
         HN_error("Game failed to update. Terminating.");
         app_state.is_running = false;
         break;
       }
-      if (!app_state.game->render(app_state.game, 0)) {
+      if (!render_game(delta_time)) {
         HN_error("Game failed to render. Terminating.");
         app_state.is_running = false;
         break;
@@ -88,24 +313,184 @@ bool run() {
       // Note: Input update/state copying should always be handled after any input should be
       // recorded; I.E. before this line. As a safety, input is the last thing to be updated before
       // this frame ends.
-      input::update(0);
+      input::update(delta_time);
+      // Release this frame's scratch allocations.
+      mem::frame_reset();
+    }
+
+    // The frame's own work, before any wait for the next one.
+    f64 frame_time = platform::get_system_time() - frame_start;
+    metrics::histogram_record(app_state.frame_time_metric, (u64)(frame_time * 1000000000.0));
+    metrics::frame_end();
+
+    if (benchmark_frames > 0) {
+      app_state.frame_times[app_state.frame_count++] = frame_time;
+      if (app_state.frame_count == benchmark_frames) {
+        app_state.is_running = false;
+      }
+    }
+
+    if (frame_period > 0) {
+      limit_frame_rate(frame_period);
     }
   }
+  // Close the last frame so it can be exported.
+  HN_PROFILE_FRAME();
 
-  event::unregister_from_listen(event::SystemEventCode::ApplicationQuit, nullptr, on_event);
-  event::unregister_from_listen(event::SystemEventCode::KeyPressed, nullptr, on_key);
-  event::unregister_from_listen(event::SystemEventCode::KeyReleased, nullptr, on_key);
+  if (benchmark_frames > 0) {
+    report_benchmark();
+    mem::free(app_state.frame_times, benchmark_frames * sizeof(f64), mem::TagArray);
+    app_state.frame_times = nullptr;
+  }
+  // Final snapshot while every subsystem is still up.
+  metrics::terminate();
 
+  for (auto listener : app_state.listeners) {
+    event::unregister_from_listen(listener);
+  }
+
+  event::QueueStats queue_stats{};
+  event::get_queue_stats(queue_stats);
+  HN_debug("Event queue: %llu posted, %llu dispatched, %llu dropped, peak depth %llu.",
+           queue_stats.posted, queue_stats.dispatched, queue_stats.dropped, queue_stats.peak_depth);
+
+  // Before the job system: decodes in flight are jobs.
+  resource::terminate();
+  job::terminate();
+  if (config.trace_path) {
+    profile::write_chrome_trace(config.trace_path, profile::max_frames);
+  }
   input::terminate();
   event::terminate();
   platform::terminate(&app_state.platform);
+  profile::terminate();
+
+  mem::FrameArenaStats frame_arena_stats{};
+  mem::get_frame_arena_stats(frame_arena_stats);
+  HN_debug("Frame arena: capacity %llu bytes, peak %llu bytes/frame, %llu overflows (%llu bytes), "
+           "%llu failures.",
+           frame_arena_stats.capacity, frame_arena_stats.peak, frame_arena_stats.overflow_count,
+           frame_arena_stats.overflow_bytes, frame_arena_stats.failures);
+  mem::frame_arena_terminate();
+  strings::terminate();
 
   // Do some cleaning.
   platform::free(app_state.game->state);
 
+  if (config.alloc_sample_rate > 0 || config.alloc_sample_threshold > 0) {
+    mem::allocation_sampling_report(config.alloc_report_path);
+  }
+  log::terminate();
+
+  return true;
+}
+
+f32 get_interpolation_alpha() { return app_state.alpha; }
+
+void collect_memory_metrics(void *data) {
+  mem::MemoryUsage usage{};
+  mem::get_memory_usage(usage);
+  for (u32 tag = 0; tag < mem::TagMax; ++tag) {
+    metrics::gauge_set(app_state.memory_metrics[tag], (f64)usage.tags[tag].bytes);
+  }
+  metrics::gauge_set(app_state.memory_total_metric, (f64)usage.bytes);
+}
+
+// Advances the game by the measured frame delta, or in fixed steps if a timestep is configured.
+bool update_game(f64 delta_time) {
+  Game     *game  = app_state.game;
+  const f64 fixed = game->config.fixed_timestep;
+  if (fixed <= 0) {
+    HN_PROFILE_SCOPE("game->update");
+    return game->update(game, (f32)delta_time);
+  }
+
+  app_state.accumulator += delta_time < max_frame_delta ? delta_time : max_frame_delta;
+  u32 steps = 0;
+  while (app_state.accumulator >= fixed && steps < max_fixed_steps) {
+    HN_PROFILE_SCOPE("game->update");
+    if (!game->update(game, (f32)fixed)) {
+      return false;
+    }
+    app_state.accumulator -= fixed;
+    steps++;
+  }
+  if (app_state.accumulator >= fixed) {
+    // Could not keep up; drop the backlog rather than fall further behind.
+    app_state.accumulator = 0;
+  }
+  app_state.alpha = (f32)(app_state.accumulator / fixed);
   return true;
 }
 
+bool render_game(f64 delta_time) {
+  HN_PROFILE_SCOPE("game->render");
+  return app_state.game->render(app_state.game, (f32)delta_time);
+}
+
+// Waits until the next frame is due: an OS sleep for most of the time, then a short spin for the
+// last fraction so the frame starts on time despite scheduler slack.
+void limit_frame_rate(f64 frame_period) {
+  HN_PROFILE_SCOPE("frame limiter");
+  app_state.next_frame_time += frame_period;
+  f64 now = platform::get_system_time();
+  if (now >= app_state.next_frame_time) {
+    // Over budget. If more than a whole frame late, restart the schedule instead of catching up.
+    if (now - app_state.next_frame_time > frame_period) {
+      app_state.next_frame_time = now;
+    }
+    return;
+  }
+
+  // Sleep until a safety margin before the deadline: the typical oversleep plus two deviations.
+  f64 margin = app_state.oversleep_mean + 2 * app_state.oversleep_deviation;
+  margin     = margin < max_spin_time ? margin : max_spin_time;
+  f64 remaining = app_state.next_frame_time - now;
+  if (remaining > margin) {
+    f64 requested = remaining - margin;
+    platform::sleep_us((u64)(requested * 1000000.0));
+    f64 overslept = platform::get_system_time() - now - requested;
+    overslept     = overslept < max_spin_time ? overslept : max_spin_time;
+    f64 deviation = overslept - app_state.oversleep_mean;
+    app_state.oversleep_mean += deviation * 0.1;
+    app_state.oversleep_deviation += ((deviation < 0 ? -deviation : deviation) -
+                                     app_state.oversleep_deviation) * 0.1;
+  }
+
+  while (platform::get_system_time() < app_state.next_frame_time) {
+    std::this_thread::yield();
+  }
+}
+
+void report_benchmark() {
+  const u32 count = app_state.frame_count;
+  if (count == 0) {
+    HN_warn("Benchmark finished without any frames.");
+    return;
+  }
+
+  f64 *times = app_state.frame_times;
+  f64  total = 0;
+  f64  min   = times[0];
+  for (u32 i = 0; i < count; ++i) {
+    total += times[i];
+    min = std::min(min, times[i]);
+  }
+
+  // p99 is the smallest time that at least 99% of the frames did not exceed: the
+  // ceil(0.99 * count)-th smallest, computed in integers so rounding cannot shift it.
+  u32 p99_index = (u32)(((u64)count * 99 + 99) / 100) - 1;
+  if (p99_index >= count) {
+    p99_index = count - 1;
+  }
+  std::nth_element(times, times + p99_index, times + count);
+
+  HN_info("Benchmark: %u frames in %.3f s, %.1f frames/sec, frame min %.3f us, mean %.3f us, "
+          "p99 %.3f us.",
+          count, total, count / total, min * 1000000.0, total / count * 1000000.0,
+          times[p99_index] * 1000000.0);
+}
+
 bool on_event(u16 code, void *sender, void *listener, const event::Context &ctx) {
   switch (code) {
   case event::SystemEventCode::ApplicationQuit: {
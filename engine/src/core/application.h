@@ -12,15 +12,38 @@ namespace hn::application {
 
 // Application configuration.
 struct Config {
-  const char *name;   // The application name used in windowing.
-  u16         x;      // Window starting position x-axis.
-  u16         y;      // Window starting position y-axis.
-  u16         width;  // Window starting width.
-  u16         height; // Window starting height.
+  const char *name;                   // The application name used in windowing.
+  u16         x;                      // Window starting position x-axis.
+  u16         y;                      // Window starting position y-axis.
+  u16         width;                  // Window starting width.
+  u16         height;                 // Window starting height.
+  bool        headless;               // Run without a window system.
+  u32         benchmark_frames;       // Run this many frames unthrottled, then report.
+  u64         frame_arena_size;       // Per-frame scratch arena in bytes; 0 uses the default.
+  u32         job_threads;            // Job threads incl. main; 0 is one per hardware thread.
+  f32         target_frame_rate;      // Frame limiter target in Hz; 0 runs unthrottled.
+  f32         fixed_timestep;         // Simulation step in seconds; 0 steps once per frame.
+  const char *trace_path;             // Chrome trace of the last frames, written on exit.
+  const char *binary_log_path;        // Binary log file; see tools/log_decode.
+  u32         alloc_sample_rate;      // If non-zero, sample 1 in this many allocations.
+  u64         alloc_sample_threshold; // If non-zero, also sample every allocation this large.
+  const char *alloc_report_path;      // Allocation report file; unset logs it.
+  const char *metrics_path;           // If set, metric snapshots are appended here.
+  u32         metrics_interval;       // Frames between metric snapshots; 0 uses the default.
+  const char *input_record_path;      // If set, input is recorded to this file.
+  const char *input_replay_path;      // If set, input is replayed from this file instead.
+  u64         resource_cache_budget;  // Bytes of unused resources kept loaded; 0 uses the default.
 };
 
 bool create(Game &game);
 
 bool run();
 
+/**
+ * With a fixed timestep, how far the simulation has progressed towards its next step, for
+ * interpolating between the last two simulated states when rendering.
+ * @returns A value in [0, 1); always 0 without a fixed timestep.
+ */
+f32 get_interpolation_alpha();
+
 } // namespace hn::application
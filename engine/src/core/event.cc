@@ -1,112 +1,486 @@
 #include "event.h"
-#include "container/darray.h"
+#include "container/mpsc_queue.h"
 #include "log.h"
 #include "memory.h"
+#include "metrics.h"
+#include "profile.h"
+#include <cstdio>
+#include <cstring>
 
 namespace hn::event {
 
-struct RegisteredEvent {
-  void        *listener;
-  PFN_on_event callback;
+// Listeners of one code, stored as parallel arrays sorted by descending priority so fire walks
+// contiguous memory. Unregistering leaves a null callback behind; the holes are squeezed out once
+// they make up half the entry and no fire of the code is in progress. Listeners registered during
+// a fire are appended and only sorted into place once it is over.
+struct EventCodeEntry {
+  PFN_on_event *callbacks;
+  void        **listeners;
+  i32          *priorities;
+  u32          *slots; // Handle slot of each listener.
+  u32           count;
+  u32           capacity;
+  u32           dead;     // Unregistered entries not yet compacted.
+  u32           unsorted; // Entries at the end registered during a fire, not yet in order.
+  u32           firing;   // Nesting depth of fire/dispatch over this code.
+
+  // Events of this code delivered, fired or dispatched; registered with the first listener.
+  metrics::MetricHandle delivered;
 };
 
-struct EventCodeEntry {
-  RegisteredEvent *events = nullptr;
+// Codes are looked up in two levels, high byte then low byte. Pages are allocated on first use.
+const u32 code_page_size  = 256;
+const u32 code_page_count = 65536 / code_page_size;
+
+// Maps a handle to where its listener lives. Free slots are chained through `index`.
+struct HandleSlot {
+  u16 code;
+  u16 generation;
+  u32 index;
+};
+
+// Handle layout: low bits are the slot, high bits the slot's generation, never zero.
+const u32 handle_slot_bits       = 22;
+const u32 handle_slot_mask       = (1u << handle_slot_bits) - 1;
+const u32 handle_generation_mask = (1u << (32 - handle_slot_bits)) - 1;
+const u32 no_free_slot           = ~0u;
+
+// An event waiting in the deferred queue.
+struct PostedEvent {
+  u16     code;
+  void   *sender;
+  Context ctx;
+};
+
+// Ring buffer of posted events, drained by dispatch.
+struct EventQueue {
+  PostedEvent *events   = nullptr;
+  u32          capacity = 0; // Power of two.
+  u32          head     = 0; // Index of the oldest event.
+  u32          count    = 0;
+  // Dispatch scratch: ring offsets of the current code's batch, and per-offset state.
+  u32         *batch    = nullptr;
+  u8          *status   = nullptr;
+  QueueStats   stats{};
 };
 
-// This should be more than enough codes...
-const int max_message_codes = 100;
+// Events posted from other threads, moved into the EventQueue by dispatch.
+struct ThreadQueue {
+  MpscQueue<PostedEvent> events;
+  std::atomic<u64>       posted{0};
+  std::atomic<u64>       dropped{0};
+};
+
+// Dispatch status of a queued event.
+enum { Pending, Grouped, Consumed };
 
 // State structure.
 struct EventSystemState {
   // Lookup table for event codes.
-  EventCodeEntry registered[max_message_codes];
+  EventCodeEntry *code_pages[code_page_count];
+  // Storage for the code pages.
+  mem::Pool       pages;
+  HandleSlot     *slots;
+  u32             slot_count;
+  u32             slot_capacity;
+  u32             free_slot;
+  EventQueue      queue;
 };
 
 // Event system internal state.
 static EventSystemState state{};
+static ThreadQueue      thread_queue;
 
-bool initialize() {
+bool initialize(u32 queue_capacity) {
   static bool initialized = false;
   if (initialized) {
     return false;
   }
 
   hn::mem::zero(&state, sizeof(state));
+  state.free_slot = no_free_slot;
+  if (!mem::pool_create(state.pages, "EventCodes", code_page_size * sizeof(EventCodeEntry), 4,
+                        mem::TagEvent)) {
+    return false;
+  }
+
+  if (queue_capacity == 0 || (queue_capacity & (queue_capacity - 1))) {
+    HN_error("Event queue capacity %u is not a power of two.", queue_capacity);
+    return false;
+  }
+  EventQueue &queue = state.queue;
+  queue.capacity    = queue_capacity;
+  queue.events      = (PostedEvent *)mem::allocate(queue_capacity * sizeof(PostedEvent),
+                                                   mem::TagEvent, mem::AllocateUninitialized);
+  queue.batch       = (u32 *)mem::allocate(queue_capacity * sizeof(u32), mem::TagEvent);
+  queue.status      = (u8 *)mem::allocate(queue_capacity * sizeof(u8), mem::TagEvent);
+
+  if (!thread_queue.events.create(queue_capacity, mem::TagEvent)) {
+    return false;
+  }
+  thread_queue.posted.store(0, std::memory_order_relaxed);
+  thread_queue.dropped.store(0, std::memory_order_relaxed);
 
   initialized = true;
   HN_debug("Event subsystem initialized.");
   return true;
 }
 
+static u64 entry_block_size(u32 capacity) {
+  return capacity * (sizeof(PFN_on_event) + sizeof(void *) + sizeof(i32) + sizeof(u32));
+}
+
 void terminate() {
-  // Free the events arrays. Objects pointed to should be destroyed on their own.
-  for (auto &entry : state.registered) {
-    if (entry.events) {
-      darray_destroy(entry.events);
+  // Free the listener arrays. Objects pointed to should be destroyed on their own.
+  for (auto &page : state.code_pages) {
+    if (!page) {
+      continue;
     }
+    for (u32 i = 0; i < code_page_size; ++i) {
+      if (page[i].callbacks) {
+        mem::free(page[i].callbacks, entry_block_size(page[i].capacity), mem::TagEvent);
+      }
+    }
+    mem::pool_free(state.pages, page);
+    page = nullptr;
   }
+  mem::pool_destroy(state.pages);
+  mem::free(state.slots, state.slot_capacity * sizeof(HandleSlot), mem::TagEvent);
+  state.slots         = nullptr;
+  state.slot_count    = 0;
+  state.slot_capacity = 0;
+  state.free_slot     = no_free_slot;
+
+  EventQueue &queue = state.queue;
+  mem::free(queue.events, queue.capacity * sizeof(PostedEvent), mem::TagEvent);
+  mem::free(queue.batch, queue.capacity * sizeof(u32), mem::TagEvent);
+  mem::free(queue.status, queue.capacity * sizeof(u8), mem::TagEvent);
+  queue = EventQueue{};
+  thread_queue.events.destroy();
 }
 
-bool register_to_listen(u16 code, void *listener, PFN_on_event on_event) {
-  if (!state.registered[code].events) {
-    state.registered[code].events = (RegisteredEvent *)darray_create(RegisteredEvent);
-  }
+static EventCodeEntry *find_entry(u16 code) {
+  EventCodeEntry *page = state.code_pages[code / code_page_size];
+  return page ? &page[code % code_page_size] : nullptr;
+}
 
-  u64 registered_count = darray_length(state.registered[code].events);
-  for (u64 i = 0; i < registered_count; ++i) {
-    if (state.registered[code].events[i].listener == listener) {
-      // TODO warn
-      return false;
+static EventCodeEntry *find_or_create_entry(u16 code) {
+  EventCodeEntry *&page = state.code_pages[code / code_page_size];
+  if (!page) {
+    page = (EventCodeEntry *)mem::pool_allocate(state.pages);
+    if (!page) {
+      return nullptr;
     }
+    mem::zero(page, code_page_size * sizeof(EventCodeEntry));
   }
+  return &page[code % code_page_size];
+}
 
-  // At this point, no duplicate was found. Proceed with registrations.
-  RegisteredEvent event{listener, on_event};
-  darray_push(state.registered[code].events, event);
-
+// Moves the arrays into a block of the given capacity, keeping the first `count` entries.
+static bool resize_entry(EventCodeEntry &entry, u32 capacity) {
+  u8 *block = (u8 *)mem::allocate(entry_block_size(capacity), mem::TagEvent,
+                                  mem::AllocateUninitialized);
+  if (!block) {
+    return false;
+  }
+  auto callbacks  = (PFN_on_event *)block;
+  auto listeners  = (void **)(callbacks + capacity);
+  auto priorities = (i32 *)(listeners + capacity);
+  auto slots      = (u32 *)(priorities + capacity);
+  if (entry.callbacks) {
+    mem::copy(callbacks, entry.callbacks, entry.count * sizeof(PFN_on_event));
+    mem::copy(listeners, entry.listeners, entry.count * sizeof(void *));
+    mem::copy(priorities, entry.priorities, entry.count * sizeof(i32));
+    mem::copy(slots, entry.slots, entry.count * sizeof(u32));
+    mem::free(entry.callbacks, entry_block_size(entry.capacity), mem::TagEvent);
+  }
+  entry.callbacks  = callbacks;
+  entry.listeners  = listeners;
+  entry.priorities = priorities;
+  entry.slots      = slots;
+  entry.capacity   = capacity;
   return true;
 }
 
-bool unregister_from_listen(u16 code, void *listener, PFN_on_event on_event) {
-  if (!state.registered[code].events) {
-    // TODO warn
-    return false;
+// Moves the entry at `index` before the ones after which it belongs: after every listener of the
+// same or higher priority among the first `index`, which must be in order.
+static void sort_into_place(EventCodeEntry &entry, u32 index) {
+  PFN_on_event callback = entry.callbacks[index];
+  void        *listener = entry.listeners[index];
+  i32          priority = entry.priorities[index];
+  u32          slot     = entry.slots[index];
+
+  u32 target = index;
+  while (target > 0 && entry.priorities[target - 1] < priority) {
+    target--;
+  }
+  u32 moved = index - target;
+  if (moved == 0) {
+    return;
+  }
+  memmove(entry.callbacks + target + 1, entry.callbacks + target, moved * sizeof(PFN_on_event));
+  memmove(entry.listeners + target + 1, entry.listeners + target, moved * sizeof(void *));
+  memmove(entry.priorities + target + 1, entry.priorities + target, moved * sizeof(i32));
+  memmove(entry.slots + target + 1, entry.slots + target, moved * sizeof(u32));
+  for (u32 i = target + 1; i <= index; ++i) {
+    state.slots[entry.slots[i]].index = i;
+  }
+  entry.callbacks[target]  = callback;
+  entry.listeners[target]  = listener;
+  entry.priorities[target] = priority;
+  entry.slots[target]      = slot;
+  state.slots[slot].index  = target;
+}
+
+// Sorts in listeners registered during a fire and squeezes out unregistered entries, unless a
+// fire of this code is walking the arrays.
+static void compact_entry(EventCodeEntry &entry) {
+  if (entry.firing > 0) {
+    return;
+  }
+  for (u32 i = entry.count - entry.unsorted; i < entry.count; ++i) {
+    sort_into_place(entry, i);
+  }
+  entry.unsorted = 0;
+  if (entry.dead == 0) {
+    return;
+  }
+  u32 kept = 0;
+  for (u32 i = 0; i < entry.count; ++i) {
+    if (!entry.callbacks[i]) {
+      continue;
+    }
+    entry.callbacks[kept]                = entry.callbacks[i];
+    entry.listeners[kept]                = entry.listeners[i];
+    entry.priorities[kept]               = entry.priorities[i];
+    entry.slots[kept]                    = entry.slots[i];
+    state.slots[entry.slots[kept]].index = kept;
+    kept++;
+  }
+  entry.count = kept;
+  entry.dead  = 0;
+}
+
+static u32 allocate_slot() {
+  if (state.free_slot != no_free_slot) {
+    u32 slot        = state.free_slot;
+    state.free_slot = state.slots[slot].index;
+    return slot;
+  }
+  if (state.slot_count == state.slot_capacity) {
+    u32 capacity = state.slot_capacity ? state.slot_capacity * 2 : 64;
+    if (capacity > handle_slot_mask + 1) {
+      HN_error("Too many event listeners registered.");
+      return no_free_slot;
+    }
+    auto slots = (HandleSlot *)mem::reallocate(state.slots,
+                                               state.slot_capacity * sizeof(HandleSlot),
+                                               capacity * sizeof(HandleSlot), 0, mem::TagEvent);
+    if (!slots) {
+      return no_free_slot;
+    }
+    state.slots         = slots;
+    state.slot_capacity = capacity;
   }
+  return state.slot_count++;
+}
 
-  u64 registered_count = darray_length(state.registered[code].events);
-  for (u64 i = 0; i < registered_count; ++i) {
-    auto e = state.registered[code].events[i];
-    if (e.listener == listener && e.callback == on_event) {
-      // Found one, remove it.
-      RegisteredEvent popped_event{};
-      darray_pop_at(state.registered[code].events, i, &popped_event);
-      return false;
+ListenerHandle register_to_listen(u16 code, void *listener, PFN_on_event on_event, i32 priority) {
+  EventCodeEntry *entry = find_or_create_entry(code);
+  if (!entry) {
+    return invalid_listener;
+  }
+  if (entry->delivered == metrics::invalid_metric) {
+    char name[metrics::max_name_length];
+    snprintf(name, sizeof(name), "event.delivered.0x%04x", code);
+    entry->delivered = metrics::register_counter(name);
+  }
+  compact_entry(*entry);
+  if (entry->count == entry->capacity) {
+    if (!resize_entry(*entry, entry->capacity ? entry->capacity * 2 : 4)) {
+      return invalid_listener;
     }
   }
+  u32 slot = allocate_slot();
+  if (slot == no_free_slot) {
+    return invalid_listener;
+  }
+
+  HandleSlot &handle_slot = state.slots[slot];
+  handle_slot.code        = code;
+  if (handle_slot.generation == 0) {
+    handle_slot.generation = 1;
+  }
+
+  // Append, then insert after every listener of the same or higher priority. A fire in progress
+  // walks the arrays by index, so there the move waits until it is over.
+  u32 index                = entry->count++;
+  entry->callbacks[index]  = on_event;
+  entry->listeners[index]  = listener;
+  entry->priorities[index] = priority;
+  entry->slots[index]      = slot;
+  handle_slot.index        = index;
+  if (entry->firing > 0) {
+    entry->unsorted++;
+  } else {
+    sort_into_place(*entry, index);
+  }
+  return (ListenerHandle)handle_slot.generation << handle_slot_bits | slot;
+}
+
+bool unregister_from_listen(ListenerHandle handle) {
+  u32 slot       = handle & handle_slot_mask;
+  u32 generation = handle >> handle_slot_bits;
+  if (handle == invalid_listener || slot >= state.slot_count ||
+      state.slots[slot].generation != generation) {
+    HN_warn("Unregistering an invalid or stale listener handle 0x%x.", handle);
+    return false;
+  }
 
-  // Not found.
-  return false;
+  HandleSlot     &handle_slot = state.slots[slot];
+  EventCodeEntry *entry       = find_entry(handle_slot.code);
+
+  entry->callbacks[handle_slot.index] = nullptr;
+  entry->dead++;
+
+  // Retire the slot; bumping the generation invalidates outstanding copies of the handle.
+  handle_slot.generation = (handle_slot.generation + 1) & handle_generation_mask;
+  handle_slot.index      = state.free_slot;
+  state.free_slot        = slot;
+
+  if (entry->dead * 2 >= entry->count) {
+    compact_entry(*entry);
+  }
+  return true;
 }
 
 bool fire(u16 code, void *sender, const Context &ctx) {
   // If nothing is registered for the code, boot out.
-  if (!state.registered[code].events) {
-    // TODO warn
+  EventCodeEntry *entry = find_entry(code);
+  if (!entry || entry->count == entry->dead) {
     return false;
   }
+  HN_PROFILE_SCOPE("event::fire");
+  metrics::counter_add(entry->delivered);
 
-  u64 registered_count = darray_length(state.registered[code].events);
-  for (u64 i = 0; i < registered_count; ++i) {
-    auto e = state.registered[code].events[i];
-    if (e.callback(code, sender, e.listener, ctx)) {
+  // The arrays are re-read every step: a callback may register or unregister listeners. Those
+  // it registers are appended and miss this event.
+  bool      consumed = false;
+  const u32 count    = entry->count;
+  entry->firing++;
+  for (u32 i = 0; i < count; ++i) {
+    PFN_on_event callback = entry->callbacks[i];
+    if (callback && callback(code, sender, entry->listeners[i], ctx)) {
       // Message has been consumed, do not send to other listeners.
-      return false;
+      consumed = true;
+      break;
     }
   }
+  entry->firing--;
+  compact_entry(*entry);
+
+  return consumed;
+}
+
+bool post(u16 code, void *sender, const Context &ctx) {
+  EventQueue &queue = state.queue;
+  if (queue.count == queue.capacity) {
+    queue.stats.dropped++;
+    return false;
+  }
+
+  u32 index           = (queue.head + queue.count) & (queue.capacity - 1);
+  queue.events[index] = PostedEvent{code, sender, ctx};
+  queue.count++;
+  queue.stats.posted++;
+  if (queue.count > queue.stats.peak_depth) {
+    queue.stats.peak_depth = queue.count;
+  }
+  return true;
+}
+
+bool post_from_thread(u16 code, void *sender, const Context &ctx) {
+  if (!thread_queue.events.push(PostedEvent{code, sender, ctx})) {
+    thread_queue.dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  thread_queue.posted.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void dispatch() {
+  HN_PROFILE_SCOPE("event::dispatch");
+  EventQueue &queue = state.queue;
+
+  // Take over what other threads posted, leaving the rest for the next frame if out of room.
+  PostedEvent posted;
+  while (queue.count < queue.capacity && thread_queue.events.pop(posted)) {
+    queue.events[(queue.head + queue.count) & (queue.capacity - 1)] = posted;
+    queue.count++;
+  }
+  if (queue.count > queue.stats.peak_depth) {
+    queue.stats.peak_depth = queue.count;
+  }
+
+  // Only what is queued now; listeners posting new events push them to the next dispatch.
+  const u32 count = queue.count;
+  const u32 mask  = queue.capacity - 1;
+  if (count == 0) {
+    return;
+  }
+  mem::zero(queue.status, count);
+
+  for (u32 first = 0; first < count; ++first) {
+    if (queue.status[first] != Pending) {
+      continue;
+    }
+
+    // Gather the batch of events sharing this code, in posting order.
+    u16 code        = queue.events[(queue.head + first) & mask].code;
+    u32 batch_count = 0;
+    for (u32 i = first; i < count; ++i) {
+      if (queue.status[i] == Pending && queue.events[(queue.head + i) & mask].code == code) {
+        queue.status[i]            = Grouped;
+        queue.batch[batch_count++] = i;
+      }
+    }
+
+    // Walk the listener list once for the whole batch.
+    EventCodeEntry *entry = find_entry(code);
+    if (!entry) {
+      continue;
+    }
+    metrics::counter_add(entry->delivered, batch_count);
+    const u32 listener_count = entry->count;
+    entry->firing++;
+    for (u32 l = 0; l < listener_count; ++l) {
+      for (u32 b = 0; b < batch_count; ++b) {
+        u32          i        = queue.batch[b];
+        PFN_on_event callback = entry->callbacks[l];
+        if (!callback || queue.status[i] == Consumed) {
+          continue;
+        }
+        const PostedEvent &event = queue.events[(queue.head + i) & mask];
+        if (callback(code, event.sender, entry->listeners[l], event.ctx)) {
+          // Message has been consumed, do not send to other listeners.
+          queue.status[i] = Consumed;
+        }
+      }
+    }
+    entry->firing--;
+    compact_entry(*entry);
+  }
+
+  queue.head = (queue.head + count) & mask;
+  queue.count -= count;
+  queue.stats.dispatched += count;
+}
 
-  // Not found.
-  return false;
+void get_queue_stats(QueueStats &out_stats) {
+  out_stats       = state.queue.stats;
+  out_stats.depth = state.queue.count;
+  out_stats.posted += thread_queue.posted.load(std::memory_order_relaxed);
+  out_stats.dropped += thread_queue.dropped.load(std::memory_order_relaxed);
 }
 
 } // namespace hn::event
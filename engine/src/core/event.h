@@ -28,22 +28,99 @@ struct Context {
 // Should return true if handled.
 typedef bool (*PFN_on_event)(u16 code, void *sender, void *listener, const Context &ctx);
 
-bool initialize();
+// Identifies a registration; returned by register_to_listen and passed to unregister_from_listen.
+typedef u32 ListenerHandle;
+
+// Never returned for a successful registration.
+const ListenerHandle invalid_listener = 0;
+
+// Listener priorities. Higher priorities are called first and so get the first chance to consume.
+enum ListenerPriority {
+  PriorityLow    = -100,
+  PriorityNormal = 0,
+  PriorityHigh   = 100,
+};
+
+// Default number of events the deferred queue holds between dispatches.
+const u32 default_queue_capacity = 4096;
+
+/**
+ * Initializes the event system.
+ * @param queue_capacity The number of posted events the deferred queue can hold; a power of two.
+ * @return True on success; otherwise false.
+ */
+bool initialize(u32 queue_capacity = default_queue_capacity);
 void terminate();
 
 /**
- * Register to listen for when events are sent with the provided code. Events with duplicate
- * listener/callback combos will not be registered again and will cause this to return false.
+ * Register to listen for when events are sent with the provided code. Any u16 code can be used.
+ * Listeners are called in descending priority; listeners of equal priority in registration order.
+ * Safe to call from within a callback; a listener registered while its code is being fired or
+ * dispatched only receives later events.
  * @param code The event code to listen for.
  * @param listener A pointer to a listener instance. Can be 0/null.
  * @param on_event The callback function pointer to be invoked when the event code is fired.
- * @return True if the event is successfully registered; otherwise false.
+ * @param priority The order in which the listener gets to see, and possibly consume, the event.
+ * @return A handle for unregistering; invalid_listener on failure.
+ */
+ListenerHandle register_to_listen(u16 code, void *listener, PFN_on_event on_event,
+                                  i32 priority = PriorityNormal);
+
+/**
+ * Stops a listener from receiving events. O(1); safe to call from within a callback.
+ * @param handle The handle returned by register_to_listen.
+ * @return True if the listener was registered; false for an invalid or already-used handle.
+ */
+bool unregister_from_listen(ListenerHandle handle);
+
+/**
+ * Sends an event to the code's listeners immediately.
+ * @return True if a listener consumed the event; otherwise false.
  */
-bool register_to_listen(u16 code, void *listener, PFN_on_event on_event);
-bool unregister_from_listen(u16 code, void *listener, PFN_on_event on_event);
 bool fire(u16 code, void *sender, const Context &ctx);
 
-// System internal event code. Application should use codes beyond 255.
+/**
+ * Queues an event to be delivered on the next dispatch instead of immediately. Use this for bursty
+ * events such as mouse movement; use fire for events that must be handled at the call site.
+ * If the queue is full the event is dropped and counted.
+ * @param code The event code.
+ * @param sender A pointer to the sender. Must stay valid until dispatched. Can be 0/null.
+ * @param ctx The event data, copied into the queue.
+ * @return True if queued; false if dropped.
+ */
+bool post(u16 code, void *sender, const Context &ctx);
+
+/**
+ * Queues an event from any thread, e.g. a loader or simulation worker signalling the main thread.
+ * Lock-free; never blocks. The event is delivered on the main thread by a later dispatch.
+ * If the cross-thread queue is full the event is dropped and counted.
+ * @param code The event code.
+ * @param sender A pointer to the sender. Must stay valid until dispatched. Can be 0/null.
+ * @param ctx The event data, copied into the queue.
+ * @return True if queued; false if dropped.
+ */
+bool post_from_thread(u16 code, void *sender, const Context &ctx);
+
+/**
+ * Delivers the events posted so far, grouped by code so each listener list is walked once per
+ * batch. Each listener receives its events in posting order, and an event consumed by a listener is
+ * not passed on to later ones. Events posted while dispatching are delivered on the next call.
+ * Events from other threads are moved into the frame's queue first, as far as it has room.
+ * Must be called on the main thread; the application does so once per frame.
+ */
+void dispatch();
+
+struct QueueStats {
+  u64 depth;      // Events currently queued.
+  u64 peak_depth; // Most events queued at once.
+  u64 posted;     // Events queued since initialization, from any thread.
+  u64 dispatched; // Events delivered since initialization.
+  u64 dropped;    // Events lost to a full queue since initialization, from any thread.
+};
+
+void get_queue_stats(QueueStats &out_stats);
+
+// System internal event code. Application should use codes beyond 255, up to 0xFFFF.
 enum SystemEventCode {
   // Shuts the application down on the next frame.
   ApplicationQuit = 0x01,
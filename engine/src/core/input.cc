@@ -1,18 +1,24 @@
 #include "input.h"
+#include "container/mpsc_queue.h"
 #include "event.h"
 #include "log.h"
 #include "memory.h"
+#include "metrics.h"
+#include "profile.h"
+#include "platform/platform.h"
+#include <cstdio>
+#include <cstring>
 
 namespace hn::input {
 
 struct KeyboardState {
-  bool keys[KeyMax];
+  KeySet keys;
 };
 
 struct MouseState {
-  f32  x;
-  f32  y;
-  bool buttons[ButtonMax];
+  f32       x;
+  f32       y;
+  ButtonSet buttons;
 };
 
 struct InputState {
@@ -20,69 +26,250 @@ struct InputState {
   KeyboardState keyboard_previous;
   MouseState    mouse_current;
   MouseState    mouse_previous;
+  // Edges from the previous to the current state, computed by begin_frame.
+  KeySet    keys_pressed;
+  KeySet    keys_released;
+  ButtonSet buttons_pressed;
+  ButtonSet buttons_released;
+  u32       frame; // Frames completed, i.e. calls to update.
 };
 
-static bool       initialized = false;
-static InputState state{};
+struct Binding {
+  KeySet    keys;
+  ButtonSet buttons;
+  Action    action;
+};
+
+struct ActionState {
+  char      names[max_actions][max_action_name_length];
+  u32       action_count;
+  Binding   bindings[max_bindings];
+  u32       binding_count;
+  ActionSet down;
+  ActionSet previous; // Down at the end of the last frame.
+  ActionSet pressed;
+  ActionSet released;
+};
+
+static bool        initialized = false;
+static InputState  state{};
+static ActionState actions{};
+
+// Input events processed this frame, and the metrics they feed.
+static u32                   frame_events = 0;
+static metrics::MetricHandle events_metric           = metrics::invalid_metric;
+static metrics::MetricHandle events_per_frame_metric = metrics::invalid_metric;
+
+enum QueuedKind : u8 { QueuedKey, QueuedButton, QueuedMouseMove, QueuedMouseWheel };
+
+struct QueuedInput {
+  u64        timestamp; // Of the first input in a coalesced run.
+  f32        x;         // Mouse position or wheel delta.
+  f32        y;
+  u16        code; // Key or button.
+  bool       pressed;
+  QueuedKind kind;
+};
+
+static MpscQueue<QueuedInput> queue;
+
+// Queued input dropped on a full queue, merged into a run, and the time from the OS to the game.
+static metrics::MetricHandle dropped_metric   = metrics::invalid_metric;
+static metrics::MetricHandle coalesced_metric = metrics::invalid_metric;
+static metrics::MetricHandle latency_metric   = metrics::invalid_metric;
+
+// Recording file layout: a RecordingHeader, then byte-packed records, each a RecordKind followed by
+// its fields. A frame's input records come first and its RecordFrame record closes it.
+const u32 recording_magic   = 0x4e494e48; // "HNIN"
+const u32 recording_version = 1;
+
+struct RecordingHeader {
+  u32 magic;
+  u32 version;
+  f32 fixed_timestep;
+  u32 frame_count; // Written when recording stops.
+};
+
+enum RecordKind : u8 {
+  RecordKey,        // u8 key, u8 pressed
+  RecordButton,     // u8 button, u8 pressed
+  RecordMouseMove,  // f32 x, f32 y
+  RecordMouseWheel, // f32 delta x, f32 delta y
+  RecordFrame,      // u32 frame, f64 delta time
+};
+
+static_assert(KeyMax <= 256 && ButtonMax <= 256, "Key and button codes are recorded as u8.");
+
+struct Recorder {
+  FILE *file        = nullptr;
+  u32   frame_count = 0;
+  f32   fixed_timestep;
+};
+
+struct Replayer {
+  platform::MappedFile file;
+  u64                  offset = 0; // Of the next record.
+};
+
+static Recorder recorder{};
+static Replayer replayer{};
+
+// Appends one record: the kind, then `size` bytes of fields.
+static void record(RecordKind kind, const void *fields, u64 size) {
+  u8 buffer[16];
+  buffer[0] = kind;
+  memcpy(buffer + 1, fields, size);
+  fwrite(buffer, 1, size + 1, recorder.file);
+}
+
+static void record_code(RecordKind kind, u8 code, bool pressed) {
+  u8 fields[2] = {code, (u8)pressed};
+  record(kind, fields, sizeof(fields));
+}
+
+static void record_pair(RecordKind kind, f32 a, f32 b) {
+  f32 fields[2] = {a, b};
+  record(kind, fields, sizeof(fields));
+}
 
 bool initialize() {
   if (initialized) {
     return false;
   }
+  if (!queue.create(input_queue_capacity, mem::TagEvent)) {
+    HN_error("Failed to allocate the input queue.");
+    return false;
+  }
   hn::mem::zero(&state, sizeof(state));
-  initialized = true;
+  hn::mem::zero(&actions, sizeof(actions));
+  frame_events            = 0;
+  events_metric           = metrics::register_counter("input.events");
+  events_per_frame_metric = metrics::register_gauge("input.events_per_frame");
+  dropped_metric          = metrics::register_counter("input.queue.dropped");
+  coalesced_metric        = metrics::register_counter("input.queue.coalesced");
+  latency_metric          = metrics::register_histogram("input.queue.latency");
+  initialized             = true;
   HN_debug("Input subsystem initialized.");
   return true;
 }
 
-void terminate() { initialized = false; }
+void terminate() {
+  record_stop();
+  replay_stop();
+  queue.destroy();
+  initialized = false;
+}
 
 void update(f64 delta_time) {
   if (!initialized) {
     return;
   }
+  HN_PROFILE_SCOPE("input::update");
+  metrics::counter_add(events_metric, frame_events);
+  metrics::gauge_set(events_per_frame_metric, frame_events);
+  frame_events = 0;
+
+  if (recorder.file) {
+    u8 fields[sizeof(u32) + sizeof(f64)];
+    memcpy(fields, &state.frame, sizeof(u32));
+    memcpy(fields + sizeof(u32), &delta_time, sizeof(f64));
+    record(RecordFrame, fields, sizeof(fields));
+    recorder.frame_count++;
+  }
+  state.frame++;
 
   // Copy current states to previous states.
-  hn::mem::copy(&state.keyboard_previous, &state.keyboard_current, sizeof(KeyboardState));
-  hn::mem::copy(&state.mouse_previous, &state.mouse_current, sizeof(MouseState));
+  state.keyboard_previous = state.keyboard_current;
+  state.mouse_previous    = state.mouse_current;
+  actions.previous        = actions.down;
+}
+
+void begin_frame() {
+  if (!initialized) {
+    return;
+  }
+  state.keys_pressed     = state.keyboard_current.keys - state.keyboard_previous.keys;
+  state.keys_released    = state.keyboard_previous.keys - state.keyboard_current.keys;
+  state.buttons_pressed  = state.mouse_current.buttons - state.mouse_previous.buttons;
+  state.buttons_released = state.mouse_previous.buttons - state.mouse_current.buttons;
+
+  ActionSet down{};
+  for (u32 i = 0; i < actions.binding_count; ++i) {
+    const Binding &binding = actions.bindings[i];
+    if (state.keyboard_current.keys.contains(binding.keys) &&
+        state.mouse_current.buttons.contains(binding.buttons)) {
+      down.set(binding.action);
+    }
+  }
+  actions.down     = down;
+  actions.pressed  = down - actions.previous;
+  actions.released = actions.previous - down;
 }
 
 bool is_key_down(Key key) {
   if (!initialized) {
     return false;
   }
-  return state.keyboard_current.keys[key];
+  return state.keyboard_current.keys.test(key);
 }
 
 bool is_key_up(Key key) {
   if (!initialized) {
     return true;
   }
-  return !state.keyboard_current.keys[key];
+  return !state.keyboard_current.keys.test(key);
 }
 
 bool was_key_down(Key key) {
   if (!initialized) {
     return false;
   }
-  return state.keyboard_previous.keys[key];
+  return state.keyboard_previous.keys.test(key);
 }
 
 bool was_key_up(Key key) {
   if (!initialized) {
     return true;
   }
-  return !state.keyboard_previous.keys[key];
+  return !state.keyboard_previous.keys.test(key);
+}
+
+bool is_key_pressed(Key key) {
+  if (!initialized) {
+    return false;
+  }
+  return state.keys_pressed.test(key);
 }
 
+bool is_key_released(Key key) {
+  if (!initialized) {
+    return false;
+  }
+  return state.keys_released.test(key);
+}
+
+const KeySet &get_keys_down() { return state.keyboard_current.keys; }
+
+const KeySet &get_keys_pressed() { return state.keys_pressed; }
+
+const KeySet &get_keys_released() { return state.keys_released; }
+
 void process_key(Key key, bool pressed) {
   // Only handle this if the state actually changed.
-  if (state.keyboard_current.keys[key] == pressed) {
+  if (state.keyboard_current.keys.test(key) == pressed) {
     return;
   }
 
   // Update internal state.
-  state.keyboard_current.keys[key] = pressed;
+  if (pressed) {
+    state.keyboard_current.keys.set(key);
+  } else {
+    state.keyboard_current.keys.reset(key);
+  }
+  frame_events++;
+  if (recorder.file) {
+    record_code(RecordKey, (u8)key, pressed);
+  }
 
   // Fire off an event for immediate processing.
   event::Context context{};
@@ -96,30 +283,46 @@ bool is_button_down(Button button) {
   if (!initialized) {
     return false;
   }
-  return state.mouse_current.buttons[button];
+  return state.mouse_current.buttons.test(button);
 }
 
 bool is_button_up(Button button) {
   if (!initialized) {
     return true;
   }
-  return !state.mouse_current.buttons[button];
+  return !state.mouse_current.buttons.test(button);
 }
 
 bool was_button_down(Button button) {
   if (!initialized) {
     return false;
   }
-  return state.mouse_previous.buttons[button];
+  return state.mouse_previous.buttons.test(button);
 }
 
 bool was_button_up(Button button) {
   if (!initialized) {
     return true;
   }
-  return !state.mouse_previous.buttons[button];
+  return !state.mouse_previous.buttons.test(button);
 }
 
+bool is_button_pressed(Button button) {
+  if (!initialized) {
+    return false;
+  }
+  return state.buttons_pressed.test(button);
+}
+
+bool is_button_released(Button button) {
+  if (!initialized) {
+    return false;
+  }
+  return state.buttons_released.test(button);
+}
+
+const ButtonSet &get_buttons_down() { return state.mouse_current.buttons; }
+
 void get_mouse_position(i32 &x, i32 &y) {
   if (!initialized) {
     x = 0;
@@ -141,11 +344,19 @@ void get_previous_mouse_position(i32 &x, i32 &y) {
 }
 
 void process_button(Button button, bool pressed) {
-  if (state.mouse_current.buttons[button] == pressed) {
+  if (state.mouse_current.buttons.test(button) == pressed) {
     return;
   }
 
-  state.mouse_current.buttons[button] = pressed;
+  if (pressed) {
+    state.mouse_current.buttons.set(button);
+  } else {
+    state.mouse_current.buttons.reset(button);
+  }
+  frame_events++;
+  if (recorder.file) {
+    record_code(RecordButton, (u8)button, pressed);
+  }
 
   event::Context context{};
   context.data.u16[0] = button;
@@ -161,7 +372,13 @@ void process_mouse_move(f32 x, f32 y) {
 
   state.mouse_current.x = x;
   state.mouse_current.y = y;
+  frame_events++;
+  if (recorder.file) {
+    record_pair(RecordMouseMove, x, y);
+  }
 
+  // Fired like keys and buttons, so listeners see input in the order it happened. Bursts are
+  // coalesced by apply_queued before they get here.
   event::Context context{};
   context.data.f32[0] = x;
   context.data.f32[1] = y;
@@ -170,6 +387,10 @@ void process_mouse_move(f32 x, f32 y) {
 
 void process_mouse_wheel(f32 delta_x, f32 delta_y) {
   // Note: No internal state to update.
+  frame_events++;
+  if (recorder.file) {
+    record_pair(RecordMouseWheel, delta_x, delta_y);
+  }
 
   event::Context context{};
   context.data.f32[0] = delta_x;
@@ -177,4 +398,258 @@ void process_mouse_wheel(f32 delta_x, f32 delta_y) {
   event::fire(event::SystemEventCode::MouseWheel, nullptr, context);
 }
 
+Action get_action(const char *name) {
+  for (u32 i = 0; i < actions.action_count; ++i) {
+    if (strncmp(actions.names[i], name, max_action_name_length - 1) == 0) {
+      return (Action)i;
+    }
+  }
+  if (actions.action_count == max_actions) {
+    HN_warn("No room for the action %s.", name);
+    return invalid_action;
+  }
+  snprintf(actions.names[actions.action_count], max_action_name_length, "%s", name);
+  return (Action)actions.action_count++;
+}
+
+bool bind_action(Action action, const KeySet &keys, const ButtonSet &buttons) {
+  if (action >= actions.action_count || (!keys.any() && !buttons.any())) {
+    return false;
+  }
+  if (actions.binding_count == max_bindings) {
+    HN_warn("No room to bind the action %s.", actions.names[action]);
+    return false;
+  }
+  actions.bindings[actions.binding_count++] = {keys, buttons, action};
+  return true;
+}
+
+void clear_bindings() { actions.binding_count = 0; }
+
+bool is_action_down(Action action) { return action < max_actions && actions.down.test(action); }
+
+bool is_action_pressed(Action action) {
+  return action < max_actions && actions.pressed.test(action);
+}
+
+bool is_action_released(Action action) {
+  return action < max_actions && actions.released.test(action);
+}
+
+const ActionSet &get_actions_down() { return actions.down; }
+
+const ActionSet &get_actions_pressed() { return actions.pressed; }
+
+const ActionSet &get_actions_released() { return actions.released; }
+
+static void push(const QueuedInput &input) {
+  if (!queue.push(input)) {
+    metrics::counter_add(dropped_metric);
+  }
+}
+
+void queue_key(Key key, bool pressed, u64 timestamp) {
+  // Keys the platform could not translate.
+  if (key >= KeyMax) {
+    return;
+  }
+  push({timestamp, 0, 0, (u16)key, pressed, QueuedKey});
+}
+
+void queue_button(Button button, bool pressed, u64 timestamp) {
+  push({timestamp, 0, 0, (u16)button, pressed, QueuedButton});
+}
+
+void queue_mouse_move(f32 x, f32 y, u64 timestamp) {
+  push({timestamp, x, y, 0, false, QueuedMouseMove});
+}
+
+void queue_mouse_wheel(f32 delta_x, f32 delta_y, u64 timestamp) {
+  push({timestamp, delta_x, delta_y, 0, false, QueuedMouseWheel});
+}
+
+static void apply(const QueuedInput &input, u64 now) {
+  switch (input.kind) {
+  case QueuedKey: process_key((Key)input.code, input.pressed); break;
+  case QueuedButton: process_button((Button)input.code, input.pressed); break;
+  case QueuedMouseMove: process_mouse_move(input.x, input.y); break;
+  case QueuedMouseWheel: process_mouse_wheel(input.x, input.y); break;
+  }
+  metrics::histogram_record(latency_metric, now > input.timestamp ? now - input.timestamp : 0);
+}
+
+void apply_queued() {
+  if (!initialized) {
+    return;
+  }
+  HN_PROFILE_SCOPE("input::apply_queued");
+  u64         now = platform::get_timestamp_ns();
+  QueuedInput run{};
+  QueuedInput input;
+  bool        pending   = false;
+  u64         coalesced = 0;
+  // Take at most one queue's worth, so producers cannot keep this frame from starting.
+  for (u32 i = 0; i < input_queue_capacity && queue.pop(input); ++i) {
+    if (pending && input.kind == run.kind) {
+      if (input.kind == QueuedMouseMove) {
+        run.x = input.x;
+        run.y = input.y;
+        coalesced++;
+        continue;
+      }
+      if (input.kind == QueuedMouseWheel) {
+        run.x += input.x;
+        run.y += input.y;
+        coalesced++;
+        continue;
+      }
+    }
+    if (pending) {
+      apply(run, now);
+    }
+    run     = input;
+    pending = true;
+  }
+  if (pending) {
+    apply(run, now);
+  }
+  metrics::counter_add(coalesced_metric, coalesced);
+}
+
+bool record_start(const char *path, f32 fixed_timestep) {
+  if (recorder.file || replayer.file.data) {
+    HN_error("Input is already being recorded or replayed.");
+    return false;
+  }
+  recorder.file = fopen(path, "wb");
+  if (!recorder.file) {
+    HN_error("Failed to open %s to record input.", path);
+    return false;
+  }
+  recorder.frame_count    = 0;
+  recorder.fixed_timestep = fixed_timestep;
+  // The frame count is filled in on stop.
+  RecordingHeader header{recording_magic, recording_version, fixed_timestep, 0};
+  fwrite(&header, sizeof(header), 1, recorder.file);
+  HN_info("Recording input to %s.", path);
+  return true;
+}
+
+void record_stop() {
+  if (!recorder.file) {
+    return;
+  }
+  RecordingHeader header{recording_magic, recording_version, recorder.fixed_timestep,
+                         recorder.frame_count};
+  fseek(recorder.file, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, recorder.file);
+  if (fclose(recorder.file) != 0) {
+    HN_error("Failed to finish the input recording.");
+  }
+  recorder.file = nullptr;
+  HN_info("Recorded %u frames of input.", recorder.frame_count);
+}
+
+bool replay_start(const char *path, f32 fixed_timestep) {
+  if (recorder.file || replayer.file.data) {
+    HN_error("Input is already being recorded or replayed.");
+    return false;
+  }
+  if (!platform::map_file(path, replayer.file)) {
+    HN_error("Failed to map the input recording %s.", path);
+    return false;
+  }
+  RecordingHeader header{};
+  if (replayer.file.size < sizeof(header)) {
+    HN_error("%s is not an input recording.", path);
+    replay_stop();
+    return false;
+  }
+  memcpy(&header, replayer.file.data, sizeof(header));
+  if (header.magic != recording_magic || header.version != recording_version) {
+    HN_error("%s is not an input recording of version %u.", path, recording_version);
+    replay_stop();
+    return false;
+  }
+  if (header.fixed_timestep != fixed_timestep) {
+    HN_warn("%s was recorded with a fixed timestep of %g s, not %g s; the replay will diverge.",
+            path, header.fixed_timestep, fixed_timestep);
+  }
+  replayer.offset = sizeof(header);
+  HN_info("Replaying %u frames of input from %s.", header.frame_count, path);
+  return true;
+}
+
+void replay_stop() {
+  platform::unmap_file(replayer.file);
+  replayer.offset = 0;
+}
+
+bool is_replaying() { return replayer.file.data != nullptr; }
+
+// Reads `size` bytes of fields at the replay cursor; fails past the end.
+static bool replay_read(void *fields, u64 size) {
+  if (replayer.offset + size > replayer.file.size) {
+    return false;
+  }
+  memcpy(fields, replayer.file.data + replayer.offset, size);
+  replayer.offset += size;
+  return true;
+}
+
+bool replay_frame(f64 &out_delta_time) {
+  if (!replayer.file.data) {
+    return false;
+  }
+  HN_PROFILE_SCOPE("input::replay_frame");
+  u8 kind;
+  while (replay_read(&kind, sizeof(kind))) {
+    switch (kind) {
+    case RecordKey:
+    case RecordButton: {
+      u8 fields[2];
+      if (!replay_read(fields, sizeof(fields)) ||
+          fields[0] >= (kind == RecordKey ? (u32)KeyMax : (u32)ButtonMax)) {
+        break;
+      }
+      if (kind == RecordKey) {
+        process_key((Key)fields[0], fields[1]);
+      } else {
+        process_button((Button)fields[0], fields[1]);
+      }
+      continue;
+    }
+    case RecordMouseMove:
+    case RecordMouseWheel: {
+      f32 fields[2];
+      if (!replay_read(fields, sizeof(fields))) {
+        break;
+      }
+      if (kind == RecordMouseMove) {
+        process_mouse_move(fields[0], fields[1]);
+      } else {
+        process_mouse_wheel(fields[0], fields[1]);
+      }
+      continue;
+    }
+    case RecordFrame: {
+      u32 frame;
+      if (!replay_read(&frame, sizeof(frame)) || !replay_read(&out_delta_time, sizeof(f64))) {
+        break;
+      }
+      if (frame != state.frame) {
+        HN_error("The input recording is at frame %u but the game at frame %u.", frame,
+                 state.frame);
+        return false;
+      }
+      return true;
+    }
+    }
+    HN_error("Malformed input recording at offset %llu.", replayer.offset);
+    return false;
+  }
+  // A clean end: the last frame record was the final record.
+  return false;
+}
+
 } // namespace hn::input
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "container/bitset.h"
 #include "defines.h"
 
 namespace hn::input {
@@ -35,10 +36,20 @@ enum Key {
   KeyMax,
 };
 
+// One bit per Key or Button code.
+typedef BitSet<KeyMax>    KeySet;
+typedef BitSet<ButtonMax> ButtonSet;
+
 bool initialize();
 void terminate();
 void update(f64 delta_time);
 
+/**
+ * Computes this frame's pressed and released edges and resolves the action bindings, a word at a
+ * time. Call once per frame, after the frame's input has been applied and before the game updates.
+ */
+void begin_frame();
+
 // Keyboard input.
 
 /**
@@ -57,6 +68,15 @@ bool is_key_up(Key key);
 bool was_key_down(Key key);
 bool was_key_up(Key key);
 
+// Whether the key went down or up this frame, as of begin_frame.
+bool is_key_pressed(Key key);
+bool is_key_released(Key key);
+
+// Every key at once: down now, and pressed or released this frame as of begin_frame.
+const KeySet &get_keys_down();
+const KeySet &get_keys_pressed();
+const KeySet &get_keys_released();
+
 /**
  * Sets the state for the given key.
  * @param key The key to be processed.
@@ -70,10 +90,111 @@ bool is_button_down(Button button);
 bool is_button_up(Button button);
 bool was_button_down(Button button);
 bool was_button_up(Button button);
+bool is_button_pressed(Button button);
+bool is_button_released(Button button);
+const ButtonSet &get_buttons_down();
 void get_mouse_position(i32 &x, i32 &y);
 void get_previous_mouse_position(i32 &x, i32 &y);
 void process_button(Button button, bool pressed);
 void process_mouse_move(f32 x, f32 y);
 void process_mouse_wheel(f32 delta_x, f32 delta_y);
 
+// Actions. Named actions are bound to chords of keys and buttons and resolved by begin_frame into
+// action bitsets, so a game can test any number of its bindings with a few word operations.
+
+// Actions that can be registered.
+const u32 max_actions = 256;
+
+// Bindings over all actions.
+const u32 max_bindings = 512;
+
+// Longest action name, including the terminator.
+const u32 max_action_name_length = 32;
+
+typedef BitSet<max_actions> ActionSet;
+
+// Index of an action, and of its bit in an ActionSet.
+typedef u16 Action;
+
+const Action invalid_action = 0xffff;
+
+/**
+ * Finds an action by name, registering it on first use. Actions are numbered from 0 in the order
+ * they are registered.
+ * @returns The action, or invalid_action if there is no room for more.
+ */
+Action get_action(const char *name);
+
+/**
+ * Binds an action to a chord: the binding holds while every key and button of the chord is down.
+ * An action can have several bindings and is down while any of them holds.
+ * @param action The action to bind.
+ * @param keys The keys of the chord.
+ * @param buttons The mouse buttons of the chord.
+ * @returns True on success; false if the action is invalid, the chord empty or there is no room.
+ */
+bool bind_action(Action action, const KeySet &keys, const ButtonSet &buttons = {});
+
+// Removes every binding; the actions stay registered.
+void clear_bindings();
+
+bool is_action_down(Action action);
+bool is_action_pressed(Action action);
+bool is_action_released(Action action);
+
+// Every action at once, as of begin_frame.
+const ActionSet &get_actions_down();
+const ActionSet &get_actions_pressed();
+const ActionSet &get_actions_released();
+
+// Queued input. The platform layer pushes OS input here from any thread, lock-free, stamped with
+// the time it happened on the platform::get_timestamp_ns clock; the main thread applies it in one
+// batch at the start of the frame. Runs of mouse moves collapse to their last position and runs of
+// wheel deltas to their sum, so a burst of high-rate mouse input costs one event per run. Every
+// event is fired as its input is applied, so listeners see keys, buttons and mouse moves in the
+// order they happened.
+
+// Queued input the queue holds before further input is dropped.
+const u32 input_queue_capacity = 4096;
+
+void queue_key(Key key, bool pressed, u64 timestamp);
+void queue_button(Button button, bool pressed, u64 timestamp);
+void queue_mouse_move(f32 x, f32 y, u64 timestamp);
+void queue_mouse_wheel(f32 delta_x, f32 delta_y, u64 timestamp);
+
+// Applies the queued input through the process_* functions. Call once per frame, on the main
+// thread, after platform::poll_events.
+void apply_queued();
+
+// Recording and replay. A recording holds every input change, stamped with the frame it happened
+// in, and each frame's delta time, so a replay feeds the game the same input at the same frames and
+// with the same timing.
+
+/**
+ * Starts recording input to a file, replacing its contents.
+ * @param path The file to write.
+ * @param fixed_timestep The simulation step, stored so a replay can check it matches.
+ * @returns True on success; otherwise false.
+ */
+bool record_start(const char *path, f32 fixed_timestep);
+void record_stop();
+
+/**
+ * Memory-maps a recording for replay. Cannot be combined with recording.
+ * @param path The recording to replay.
+ * @param fixed_timestep The simulation step of this run; a mismatch is warned about.
+ * @returns True on success; otherwise false.
+ */
+bool replay_start(const char *path, f32 fixed_timestep);
+void replay_stop();
+bool is_replaying();
+
+/**
+ * Injects the current frame's recorded input through the process_* functions. Called once per frame
+ * in place of platform::poll_events.
+ * @param out_delta_time Receives the frame's recorded delta time.
+ * @returns False once the recording is exhausted or turns out to be malformed.
+ */
+bool replay_frame(f64 &out_delta_time);
+
 } // namespace hn::input
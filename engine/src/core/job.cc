@@ -0,0 +1,300 @@
+#include "job.h"
+#include "log.h"
+#include "memory.h"
+#include "profile.h"
+#include <cstdio>
+#include <new>
+#include <thread>
+
+namespace hn::job {
+
+// A queued job. The fields are atomics because a thief may read a slot while its owner reuses it;
+// the thief only keeps what it read if its claim on the slot succeeds.
+struct Job {
+  std::atomic<PFN_job>   function;
+  std::atomic<void *>    data;
+  std::atomic<Counter *> counter;
+};
+
+// Jobs a worker can have queued at once. When full, run executes the job inline.
+const i64 deque_capacity = 4096;
+
+// Idle rounds a worker spins through before going to sleep.
+const u32 spin_limit = 64;
+
+// Per-thread Chase-Lev deque. The owner pushes and pops at the bottom; other workers steal from
+// the top. Top and bottom live on separate cache lines.
+struct Worker {
+  alignas(64) std::atomic<i64> top{0};
+  alignas(64) std::atomic<i64> bottom{0};
+  Job        *jobs = nullptr;
+  std::thread thread;
+  u32         random = 0; // Victim selection state.
+};
+
+struct JobSystemState {
+  Worker           *workers = nullptr;
+  u32               count   = 1;
+  std::atomic<bool> running{false};
+  // Bumped whenever a job is queued; sleeping workers wait for it to change.
+  std::atomic<u32> epoch{0};
+  std::atomic<u32> sleepers{0};
+};
+
+static JobSystemState state{};
+
+// The calling thread's worker; null for threads the job system does not know about.
+static thread_local Worker *local = nullptr;
+
+struct JobData {
+  PFN_job  function;
+  void    *data;
+  Counter *counter;
+};
+
+static bool push(Worker &worker, const JobData &job) {
+  i64 bottom = worker.bottom.load(std::memory_order_relaxed);
+  i64 top    = worker.top.load(std::memory_order_acquire);
+  if (bottom - top >= deque_capacity) {
+    return false;
+  }
+  Job &slot = worker.jobs[bottom & (deque_capacity - 1)];
+  slot.function.store(job.function, std::memory_order_relaxed);
+  slot.data.store(job.data, std::memory_order_relaxed);
+  slot.counter.store(job.counter, std::memory_order_relaxed);
+  // Publishes the slot (and whatever the job's data points to) to thieves.
+  worker.bottom.store(bottom + 1, std::memory_order_release);
+  return true;
+}
+
+static void read_slot(const Job &slot, JobData &out_job) {
+  out_job.function = slot.function.load(std::memory_order_relaxed);
+  out_job.data     = slot.data.load(std::memory_order_relaxed);
+  out_job.counter  = slot.counter.load(std::memory_order_relaxed);
+}
+
+static bool pop(Worker &worker, JobData &out_job) {
+  i64 bottom = worker.bottom.load(std::memory_order_relaxed) - 1;
+  worker.bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  i64 top = worker.top.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    // Empty.
+    worker.bottom.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+  read_slot(worker.jobs[bottom & (deque_capacity - 1)], out_job);
+  if (top == bottom) {
+    // Last job: race the thieves for it.
+    bool won = worker.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed);
+    worker.bottom.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+static bool steal(Worker &worker, JobData &out_job) {
+  i64 top = worker.top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  i64 bottom = worker.bottom.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return false;
+  }
+  read_slot(worker.jobs[top & (deque_capacity - 1)], out_job);
+  return worker.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+}
+
+// Takes a job from the worker's own deque, or steals one starting at a random victim.
+static bool find_job(Worker &self, JobData &out_job) {
+  if (pop(self, out_job)) {
+    return true;
+  }
+  if (state.count < 2) {
+    return false;
+  }
+
+  // xorshift32
+  self.random ^= self.random << 13;
+  self.random ^= self.random >> 17;
+  self.random ^= self.random << 5;
+  u32 first = self.random % state.count;
+  for (u32 i = 0; i < state.count; ++i) {
+    Worker &victim = state.workers[(first + i) % state.count];
+    if (&victim != &self && steal(victim, out_job)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void execute(const JobData &job) {
+  HN_PROFILE_SCOPE("job");
+  job.function(job.data);
+  if (job.counter) {
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+static void worker_loop(Worker *self) {
+  local = self;
+  char name[32];
+  snprintf(name, sizeof(name), "Job worker %u", (u32)(self - state.workers));
+  profile::set_thread_name(name);
+
+  u32     idle = 0;
+  JobData job;
+  while (state.running.load(std::memory_order_acquire)) {
+    if (find_job(*self, job)) {
+      execute(job);
+      idle = 0;
+      continue;
+    }
+    if (++idle < spin_limit) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Announce sleeping, then look once more so a job queued in between is not missed.
+    u32 epoch = state.epoch.load();
+    state.sleepers.fetch_add(1);
+    if (find_job(*self, job)) {
+      state.sleepers.fetch_sub(1);
+      execute(job);
+      idle = 0;
+      continue;
+    }
+    if (state.running.load()) {
+      state.epoch.wait(epoch);
+    }
+    state.sleepers.fetch_sub(1);
+    idle = 0;
+  }
+  local = nullptr;
+}
+
+bool initialize(u32 thread_count) {
+  if (state.workers) {
+    HN_error("Job system is already initialized.");
+    return false;
+  }
+  if (thread_count == 0) {
+    thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0) {
+      thread_count = 1;
+    }
+  }
+
+  state.workers = (Worker *)mem::allocate_aligned(thread_count * sizeof(Worker), alignof(Worker),
+                                                  mem::TagJob);
+  if (!state.workers) {
+    return false;
+  }
+  state.count = thread_count;
+  state.running.store(true);
+  for (u32 i = 0; i < thread_count; ++i) {
+    Worker *worker = new (&state.workers[i]) Worker();
+    worker->jobs   = (Job *)mem::allocate(deque_capacity * sizeof(Job), mem::TagJob);
+    worker->random = 0x9E3779B9u * (i + 1);
+  }
+
+  // The calling thread is worker 0 and executes jobs while it waits.
+  local = &state.workers[0];
+  for (u32 i = 1; i < thread_count; ++i) {
+    state.workers[i].thread = std::thread(worker_loop, &state.workers[i]);
+  }
+
+  HN_debug("Job subsystem initialized with %u threads.", thread_count);
+  return true;
+}
+
+void terminate() {
+  if (!state.workers) {
+    return;
+  }
+
+  state.running.store(false);
+  state.epoch.fetch_add(1);
+  state.epoch.notify_all();
+  for (u32 i = 0; i < state.count; ++i) {
+    Worker &worker = state.workers[i];
+    if (worker.thread.joinable()) {
+      worker.thread.join();
+    }
+    mem::free(worker.jobs, deque_capacity * sizeof(Job), mem::TagJob);
+    worker.~Worker();
+  }
+  mem::free_aligned(state.workers, state.count * sizeof(Worker), alignof(Worker), mem::TagJob);
+  state.workers = nullptr;
+  state.count   = 1;
+  local         = nullptr;
+}
+
+void run(PFN_job job, void *data, Counter *counter) {
+  if (counter) {
+    counter->pending.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Unknown threads and full deques run the job right away.
+  JobData job_data{job, data, counter};
+  if (!local || !push(*local, job_data)) {
+    execute(job_data);
+    return;
+  }
+
+  state.epoch.fetch_add(1);
+  if (state.sleepers.load() > 0) {
+    state.epoch.notify_one();
+  }
+}
+
+void wait(Counter &counter) {
+  JobData job;
+  while (counter.pending.load(std::memory_order_acquire) > 0) {
+    if (local && find_job(*local, job)) {
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+struct Batch {
+  PFN_job_range job;
+  void         *data;
+  u32           begin;
+  u32           end;
+};
+
+static void run_batch(void *data) {
+  auto batch = (Batch *)data;
+  batch->job(batch->begin, batch->end, batch->data);
+}
+
+void parallel_for(u32 count, u32 batch_size, PFN_job_range job, void *data) {
+  if (batch_size == 0) {
+    batch_size = 1;
+  }
+  u32 batch_count = (count + batch_size - 1) / batch_size;
+  if (batch_count <= 1 || state.count < 2) {
+    job(0, count, data);
+    return;
+  }
+
+  auto    batches = (Batch *)mem::allocate(batch_count * sizeof(Batch), mem::TagJob,
+                                           mem::AllocateUninitialized);
+  Counter counter;
+  for (u32 i = 0; i < batch_count; ++i) {
+    u32 begin  = i * batch_size;
+    batches[i] = Batch{job, data, begin, count - begin < batch_size ? count : begin + batch_size};
+    run(run_batch, &batches[i], &counter);
+  }
+  wait(counter);
+  mem::free(batches, batch_count * sizeof(Batch), mem::TagJob);
+}
+
+u32 get_thread_count() { return state.count; }
+
+} // namespace hn::job
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "defines.h"
+#include <atomic>
+
+namespace hn::job {
+
+typedef void (*PFN_job)(void *data);
+
+// Range callback for parallel_for: processes items [begin, end).
+typedef void (*PFN_job_range)(u32 begin, u32 end, void *data);
+
+// Tracks a group of jobs. Incremented when a job is queued, decremented when it finishes, so a
+// zero value means the whole group is done. Use it as a fence before work that depends on them.
+struct Counter {
+  std::atomic<i32> pending{0};
+};
+
+/**
+ * Starts the workers. Each worker owns a work-stealing deque; idle workers steal from the others.
+ * @param thread_count Threads executing jobs, the calling (main) thread included. Zero uses one
+ * per hardware thread.
+ * @return True on success; otherwise false.
+ */
+bool initialize(u32 thread_count = 0);
+void terminate();
+
+/**
+ * Queues a job on the calling thread's deque. Must be called from the main thread or from a job.
+ * @param job The function to run.
+ * @param data Passed to the job.
+ * @param counter Optional; incremented now and decremented when the job has run.
+ */
+void run(PFN_job job, void *data, Counter *counter = nullptr);
+
+/**
+ * Runs queued jobs on the calling thread until the counter drops to zero.
+ * @param counter The counter of the jobs to wait for.
+ */
+void wait(Counter &counter);
+
+/**
+ * Splits [0, count) into batches, runs them across the workers and waits for all of them.
+ * @param count The number of items.
+ * @param batch_size The number of items per job.
+ * @param job Called once per batch.
+ * @param data Passed to every batch.
+ */
+void parallel_for(u32 count, u32 batch_size, PFN_job_range job, void *data);
+
+// The number of threads executing jobs, the main thread included; one before initialization.
+u32 get_thread_count();
+
+} // namespace hn::job
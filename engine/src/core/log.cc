@@ -1,7 +1,453 @@
 #include "log.h"
+#include "container/mpsc_queue.h"
+#include "memory.h"
+#include "platform/platform.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <thread>
 
-namespace hn::log{
+namespace hn::log {
 
-void initialize(){}
+enum RecordKind : u8 {
+  KindText,         // The start of a text message.
+  KindContinuation, // More text of the message before it.
+  KindBinary,       // Format string and encoded arguments.
+};
 
+// A fixed-size message record. Text longer than the payload continues in the next records, which
+// are queued together so no other message lands in between.
+struct Record {
+  u64         timestamp;
+  const char *file;
+  const char *function;
+  const char *format;
+  u32         line;
+  u16         size; // Bytes used in the payload.
+  u8          level;
+  u8          kind;
+  bool        more; // Text continues in the next record.
+  u8          payload[record_payload_size];
+};
+
+// Strings already written to the binary file, by address. Open addressing; when full, strings
+// are written again with every record that uses them.
+const u32 string_table_capacity = 4096;
+
+struct LogState {
+  MpscQueue<Record> queue;
+  std::thread       writer;
+  std::atomic<bool> running{false};
+  std::atomic<bool> binary{false};
+  FILE             *binary_file = nullptr;
+  const char      **strings     = nullptr;
+  // Records pushed, written and dropped; flush waits for written to catch up with pushed.
+  alignas(64) std::atomic<u64> pushed{0};
+  std::atomic<u64>             dropped{0};
+  alignas(64) std::atomic<u64> written{0};
+  // The writer sleeps on the epoch once the queue is empty; producers bump it to wake it.
+  std::atomic<u32>  epoch{0};
+  std::atomic<bool> sleeping{false};
+};
+
+static LogState state{};
+
+static const char *level_strings[] = {"[D]", "\033[1;32m[I]\033[0m", "\033[1;33m[W]\033[0m",
+                                      "\033[1;31m[E]\033[0m", "\033[1;41m[F]\033[0m"};
+
+static void print_prefix(Level level, const char *file, const char *function, u32 line) {
+  fprintf(stdout, "%s \033[1;30m%s:%s:%u\033[0m ", level_strings[level], file, function, line);
+}
+
+static void wake_writer() {
+  // Pairs with the fence in writer_loop: either the writer sees the new record, or we see it
+  // sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (state.sleeping.load(std::memory_order_relaxed)) {
+    state.epoch.fetch_add(1, std::memory_order_release);
+    state.epoch.notify_one();
+  }
+}
+
+static bool push(const Record *records, u32 count = 1) {
+  if (!state.queue.push_range(records, count)) {
+    state.dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  state.pushed.fetch_add(count, std::memory_order_release);
+  return true;
+}
+
+// Writes a string definition unless the string has been written before.
+static void write_string_once(const char *string) {
+  u64 hash = ((u64)string * 0x9e3779b97f4a7c15ull) >> 32;
+  for (u32 probe = 0; probe < string_table_capacity; ++probe) {
+    const char *&slot = state.strings[(hash + probe) & (string_table_capacity - 1)];
+    if (slot == string) {
+      return;
+    }
+    if (!slot) {
+      slot = string;
+      break;
+    }
+  }
+
+  FILE *file   = state.binary_file;
+  u64   id     = (u64)string;
+  u32   length = (u32)strlen(string);
+  fputc(BinaryString, file);
+  fwrite(&id, sizeof(id), 1, file);
+  fwrite(&length, sizeof(length), 1, file);
+  fwrite(string, 1, length, file);
 }
+
+static void write_record(const Record &record) {
+  if (record.kind == KindBinary) {
+    write_string_once(record.file);
+    write_string_once(record.function);
+    write_string_once(record.format);
+
+    FILE *file = state.binary_file;
+    u64   ids[3]{(u64)record.file, (u64)record.function, (u64)record.format};
+    fputc(BinaryRecord, file);
+    fwrite(&record.timestamp, sizeof(record.timestamp), 1, file);
+    fputc(record.level, file);
+    fwrite(&record.line, sizeof(record.line), 1, file);
+    fwrite(ids, sizeof(ids), 1, file);
+    fwrite(&record.size, sizeof(record.size), 1, file);
+    fwrite(record.payload, 1, record.size, file);
+    return;
+  }
+
+  if (record.kind == KindText) {
+    print_prefix((Level)record.level, record.file, record.function, record.line);
+  }
+  fwrite(record.payload, 1, record.size, stdout);
+  if (!record.more) {
+    fputc('\n', stdout);
+  }
+}
+
+static void writer_loop() {
+  Record record;
+  u64    count = 0;
+  while (true) {
+    bool running = state.running.load(std::memory_order_acquire);
+    while (state.queue.pop(record)) {
+      write_record(record);
+      count++;
+    }
+    fflush(state.binary_file ? state.binary_file : stdout);
+    state.written.store(count, std::memory_order_release);
+    if (!running) {
+      break; // Drained after the stop request.
+    }
+
+    // Announce sleeping, then look once more so a record pushed in between is not missed.
+    u32 epoch = state.epoch.load(std::memory_order_acquire);
+    state.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (state.pushed.load(std::memory_order_acquire) == count &&
+        state.running.load(std::memory_order_acquire)) {
+      state.epoch.wait(epoch, std::memory_order_acquire);
+    }
+    state.sleeping.store(false, std::memory_order_relaxed);
+  }
+}
+
+bool initialize(const char *binary_path, u32 queue_capacity) {
+  if (state.running.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  if (!state.queue.create(queue_capacity, mem::TagLog)) {
+    return false;
+  }
+  if (binary_path) {
+    state.binary_file = fopen(binary_path, "wb");
+    if (!state.binary_file) {
+      HN_error("Failed to open the binary log %s.", binary_path);
+      state.queue.destroy();
+      return false;
+    }
+    state.strings = (const char **)mem::allocate(string_table_capacity * sizeof(const char *),
+                                                 mem::TagLog);
+    fwrite(&binary_magic, sizeof(binary_magic), 1, state.binary_file);
+    fwrite(&binary_version, sizeof(binary_version), 1, state.binary_file);
+  }
+
+  state.pushed.store(0, std::memory_order_relaxed);
+  state.written.store(0, std::memory_order_relaxed);
+  state.dropped.store(0, std::memory_order_relaxed);
+  state.binary.store(binary_path != nullptr, std::memory_order_relaxed);
+  state.running.store(true, std::memory_order_release);
+  state.writer = std::thread(writer_loop);
+  return true;
+}
+
+// Other threads must have stopped logging.
+void terminate() {
+  if (!state.running.load(std::memory_order_relaxed)) {
+    return;
+  }
+  // Producers still logging from here on write synchronously.
+  state.binary.store(false, std::memory_order_relaxed);
+  state.running.store(false, std::memory_order_release);
+  state.epoch.fetch_add(1, std::memory_order_release);
+  state.epoch.notify_one();
+  state.writer.join();
+
+  u64 dropped = state.dropped.load(std::memory_order_relaxed);
+  if (state.binary_file) {
+    fclose(state.binary_file);
+    state.binary_file = nullptr;
+    mem::free(state.strings, string_table_capacity * sizeof(const char *), mem::TagLog);
+    state.strings = nullptr;
+  }
+  state.queue.destroy();
+  if (dropped > 0) {
+    HN_warn("%llu log messages were dropped because the queue was full.", dropped);
+  }
+}
+
+void flush() {
+  if (!state.running.load(std::memory_order_acquire)) {
+    fflush(stdout);
+    return;
+  }
+  u64 target = state.pushed.load(std::memory_order_acquire);
+  while (state.written.load(std::memory_order_acquire) < target) {
+    state.epoch.fetch_add(1, std::memory_order_release);
+    state.epoch.notify_one();
+    std::this_thread::yield();
+  }
+}
+
+u64 get_dropped_count() { return state.dropped.load(std::memory_order_relaxed); }
+
+bool is_binary() { return state.binary.load(std::memory_order_relaxed); }
+
+void write_text(Level level, const char *file, const char *function, u32 line, const char *format,
+                ...) {
+  char    text[max_message_length];
+  va_list args;
+  va_start(args, format);
+  i32 length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  u32 size = (u32)length < sizeof(text) ? (u32)length : (u32)sizeof(text) - 1;
+
+  if (!state.running.load(std::memory_order_acquire)) {
+    print_prefix(level, file, function, line);
+    fwrite(text, 1, size, stdout);
+    fputc('\n', stdout);
+    return;
+  }
+
+  // All of the message's records go into the queue at once, or none of them.
+  Record records[max_message_length / record_payload_size + 1];
+  u64    timestamp = platform::get_timestamp_ns();
+  u32    count     = 0;
+  u32    offset    = 0;
+  do {
+    Record &record   = records[count++];
+    u32     chunk    = size - offset < record_payload_size ? size - offset : record_payload_size;
+    record.timestamp = timestamp;
+    record.file      = file;
+    record.function  = function;
+    record.format    = format;
+    record.line      = line;
+    record.level     = level;
+    record.kind      = count == 1 ? KindText : KindContinuation;
+    record.size      = (u16)chunk;
+    memcpy(record.payload, text + offset, chunk);
+    offset += chunk;
+    record.more = offset < size;
+  } while (offset < size);
+  push(records, count);
+
+  wake_writer();
+  if (level == LevelFatal) {
+    flush();
+  }
+}
+
+void write_binary(Level level, const char *file, const char *function, u32 line,
+                  const char *format, const u8 *args, u32 args_size) {
+  Record record;
+  record.timestamp = platform::get_timestamp_ns();
+  record.file      = file;
+  record.function  = function;
+  record.format    = format;
+  record.line      = line;
+  record.size      = (u16)args_size;
+  record.level     = level;
+  record.kind      = KindBinary;
+  record.more      = false;
+  memcpy(record.payload, args, args_size);
+  push(&record);
+
+  wake_writer();
+  if (level == LevelFatal) {
+    flush();
+  }
+}
+
+// Reads the next encoded argument as the given C type; missing arguments read as zero.
+struct ArgDecoder {
+  const u8 *data;
+  u32       size;
+  u32       offset = 0;
+
+  // Fails at the end of the arguments, and for good once an argument runs past it.
+  bool next(ArgType &type, u64 &bits, const char *&string, u16 &length) {
+    if (offset >= size) {
+      return false;
+    }
+    type = (ArgType)data[offset++];
+    if (type == ArgString) {
+      if ((u64)offset + sizeof(length) > size) {
+        offset = size;
+        return false;
+      }
+      memcpy(&length, data + offset, sizeof(length));
+      if ((u64)offset + sizeof(length) + length > size) {
+        offset = size;
+        return false;
+      }
+      string = (const char *)data + offset + sizeof(length);
+      offset += sizeof(length) + length;
+    } else {
+      if ((u64)offset + sizeof(bits) > size) {
+        offset = size;
+        return false;
+      }
+      memcpy(&bits, data + offset, sizeof(bits));
+      offset += sizeof(bits);
+    }
+    return true;
+  }
+
+  i64 next_int() {
+    ArgType     type;
+    u64         bits = 0;
+    const char *string;
+    u16         length;
+    if (!next(type, bits, string, length)) {
+      return 0;
+    }
+    if (type == ArgFloat) {
+      f64 value;
+      memcpy(&value, &bits, sizeof(value));
+      return (i64)value;
+    }
+    return type == ArgString ? 0 : (i64)bits;
+  }
+};
+
+u64 format_arguments(char *out, u64 size, const char *format, const u8 *args, u32 args_size) {
+  if (size == 0) {
+    return 0;
+  }
+  ArgDecoder decoder{args, args_size};
+  u64        length = 0;
+  auto       emit   = [&](i32 written) {
+    if (written > 0) {
+      length += (u64)written;
+      if (length >= size) {
+        length = size - 1;
+      }
+    }
+  };
+
+  const char *c = format;
+  while (*c && length < size - 1) {
+    if (*c != '%') {
+      out[length++] = *c++;
+      continue;
+    }
+    if (c[1] == '%') {
+      out[length++] = '%';
+      c += 2;
+      continue;
+    }
+
+    // Copy flags, width and precision into a spec of its own, resolving '*' from the arguments.
+    char spec[32];
+    u32  spec_length    = 0;
+    spec[spec_length++] = *c++;
+    while (*c && strchr("-+ #0123456789.*", *c)) {
+      if (spec_length < sizeof(spec) - 16) {
+        if (*c == '*') {
+          spec_length += snprintf(spec + spec_length, 12, "%d", (i32)decoder.next_int());
+        } else {
+          spec[spec_length++] = *c;
+        }
+      }
+      c++;
+    }
+    // Length modifiers are replaced by the ones matching the decoded argument.
+    while (*c && strchr("hlLqjzt", *c)) {
+      c++;
+    }
+    if (!*c) {
+      break;
+    }
+    char conversion = *c++;
+
+    ArgType     type          = ArgInt;
+    u64         bits          = 0;
+    const char *string        = "";
+    u16         string_length = 0;
+    if (!decoder.next(type, bits, string, string_length)) {
+      type = ArgInt;
+      bits = 0;
+    }
+    f64 real;
+    memcpy(&real, &bits, sizeof(real));
+    if (type != ArgFloat) {
+      real = type == ArgUnsigned ? (f64)bits : (f64)(i64)bits;
+    } else {
+      bits = (u64)(i64)real;
+    }
+
+    char *target = out + length;
+    u64   space  = size - length;
+    if (conversion == 's') {
+      char text[record_payload_size + 1];
+      u16  stored = type == ArgString ? string_length : 0;
+      if (stored > sizeof(text) - 1) {
+        stored = sizeof(text) - 1;
+      }
+      memcpy(text, string, stored);
+      text[stored]        = '\0';
+      spec[spec_length++] = 's';
+      spec[spec_length]   = '\0';
+      emit(snprintf(target, space, spec, text));
+    } else if (conversion == 'p') {
+      spec[spec_length++] = 'p';
+      spec[spec_length]   = '\0';
+      emit(snprintf(target, space, spec, (void *)bits));
+    } else if (strchr("fFeEgGaA", conversion)) {
+      spec[spec_length++] = conversion;
+      spec[spec_length]   = '\0';
+      emit(snprintf(target, space, spec, real));
+    } else if (conversion == 'c') {
+      spec[spec_length++] = 'c';
+      spec[spec_length]   = '\0';
+      emit(snprintf(target, space, spec, (i32)bits));
+    } else if (strchr("diuoxX", conversion)) {
+      spec[spec_length++] = 'l';
+      spec[spec_length++] = 'l';
+      spec[spec_length++] = conversion;
+      spec[spec_length]   = '\0';
+      emit(snprintf(target, space, spec, (long long)bits));
+    }
+    // Anything else, %n included, is skipped.
+  }
+  out[length] = '\0';
+  return length;
+}
+
+} // namespace hn::log
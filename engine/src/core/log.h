@@ -1,20 +1,191 @@
 #pragma once
 
-#include <cstdio>
+#include "defines.h"
+#include <cstring>
+#include <type_traits>
 
+// Log levels, least severe first.
+#define HN_LOG_LEVEL_DEBUG 0
+#define HN_LOG_LEVEL_INFO  1
+#define HN_LOG_LEVEL_WARN  2
+#define HN_LOG_LEVEL_ERROR 3
+#define HN_LOG_LEVEL_FATAL 4
+
+// Messages below this level are compiled out. Release builds keep info and above.
+#ifndef HN_LOG_LEVEL
+#ifdef NDEBUG
+#define HN_LOG_LEVEL HN_LOG_LEVEL_INFO
+#else
+#define HN_LOG_LEVEL HN_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// The unevaluated check_format call keeps the compiler's printf format checking.
 #define HN_log(level, message, ...)                                                                \
-  fprintf(stdout, level " \033[1;30m%s:%s:%d\033[0m " message "\n", __FILE_NAME__, __FUNCTION__,   \
-          __LINE__, ##__VA_ARGS__);
+  ((void)sizeof(::hn::log::check_format(message, ##__VA_ARGS__)),                                  \
+   ::hn::log::write(level, __FILE_NAME__, __FUNCTION__, __LINE__, message, ##__VA_ARGS__))
 
-#define HN_debug(message, ...) HN_log("[D]", message, ##__VA_ARGS__)
-#define HN_info(message, ...)  HN_log("\033[1;32m[I]\033[0m", message, ##__VA_ARGS__)
-#define HN_warn(message, ...)  HN_log("\033[1;33m[W]\033[0m", message, ##__VA_ARGS__)
-#define HN_error(message, ...) HN_log("\033[1;31m[E]\033[0m", message, ##__VA_ARGS__)
-#define HN_fatal(message, ...) HN_log("\033[1;41m[F]\033[0m", message, ##__VA_ARGS__)
+#if HN_LOG_LEVEL <= HN_LOG_LEVEL_DEBUG
+#define HN_debug(message, ...) HN_log(::hn::log::LevelDebug, message, ##__VA_ARGS__)
+#else
+#define HN_debug(message, ...) ((void)0)
+#endif
+#if HN_LOG_LEVEL <= HN_LOG_LEVEL_INFO
+#define HN_info(message, ...) HN_log(::hn::log::LevelInfo, message, ##__VA_ARGS__)
+#else
+#define HN_info(message, ...) ((void)0)
+#endif
+#if HN_LOG_LEVEL <= HN_LOG_LEVEL_WARN
+#define HN_warn(message, ...) HN_log(::hn::log::LevelWarn, message, ##__VA_ARGS__)
+#else
+#define HN_warn(message, ...) ((void)0)
+#endif
+#if HN_LOG_LEVEL <= HN_LOG_LEVEL_ERROR
+#define HN_error(message, ...) HN_log(::hn::log::LevelError, message, ##__VA_ARGS__)
+#else
+#define HN_error(message, ...) ((void)0)
+#endif
+#define HN_fatal(message, ...) HN_log(::hn::log::LevelFatal, message, ##__VA_ARGS__)
 
 namespace hn::log {
 
-void initialize();
+enum Level : u8 {
+  LevelDebug = HN_LOG_LEVEL_DEBUG,
+  LevelInfo  = HN_LOG_LEVEL_INFO,
+  LevelWarn  = HN_LOG_LEVEL_WARN,
+  LevelError = HN_LOG_LEVEL_ERROR,
+  LevelFatal = HN_LOG_LEVEL_FATAL,
+};
+
+// Records the writer thread can fall behind by; further messages are dropped and counted.
+const u32 default_queue_capacity = 1024;
+
+// Bytes of text or encoded arguments one record holds. Longer text spans several records.
+const u32 record_payload_size = 480;
+
+// Longest text message; the rest is cut off.
+const u32 max_message_length = 4096;
+
+/**
+ * Starts the writer thread. Until then, and after terminate, messages are written synchronously.
+ * @param binary_path If set, records are written to this file in binary form instead of as text
+ * on stdout: the format string pointer plus the raw arguments, formatted later by the log_decode
+ * tool.
+ * @param queue_capacity Records in flight, a power of two.
+ * @return True on success; otherwise false.
+ */
+bool initialize(const char *binary_path = nullptr, u32 queue_capacity = default_queue_capacity);
+
+// Writes out everything queued, then stops the writer thread.
 void terminate();
 
+// Blocks until every message logged so far has been written out.
+void flush();
+
+// Messages dropped because the queue was full.
+u64 get_dropped_count();
+
+// Binary log files start with the magic and version (u32 each), followed by entries. Each entry
+// starts with a BinaryEntry byte:
+//   BinaryString: u64 id, u32 length, the characters. Defines the string a record refers to by id.
+//   BinaryRecord: u64 timestamp (ns), u8 level, u32 line, u64 file, function and format string
+//                 ids, u16 argument bytes, the encoded arguments.
+// Encoded arguments are an ArgType byte each, followed by an i64, u64 or f64, a u64 pointer, or
+// for strings a u16 length and the characters.
+const u32 binary_magic   = 0x474f4c48; // "HLOG"
+const u32 binary_version = 1;
+
+enum BinaryEntry : u8 { BinaryString = 1, BinaryRecord = 2 };
+
+enum ArgType : u8 { ArgInt, ArgUnsigned, ArgFloat, ArgString, ArgPointer };
+
+/**
+ * Formats a message from its format string and encoded arguments.
+ * @param out The output buffer; always null-terminated.
+ * @param size The size of the output buffer.
+ * @param format The printf-style format string.
+ * @param args The encoded arguments.
+ * @param args_size The size of the encoded arguments in bytes.
+ * @return The length written, excluding the terminator.
+ */
+u64 format_arguments(char *out, u64 size, const char *format, const u8 *args, u32 args_size);
+
+// Only used for the format check in HN_log; never called.
+[[gnu::format(printf, 1, 2)]] int check_format(const char *format, ...);
+
+bool is_binary();
+void write_text(Level level, const char *file, const char *function, u32 line, const char *format,
+                ...);
+void write_binary(Level level, const char *file, const char *function, u32 line,
+                  const char *format, const u8 *args, u32 args_size);
+
+// Argument encoding for binary records. Once an argument does not fit, it and every later one
+// are left out.
+struct ArgEncoder {
+  u8   data[record_payload_size];
+  u32  size = 0;
+  bool full = false;
+
+  void append(ArgType type, const void *value, u32 value_size) {
+    if (full || size + 1 + value_size > record_payload_size) {
+      full = true;
+      return;
+    }
+    data[size++] = type;
+    memcpy(data + size, value, value_size);
+    size += value_size;
+  }
+
+  void append_string(const char *string) {
+    if (!string) {
+      string = "(null)";
+    }
+    if (full || size + 3 > record_payload_size) {
+      full = true;
+      return;
+    }
+    u64 length = strlen(string);
+    u64 space  = record_payload_size - size - 3;
+    u16 stored = (u16)(length < space ? length : space);
+    data[size++] = ArgString;
+    memcpy(data + size, &stored, sizeof(stored));
+    memcpy(data + size + sizeof(stored), string, stored);
+    size += sizeof(stored) + stored;
+  }
+
+  template <typename T> void encode(const T &value) {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, char *> || std::is_same_v<U, const char *>) {
+      append_string(value);
+    } else if constexpr (std::is_floating_point_v<U>) {
+      f64 v = value;
+      append(ArgFloat, &v, sizeof(v));
+    } else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>) {
+      u64 v = (u64)(const void *)value;
+      append(ArgPointer, &v, sizeof(v));
+    } else if constexpr (std::is_enum_v<U>) {
+      i64 v = (i64)value;
+      append(ArgInt, &v, sizeof(v));
+    } else if constexpr (std::is_signed_v<U>) {
+      i64 v = value;
+      append(ArgInt, &v, sizeof(v));
+    } else {
+      u64 v = value;
+      append(ArgUnsigned, &v, sizeof(v));
+    }
+  }
+};
+
+template <typename... Args>
+void write(Level level, const char *file, const char *function, u32 line, const char *format,
+           const Args &...args) {
+  if (!is_binary()) {
+    write_text(level, file, function, line, format, args...);
+    return;
+  }
+  ArgEncoder encoder;
+  (encoder.encode(args), ...);
+  write_binary(level, file, function, line, format, encoder.data, encoder.size);
+}
+
 } // namespace hn::log
@@ -1,47 +1,187 @@
 #include "memory.h"
 #include "core/log.h"
 #include "platform/platform.h"
-#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
 
 namespace hn::mem {
 
-struct Stats {
-  u64 allocated;
-  u64 tagged_allocations[TagMax];
+// Counters for one tag, updated with relaxed atomics so any thread can allocate without locking.
+// Each tag has its own cache line so threads allocating under different tags do not contend.
+struct alignas(64) TagCounters {
+  std::atomic<u64> bytes;
+  std::atomic<u64> peak_bytes;
+  std::atomic<u64> live_count;
+  std::atomic<u64> total_count;
 };
 
-static const char *tag_names[TagMax] = {"Unknown",   "Array",   "DArray",   "Map",      "BST",
-                                        "String",    "Texture", "Material", "Renderer", "Game",
-                                        "Transform", "Entity",  "Scene",    "Resource"};
+static const char *tag_names[TagMax] = {
+    "Unknown", "Array",    "DArray",   "Map",  "BST",        "String",
+    "Texture", "Material", "Renderer", "Game", "Transform",  "Entity",
+    "Scene",   "Resource", "Event",    "Job",  "FrameArena", "Profile",
+    "Log"};
 
-static Stats stats{};
+static TagCounters stats[TagMax];
 
-void initialize() { platform::memory_zero(&stats, sizeof(Stats)); }
+// Heap block handed out once the frame arena is full. The header directly precedes the user
+// memory, which is aligned within the over-sized heap allocation starting at `base`.
+struct FrameOverflowBlock {
+  FrameOverflowBlock *next;
+  void               *base;
+  u64                 size; // Total size of the heap allocation.
+};
+
+struct FrameArena {
+  u8                 *memory          = nullptr;
+  u64                 capacity        = 0;
+  u64                 offset          = 0;
+  FrameOverflow       overflow        = FrameOverflowHeap;
+  FrameOverflowBlock *overflow_blocks = nullptr;
+  u64                 overflow_used   = 0;
+  bool                warned          = false; // Overflow warning already issued this frame.
+  u64                 last_frame      = 0;
+  u64                 peak            = 0;
+  u64                 overflow_count  = 0;
+  u64                 overflow_bytes  = 0;
+  u64                 failures        = 0;
+};
+
+static FrameArena frame_arena{};
+
+// Pages are chained through this header; the blocks follow it.
+struct PoolPage {
+  PoolPage *next;
+  u64       padding; // Keeps the first block 16-byte aligned.
+};
+
+// Live pools, reported by format_memory_usage.
+static Pool *pools = nullptr;
+
+// Samples aggregated by call stack and tag.
+struct SampleSite {
+  u64   hash;
+  void *frames[max_sample_frames];
+  u32   frame_count;
+  Tag   tag;
+  u64   samples;
+  u64   count; // Estimated allocations: each sample stands for the allocations skipped before it.
+  u64   bytes; // Estimated bytes, likewise.
+};
+
+// Distinct call sites tracked; samples from further sites are only counted.
+const u32 max_sample_sites = 4096;
+
+struct AllocationSampling {
+  std::atomic<bool> enabled{false};
+  u32               rate       = 0;
+  u64               threshold  = 0;
+  f64               start_time = 0;
+  f64               duration   = 0; // Set when stopped.
+  std::mutex        lock;
+  SampleSite       *sites      = nullptr; // Open addressing by hash; unused sites have hash zero.
+  u32               site_count = 0;
+  u64               samples    = 0;
+  u64               dropped    = 0; // Samples whose site did not fit.
+};
+
+static AllocationSampling sampling{};
+
+// Allocations left until this thread samples again.
+static thread_local u32 sample_countdown = 0;
+static thread_local u32 sample_random    = 0x9e3779b9;
+
+void initialize() {
+  for (auto &counters : stats) {
+    counters.bytes.store(0, std::memory_order_relaxed);
+    counters.peak_bytes.store(0, std::memory_order_relaxed);
+    counters.live_count.store(0, std::memory_order_relaxed);
+    counters.total_count.store(0, std::memory_order_relaxed);
+  }
+}
 
 void terminate() {}
 
-void *allocate(u64 size, Tag tag) {
+void *allocate(u64 size, Tag tag, u32 flags) { return allocate_aligned(size, 0, tag, flags); }
+
+void free(void *block, u64 size, Tag tag) { free_aligned(block, size, 0, tag); }
+
+// Adds to a tag's byte count and raises its high-water mark to match.
+static void add_bytes(Tag tag, u64 size) {
+  TagCounters &counters = stats[tag];
+  u64          bytes    = counters.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  u64          peak     = counters.peak_bytes.load(std::memory_order_relaxed);
+  while (bytes > peak &&
+         !counters.peak_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+  }
+}
+
+[[gnu::noinline]] static void sample_allocation(u64 size, Tag tag);
+
+void *allocate_aligned(u64 size, u64 alignment, Tag tag, u32 flags) {
   if (tag == TagUnknown) {
-    HN_warn("allocation called using TagUnknown. Re-class this allocation.")
+    HN_warn("allocation called using TagUnknown. Re-class this allocation.");
+  }
+  if (alignment & (alignment - 1)) {
+    HN_error("Alignment %llu is not a power of two.", alignment);
+    return nullptr;
+  }
+
+  void *block = platform::allocate(size, alignment);
+  if (!block) {
+    HN_error("Failed to allocate %llu bytes aligned to %llu.", size, alignment);
+    return nullptr;
+  }
+  add_bytes(tag, size);
+  stats[tag].live_count.fetch_add(1, std::memory_order_relaxed);
+  stats[tag].total_count.fetch_add(1, std::memory_order_relaxed);
+  if (sampling.enabled.load(std::memory_order_relaxed)) {
+    sample_allocation(size, tag);
   }
-  stats.allocated += size;
-  stats.tagged_allocations[tag] += size;
 
-  // TODO memory alignment
-  void *block = platform::allocate(size);
-  platform::memory_zero(block, size);
+  if (!(flags & AllocateUninitialized)) {
+    platform::memory_zero(block, size);
+  }
   return block;
 }
 
-void free(void *block, u64 size, Tag tag) {
+void free_aligned(void *block, u64 size, u64 alignment, Tag tag) {
   if (tag == TagUnknown) {
-    HN_warn("free called using TagUnknown. Re-class this allocation.")
+    HN_warn("free called using TagUnknown. Re-class this allocation.");
+  }
+  stats[tag].bytes.fetch_sub(size, std::memory_order_relaxed);
+  stats[tag].live_count.fetch_sub(1, std::memory_order_relaxed);
+
+  platform::free(block, alignment);
+}
+
+void *reallocate(void *block, u64 old_size, u64 new_size, u64 alignment, Tag tag, u32 flags) {
+  if (!block) {
+    return allocate_aligned(new_size, alignment, tag, flags);
+  }
+  if (alignment & (alignment - 1)) {
+    HN_error("Alignment %llu is not a power of two.", alignment);
+    return nullptr;
   }
-  stats.allocated -= size;
-  stats.tagged_allocations[tag] -= size;
 
-  // TODO memory alignment
-  platform::free(block);
+  void *resized = platform::reallocate(block, old_size, new_size, alignment);
+  if (!resized) {
+    HN_error("Failed to reallocate %llu bytes to %llu.", old_size, new_size);
+    return nullptr;
+  }
+  if (new_size > old_size) {
+    add_bytes(tag, new_size - old_size);
+    if (sampling.enabled.load(std::memory_order_relaxed)) {
+      sample_allocation(new_size, tag);
+    }
+    if (!(flags & AllocateUninitialized)) {
+      platform::memory_zero((u8 *)resized + old_size, new_size - old_size);
+    }
+  } else {
+    stats[tag].bytes.fetch_sub(old_size - new_size, std::memory_order_relaxed);
+  }
+  return resized;
 }
 
 void *zero(void *block, u64 size) { return platform::memory_zero(block, size); }
@@ -50,34 +190,415 @@ void *copy(void *dst, const void *src, u64 size) { return platform::memory_copy(
 
 void *set(void *dst, i32 value, u64 size) { return platform::memory_set(dst, value, size); }
 
-const char *get_memory_usage() {
+void get_memory_usage(MemoryUsage &out_usage) {
+  out_usage = MemoryUsage{};
+  for (u16 i = 0; i < TagMax; ++i) {
+    TagUsage &tag   = out_usage.tags[i];
+    tag.bytes       = stats[i].bytes.load(std::memory_order_relaxed);
+    tag.peak_bytes  = stats[i].peak_bytes.load(std::memory_order_relaxed);
+    tag.live_count  = stats[i].live_count.load(std::memory_order_relaxed);
+    tag.total_count = stats[i].total_count.load(std::memory_order_relaxed);
+    out_usage.bytes += tag.bytes;
+    out_usage.live_count += tag.live_count;
+    out_usage.total_count += tag.total_count;
+  }
+}
+
+// Scales a byte count to the largest fitting unit.
+static f32 scale_bytes(u64 bytes, const char *&out_unit) {
   const u64 gib = 1024 * 1024 * 1024;
   const u64 mib = 1024 * 1024;
   const u64 kib = 1024;
 
-  char buffer[2048] = "System memory usage:";
-  u64  offset       = strlen(buffer);
+  if (bytes >= gib) {
+    out_unit = "GiB";
+    return bytes / (f32)gib;
+  } else if (bytes >= mib) {
+    out_unit = "MiB";
+    return bytes / (f32)mib;
+  } else if (bytes >= kib) {
+    out_unit = "KiB";
+    return bytes / (f32)kib;
+  }
+  out_unit = "B";
+  return (f32)bytes;
+}
+
+u64 format_memory_usage(const MemoryUsage &usage, char *buffer, u64 size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  u64  offset = 0;
+  auto append = [&](i32 length) {
+    if (length > 0) {
+      offset += length;
+    }
+    if (offset >= size) {
+      offset = size - 1;
+    }
+  };
+
+  append(snprintf(buffer, size, "System memory usage: %llu live allocations, %llu in total:",
+                  usage.live_count, usage.total_count));
   for (u16 i = 0; i < TagMax; ++i) {
-    char  unit[4] = "Xib";
-    float amount  = 1.0f;
-    if (stats.tagged_allocations[i] >= gib) {
-      unit[0] = 'G';
-      amount  = stats.tagged_allocations[i] / (float)gib;
-    } else if (stats.tagged_allocations[i] >= mib) {
-      unit[0] = 'M';
-      amount  = stats.tagged_allocations[i] / (float)mib;
-    } else if (stats.tagged_allocations[i] >= kib) {
-      unit[0] = 'K';
-      amount  = stats.tagged_allocations[i] / (float)kib;
-    } else {
-      unit[0] = 'B';
-      unit[1] = 0;
-      amount  = stats.tagged_allocations[i];
+    const TagUsage &tag = usage.tags[i];
+    const char     *unit;
+    const char     *peak_unit;
+    f32             amount = scale_bytes(tag.bytes, unit);
+    f32             peak   = scale_bytes(tag.peak_bytes, peak_unit);
+    append(snprintf(buffer + offset, size - offset,
+                    "\n  %-10s: %.2f %s (peak %.2f %s), %llu live, %llu total", tag_names[i],
+                    amount, unit, peak, peak_unit, tag.live_count, tag.total_count));
+  }
+  for (Pool *pool = pools; pool; pool = pool->next) {
+    u64 capacity = pool->page_count * pool->blocks_per_page;
+    append(snprintf(buffer + offset, size - offset,
+                    "\n  Pool %-10s: %llu/%llu blocks of %llu B, peak %llu, %llu pages", pool->name,
+                    pool->used, capacity, pool->block_size, pool->peak, pool->page_count));
+  }
+  return offset;
+}
+
+const char *get_tag_name(Tag tag) { return tag < TagMax ? tag_names[tag] : "Invalid"; }
+
+// Decides whether to sample this allocation and, if so, files it under its call stack.
+static void sample_allocation(u64 size, Tag tag) {
+  u64 weight = 1;
+  if (sampling.threshold == 0 || size < sampling.threshold) {
+    if (sampling.rate == 0) {
+      return;
+    }
+    if (sample_countdown > 1) {
+      sample_countdown--;
+      return;
+    }
+    // Jitter the interval around the rate so allocation patterns with the same period are not
+    // always sampled at the same point.
+    sample_random ^= sample_random << 13;
+    sample_random ^= sample_random >> 17;
+    sample_random ^= sample_random << 5;
+    sample_countdown = sampling.rate / 2 + 1 + sample_random % sampling.rate;
+    weight           = sampling.rate;
+  }
+
+  void *frames[max_sample_frames];
+  // Skip this function and the allocator entry point.
+  u32 frame_count = platform::capture_stack_trace(frames, max_sample_frames, 2);
+  u64 hash        = 0xcbf29ce484222325ull ^ tag;
+  for (u32 i = 0; i < frame_count; ++i) {
+    hash = (hash ^ (u64)frames[i]) * 0x100000001b3ull;
+  }
+  hash |= 1; // Zero marks an unused site.
+
+  std::lock_guard<std::mutex> guard(sampling.lock);
+  if (!sampling.sites) {
+    return; // Stopped and reported meanwhile.
+  }
+  sampling.samples++;
+  for (u32 probe = 0; probe < max_sample_sites; ++probe) {
+    SampleSite &site = sampling.sites[(hash + probe) & (max_sample_sites - 1)];
+    if (site.hash == 0) {
+      if (sampling.site_count * 4 >= max_sample_sites * 3) {
+        break; // Keep the table sparse enough to probe quickly.
+      }
+      site.hash        = hash;
+      site.tag         = tag;
+      site.frame_count = frame_count;
+      platform::memory_copy(site.frames, frames, frame_count * sizeof(void *));
+      sampling.site_count++;
+    }
+    if (site.hash == hash) {
+      site.samples++;
+      site.count += weight;
+      site.bytes += size * weight;
+      return;
     }
-    i32 length = snprintf(buffer + offset, 2048, "\n  %-10s: %.2f %s", tag_names[i], amount, unit);
-    offset += length;
   }
-  return strdup(buffer);
+  sampling.dropped++;
+}
+
+bool allocation_sampling_start(u32 sample_rate, u64 size_threshold) {
+  if (sampling.enabled.load(std::memory_order_relaxed)) {
+    allocation_sampling_stop();
+  }
+  std::lock_guard<std::mutex> guard(sampling.lock);
+  // The table comes from the platform directly so that sampling does not sample itself.
+  if (!sampling.sites) {
+    sampling.sites = (SampleSite *)platform::allocate(max_sample_sites * sizeof(SampleSite));
+    if (!sampling.sites) {
+      return false;
+    }
+  }
+  platform::memory_zero(sampling.sites, max_sample_sites * sizeof(SampleSite));
+  sampling.site_count = 0;
+  sampling.samples    = 0;
+  sampling.dropped    = 0;
+  sampling.rate       = sample_rate;
+  sampling.threshold  = size_threshold;
+  sampling.start_time = platform::get_system_time();
+  sampling.duration   = 0;
+  sampling.enabled.store(true, std::memory_order_release);
+  return true;
+}
+
+void allocation_sampling_stop() {
+  if (!sampling.enabled.exchange(false, std::memory_order_acq_rel)) {
+    return;
+  }
+  sampling.duration = platform::get_system_time() - sampling.start_time;
+}
+
+// Writes one line of the allocation report to the file, or to the log if there is none.
+static void report_line(FILE *file, const char *line) {
+  if (file) {
+    fprintf(file, "%s\n", line);
+  } else {
+    HN_info("%s", line);
+  }
+}
+
+bool allocation_sampling_report(const char *path) {
+  allocation_sampling_stop();
+  std::lock_guard<std::mutex> guard(sampling.lock);
+  if (!sampling.sites) {
+    HN_warn("No allocation samples to report; sampling was never started.");
+    return false;
+  }
+
+  FILE *file = nullptr;
+  if (path) {
+    file = fopen(path, "w");
+    if (!file) {
+      HN_error("Failed to open the allocation report %s.", path);
+      return false;
+    }
+  }
+
+  // Busiest sites first.
+  SampleSite *used  = sampling.sites;
+  u32         count = 0;
+  for (u32 i = 0; i < max_sample_sites; ++i) {
+    if (sampling.sites[i].hash) {
+      used[count++] = sampling.sites[i];
+    }
+  }
+  std::sort(used, used + count,
+            [](const SampleSite &a, const SampleSite &b) { return a.count > b.count; });
+
+  f64  duration = sampling.duration > 0 ? sampling.duration : 1e-9;
+  char line[512];
+  snprintf(line, sizeof(line),
+           "Allocation samples: %llu over %.2f s from %u call sites (1 in %u, all from %llu "
+           "bytes), %llu unattributed.",
+           sampling.samples, duration, count, sampling.rate, sampling.threshold, sampling.dropped);
+  report_line(file, line);
+  for (u32 i = 0; i < count; ++i) {
+    const SampleSite &site = used[i];
+    const char       *unit;
+    f32               rate = scale_bytes((u64)(site.bytes / duration), unit);
+    snprintf(line, sizeof(line),
+             "#%u %.1f allocs/s, %.2f %s/s [%s]: ~%llu allocations, ~%llu bytes, %llu samples",
+             i + 1, site.count / duration, rate, unit, tag_names[site.tag], site.count, site.bytes,
+             site.samples);
+    report_line(file, line);
+    for (u32 frame = 0; frame < site.frame_count; ++frame) {
+      char description[384];
+      if (!platform::describe_address(site.frames[frame], description, sizeof(description))) {
+        snprintf(description, sizeof(description), "%p", site.frames[frame]);
+      }
+      snprintf(line, sizeof(line), "    at %s", description);
+      report_line(file, line);
+    }
+  }
+
+  if (file) {
+    fclose(file);
+  }
+  platform::free(sampling.sites);
+  sampling.sites      = nullptr;
+  sampling.site_count = 0;
+  return true;
+}
+
+bool frame_arena_initialize(u64 capacity, FrameOverflow overflow) {
+  if (frame_arena.memory) {
+    HN_error("Frame arena is already initialized.");
+    return false;
+  }
+  frame_arena          = FrameArena{};
+  frame_arena.memory   = (u8 *)allocate(capacity, TagFrameArena);
+  frame_arena.capacity = capacity;
+  frame_arena.overflow = overflow;
+  return frame_arena.memory != nullptr;
+}
+
+void frame_arena_terminate() {
+  if (!frame_arena.memory) {
+    return;
+  }
+  frame_reset();
+  free(frame_arena.memory, frame_arena.capacity, TagFrameArena);
+  frame_arena = FrameArena{};
+}
+
+void *frame_allocate(u64 size, u64 alignment) {
+  u64 aligned = (frame_arena.offset + alignment - 1) & ~(alignment - 1);
+  if (aligned + size <= frame_arena.capacity) {
+    frame_arena.offset = aligned + size;
+    return frame_arena.memory + aligned;
+  }
+
+  if (frame_arena.overflow == FrameOverflowFail) {
+    HN_error("Frame arena exhausted: %llu of %llu bytes used, %llu requested.", frame_arena.offset,
+             frame_arena.capacity, size);
+    frame_arena.failures++;
+    return nullptr;
+  }
+  if (!frame_arena.warned) {
+    HN_warn("Frame arena exhausted (%llu bytes), falling back to the heap for this frame.",
+            frame_arena.capacity);
+    frame_arena.warned = true;
+  }
+
+  // Leave room for the header plus any padding needed to honour the alignment.
+  u64 total_size = sizeof(FrameOverflowBlock) + alignment + size;
+  u8 *base       = (u8 *)allocate(total_size, TagFrameArena);
+  if (!base) {
+    frame_arena.failures++;
+    return nullptr;
+  }
+  u64  user  = ((u64)base + sizeof(FrameOverflowBlock) + alignment - 1) & ~(alignment - 1);
+  auto block = (FrameOverflowBlock *)user - 1;
+
+  block->next                 = frame_arena.overflow_blocks;
+  block->base                 = base;
+  block->size                 = total_size;
+  frame_arena.overflow_blocks = block;
+  frame_arena.overflow_used += size;
+  frame_arena.overflow_count++;
+  frame_arena.overflow_bytes += size;
+  return (void *)user;
+}
+
+void frame_reset() {
+  u64 used               = frame_arena.offset + frame_arena.overflow_used;
+  frame_arena.last_frame = used;
+  if (used > frame_arena.peak) {
+    frame_arena.peak = used;
+  }
+
+  while (frame_arena.overflow_blocks) {
+    auto block                  = frame_arena.overflow_blocks;
+    frame_arena.overflow_blocks = block->next;
+    free(block->base, block->size, TagFrameArena);
+  }
+  frame_arena.offset        = 0;
+  frame_arena.overflow_used = 0;
+  frame_arena.warned        = false;
+}
+
+void get_frame_arena_stats(FrameArenaStats &out_stats) {
+  out_stats.capacity       = frame_arena.capacity;
+  out_stats.used           = frame_arena.offset + frame_arena.overflow_used;
+  out_stats.last_frame     = frame_arena.last_frame;
+  out_stats.peak           = frame_arena.peak;
+  out_stats.overflow_count = frame_arena.overflow_count;
+  out_stats.overflow_bytes = frame_arena.overflow_bytes;
+  out_stats.failures       = frame_arena.failures;
+}
+
+static bool pool_grow(Pool &pool) {
+  u64  page_size = sizeof(PoolPage) + pool.blocks_per_page * pool.block_size;
+  auto page      = (PoolPage *)allocate(page_size, pool.tag);
+  if (!page) {
+    return false;
+  }
+
+  // Thread the new blocks onto the free list, lowest address first.
+  u8   *blocks = (u8 *)(page + 1);
+  void *head   = pool.free_list;
+  for (u64 i = pool.blocks_per_page; i > 0; --i) {
+    void *block     = blocks + (i - 1) * pool.block_size;
+    *(void **)block = head;
+    head            = block;
+  }
+  pool.free_list = head;
+  page->next     = pool.pages;
+  pool.pages     = page;
+  pool.page_count++;
+  return true;
+}
+
+bool pool_create(Pool &out_pool, const char *name, u64 block_size, u64 blocks_per_page, Tag tag,
+                 bool growable) {
+  if (block_size == 0 || blocks_per_page == 0) {
+    HN_error("Pool '%s' needs a non-zero block size and page size.", name);
+    return false;
+  }
+
+  out_pool                 = Pool{};
+  out_pool.name            = name;
+  out_pool.tag             = tag;
+  out_pool.block_size      = (block_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  out_pool.blocks_per_page = blocks_per_page;
+  out_pool.growable        = growable;
+  if (!pool_grow(out_pool)) {
+    return false;
+  }
+
+  out_pool.next = pools;
+  pools         = &out_pool;
+  return true;
+}
+
+void pool_destroy(Pool &pool) {
+  if (pool.used > 0) {
+    HN_warn("Pool '%s' destroyed with %llu blocks still in use.", pool.name, pool.used);
+  }
+
+  u64 page_size = sizeof(PoolPage) + pool.blocks_per_page * pool.block_size;
+  while (pool.pages) {
+    PoolPage *page = pool.pages;
+    pool.pages     = page->next;
+    free(page, page_size, pool.tag);
+  }
+
+  for (Pool **link = &pools; *link; link = &(*link)->next) {
+    if (*link == &pool) {
+      *link = pool.next;
+      break;
+    }
+  }
+  pool = Pool{};
+}
+
+void *pool_allocate(Pool &pool) {
+  if (!pool.free_list) {
+    if (!pool.growable) {
+      HN_error("Pool '%s' exhausted (%llu blocks).", pool.name, pool.blocks_per_page);
+      return nullptr;
+    }
+    if (!pool_grow(pool)) {
+      return nullptr;
+    }
+  }
+
+  void *block    = pool.free_list;
+  pool.free_list = *(void **)block;
+  if (++pool.used > pool.peak) {
+    pool.peak = pool.used;
+  }
+  return block;
+}
+
+void pool_free(Pool &pool, void *block) {
+  if (!block) {
+    return;
+  }
+  *(void **)block = pool.free_list;
+  pool.free_list  = block;
+  pool.used--;
 }
 
 } // namespace hn::mem
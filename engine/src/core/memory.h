@@ -19,18 +19,180 @@ enum Tag {
   TagEntity,
   TagScene,
   TagResource,
+  TagEvent,
+  TagJob,
+  TagFrameArena,
+  TagProfile,
+  TagLog,
   TagMax,
 };
 
 void initialize();
 void terminate();
 
-void *allocate(u64 size, Tag tag);
+// Allocation flags.
+enum AllocateFlag : u32 {
+  // Skip zeroing; for callers that overwrite the memory right away.
+  AllocateUninitialized = 1 << 0,
+};
+
+void *allocate(u64 size, Tag tag, u32 flags = 0);
 void  free(void *block, u64 size, Tag tag);
+
+/**
+ * Allocates a zeroed block whose address is a multiple of the given alignment.
+ * @param size The number of bytes to allocate.
+ * @param alignment A power of two; zero means the platform's natural alignment.
+ * @param tag The tag the allocation is accounted under.
+ * @param flags AllocateFlag bits.
+ * @returns The block, or nullptr on failure.
+ */
+void *allocate_aligned(u64 size, u64 alignment, Tag tag, u32 flags = 0);
+void  free_aligned(void *block, u64 size, u64 alignment, Tag tag);
+
+/**
+ * Resizes a block, in place where the platform allows, otherwise by moving it. Contents are kept up
+ * to the smaller size; growth is zeroed unless AllocateUninitialized is passed.
+ * @param block The block to resize; nullptr allocates a new one.
+ * @param old_size The current size of the block in bytes.
+ * @param new_size The requested size in bytes.
+ * @param alignment The alignment the block was allocated with.
+ * @param tag The tag the block is accounted under.
+ * @param flags AllocateFlag bits.
+ * @returns The resized block, or nullptr on failure, in which case `block` is left untouched.
+ */
+void *reallocate(void *block, u64 old_size, u64 new_size, u64 alignment, Tag tag, u32 flags = 0);
 void *zero(void *block, u64 size);
 void *copy(void *dst, const void *src, u64 size);
 void *set(void *dst, i32 value, u64 size);
 
-const char *get_memory_usage();
+// Usage of a single tag. Sizes are in bytes.
+struct TagUsage {
+  u64 bytes;       // Currently allocated.
+  u64 peak_bytes;  // High-water mark of `bytes`.
+  u64 live_count;  // Allocations not yet freed.
+  u64 total_count; // Allocations made since initialization.
+};
+
+struct MemoryUsage {
+  u64      bytes;       // Sum over all tags.
+  u64      live_count;  // Sum over all tags.
+  u64      total_count; // Sum over all tags.
+  TagUsage tags[TagMax];
+};
+
+/**
+ * Fills a snapshot of the memory statistics. Does not allocate, so it is cheap enough to call every
+ * frame. Safe to call while other threads allocate; each counter is read atomically but the
+ * snapshot as a whole is not.
+ * @param out_usage The snapshot to fill.
+ */
+void get_memory_usage(MemoryUsage &out_usage);
+
+/**
+ * Formats a snapshot, followed by the live pools, as a human-readable report.
+ * @param usage The snapshot to format.
+ * @param buffer The buffer to write to; always null-terminated.
+ * @param size The size of the buffer in bytes.
+ * @returns The number of characters written, excluding the terminator.
+ */
+u64 format_memory_usage(const MemoryUsage &usage, char *buffer, u64 size);
+
+const char *get_tag_name(Tag tag);
+
+// Allocation sampling: an opt-in profiler that attributes allocate_aligned and growing reallocate
+// calls to their call stacks. While stopped, it costs one relaxed load per allocation.
+
+// Return addresses kept per sampled call stack.
+const u32 max_sample_frames = 8;
+
+/**
+ * Starts sampling allocations, discarding earlier samples.
+ * @param sample_rate Samples one in this many allocations below the size threshold; 0 samples
+ * none of them.
+ * @param size_threshold Allocations of at least this many bytes are always sampled; 0 disables.
+ * @returns True on success; otherwise false.
+ */
+bool allocation_sampling_start(u32 sample_rate, u64 size_threshold = 0);
+
+// Stops sampling; the samples are kept for the report.
+void allocation_sampling_stop();
+
+/**
+ * Reports the sampled call sites, busiest first, with estimated allocation and byte rates, then
+ * releases the samples.
+ * @param path The file to write the report to; nullptr logs it instead.
+ * @returns True on success; otherwise false.
+ */
+bool allocation_sampling_report(const char *path = nullptr);
+
+// Fixed-size block pool. Blocks are carved out of pages allocated with the pool's tag and kept on
+// an intrusive free list, so allocate and free are O(1) and never touch the general heap once the
+// pool is warm. Blocks are not zeroed.
+
+struct PoolPage;
+
+struct Pool {
+  const char *name            = nullptr;
+  Tag         tag             = TagUnknown;
+  u64         block_size      = 0; // Rounded up to hold a free-list link.
+  u64         blocks_per_page = 0;
+  bool        growable        = true;
+  void       *free_list       = nullptr;
+  PoolPage   *pages           = nullptr;
+  u64         page_count      = 0;
+  u64         used            = 0; // Blocks currently handed out.
+  u64         peak            = 0; // Most blocks handed out at once.
+  Pool       *next            = nullptr; // Registry of live pools, for format_memory_usage.
+};
+
+/**
+ * Creates a pool and allocates its first page.
+ * @param out_pool The pool to initialize. Must stay at the same address until destroyed.
+ * @param name A name shown in format_memory_usage. Not copied.
+ * @param block_size The size of each block in bytes.
+ * @param blocks_per_page The number of blocks allocated at once when the pool grows.
+ * @param tag The tag the pool's pages are accounted under.
+ * @param growable If false, pool_allocate returns nullptr once the first page is exhausted.
+ * @returns True on success; otherwise false.
+ */
+bool  pool_create(Pool &out_pool, const char *name, u64 block_size, u64 blocks_per_page, Tag tag,
+                  bool growable = true);
+void  pool_destroy(Pool &pool);
+void *pool_allocate(Pool &pool);
+void  pool_free(Pool &pool, void *block);
+
+// Per-frame linear arena. Allocations are bump-pointer, not zeroed, and are all released at once
+// by frame_reset(), which the application calls at the end of every frame.
+
+// What frame_allocate does once the arena's capacity is exhausted.
+enum FrameOverflow {
+  FrameOverflowHeap, // Fall back to a tagged heap allocation, released on the next reset.
+  FrameOverflowFail, // Return nullptr.
+};
+
+struct FrameArenaStats {
+  u64 capacity;       // Size of the arena in bytes.
+  u64 used;           // Bytes used so far in the current frame, including overflow.
+  u64 last_frame;     // Bytes used by the previous frame.
+  u64 peak;           // Largest per-frame usage seen since initialization.
+  u64 overflow_count; // Number of allocations that did not fit in the arena, in total.
+  u64 overflow_bytes; // Bytes of those allocations, in total.
+  u64 failures;       // Number of allocations that returned nullptr, in total.
+};
+
+bool frame_arena_initialize(u64 capacity, FrameOverflow overflow = FrameOverflowHeap);
+void frame_arena_terminate();
+
+/**
+ * Allocates scratch memory that lives until the end of the current frame.
+ * @param size The number of bytes to allocate.
+ * @param alignment The alignment of the returned block; must be a power of two.
+ * @returns The block, or nullptr if the arena is full and the overflow policy is FrameOverflowFail,
+ * or the heap fallback fails.
+ */
+void *frame_allocate(u64 size, u64 alignment = 16);
+void  frame_reset();
+void  get_frame_arena_stats(FrameArenaStats &out_stats);
 
 } // namespace hn::mem
@@ -0,0 +1,260 @@
+#include "metrics.h"
+#include "log.h"
+#include "platform/platform.h"
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+namespace hn::metrics {
+
+enum MetricKind : u8 { KindCounter, KindGauge, KindHistogram };
+
+struct Histogram {
+  std::atomic<u64> buckets[histogram_bucket_count];
+  std::atomic<u64> count;
+  std::atomic<u64> sum; // Nanoseconds.
+  std::atomic<u64> max;
+};
+
+// One registered metric. Slots are claimed by bumping the registry's count, filled in, then
+// published through `ready`; readers skip slots that are not ready yet.
+struct alignas(64) Metric {
+  std::atomic<bool> ready;
+  MetricKind        kind;
+  char              name[max_name_length];
+  std::atomic<u64>  value; // Counter total, or the gauge's f64 bits.
+  Histogram        *histogram;
+};
+
+// Collectors run before a snapshot.
+const u32 max_collectors = 16;
+
+struct MetricsState {
+  std::atomic<bool> running{false};
+  Metric            metrics[max_metrics];
+  std::atomic<u32>  metric_count{0};
+  Histogram         histograms[max_histograms];
+  std::atomic<u32>  histogram_count{0};
+  PFN_collect       collectors[max_collectors];
+  void             *collector_data[max_collectors];
+  u32               collector_count = 0;
+  FILE             *file            = nullptr;
+  u32               interval        = default_snapshot_interval;
+  u64               frame           = 0;
+  f64               start_time      = 0;
+};
+
+static MetricsState state{};
+
+bool initialize(const char *snapshot_path, u32 snapshot_interval) {
+  if (state.running.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  if (snapshot_path) {
+    state.file = fopen(snapshot_path, "a");
+    if (!state.file) {
+      HN_error("Failed to open the metrics file %s.", snapshot_path);
+      return false;
+    }
+  }
+  state.interval        = snapshot_interval ? snapshot_interval : default_snapshot_interval;
+  state.frame           = 0;
+  state.collector_count = 0;
+  state.start_time      = platform::get_system_time();
+  state.running.store(true, std::memory_order_release);
+  HN_debug("Metrics registry initialized.");
+  return true;
+}
+
+void terminate() {
+  if (!state.running.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if (state.file) {
+    write_snapshot();
+    fclose(state.file);
+    state.file = nullptr;
+  }
+  state.running.store(false, std::memory_order_relaxed);
+
+  u32 count = state.metric_count.load(std::memory_order_relaxed);
+  for (u32 i = 0; i < count && i < max_metrics; ++i) {
+    state.metrics[i].ready.store(false, std::memory_order_relaxed);
+  }
+  for (auto &histogram : state.histograms) {
+    for (auto &bucket : histogram.buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    histogram.count.store(0, std::memory_order_relaxed);
+    histogram.sum.store(0, std::memory_order_relaxed);
+    histogram.max.store(0, std::memory_order_relaxed);
+  }
+  state.metric_count.store(0, std::memory_order_relaxed);
+  state.histogram_count.store(0, std::memory_order_relaxed);
+}
+
+static MetricHandle register_metric(const char *name, MetricKind kind) {
+  if (!state.running.load(std::memory_order_acquire)) {
+    return invalid_metric;
+  }
+
+  u32 count = state.metric_count.load(std::memory_order_acquire);
+  for (u32 i = 0; i < count && i < max_metrics; ++i) {
+    Metric &metric = state.metrics[i];
+    if (metric.ready.load(std::memory_order_acquire) && metric.kind == kind &&
+        strncmp(metric.name, name, max_name_length - 1) == 0) {
+      return i + 1;
+    }
+  }
+
+  u32 index = state.metric_count.fetch_add(1, std::memory_order_acq_rel);
+  if (index >= max_metrics) {
+    HN_warn("Metrics registry is full; not registering %s.", name);
+    return invalid_metric;
+  }
+  Metric &metric = state.metrics[index];
+  metric.kind    = kind;
+  snprintf(metric.name, sizeof(metric.name), "%s", name);
+  metric.value.store(0, std::memory_order_relaxed);
+  metric.histogram = nullptr;
+  if (kind == KindHistogram) {
+    u32 histogram = state.histogram_count.fetch_add(1, std::memory_order_relaxed);
+    if (histogram >= max_histograms) {
+      HN_warn("No histograms left; %s will record nothing.", name);
+    } else {
+      metric.histogram = &state.histograms[histogram];
+    }
+  }
+  metric.ready.store(true, std::memory_order_release);
+  return index + 1;
+}
+
+MetricHandle register_counter(const char *name) { return register_metric(name, KindCounter); }
+
+MetricHandle register_gauge(const char *name) { return register_metric(name, KindGauge); }
+
+MetricHandle register_histogram(const char *name) { return register_metric(name, KindHistogram); }
+
+void counter_add(MetricHandle counter, u64 value) {
+  if (counter == invalid_metric) {
+    return;
+  }
+  state.metrics[counter - 1].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+void gauge_set(MetricHandle gauge, f64 value) {
+  if (gauge == invalid_metric) {
+    return;
+  }
+  state.metrics[gauge - 1].value.store(std::bit_cast<u64>(value), std::memory_order_relaxed);
+}
+
+void histogram_record(MetricHandle histogram, u64 nanoseconds) {
+  if (histogram == invalid_metric) {
+    return;
+  }
+  Histogram *data = state.metrics[histogram - 1].histogram;
+  if (!data) {
+    return;
+  }
+  u64 microseconds = nanoseconds / 1000;
+  u32 bucket       = microseconds ? (u32)std::bit_width(microseconds) : 0;
+  if (bucket >= histogram_bucket_count) {
+    bucket = histogram_bucket_count - 1;
+  }
+  data->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  data->count.fetch_add(1, std::memory_order_relaxed);
+  data->sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+  u64 max = data->max.load(std::memory_order_relaxed);
+  while (nanoseconds > max &&
+         !data->max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+  }
+}
+
+bool add_collector(PFN_collect collect, void *data) {
+  if (state.collector_count == max_collectors) {
+    return false;
+  }
+  state.collectors[state.collector_count]     = collect;
+  state.collector_data[state.collector_count] = data;
+  state.collector_count++;
+  return true;
+}
+
+void frame_end() {
+  state.frame++;
+  if (state.file && state.frame % state.interval == 0) {
+    write_snapshot();
+  }
+}
+
+// The upper bound in microseconds of the bucket holding the given fraction of the samples.
+static f64 histogram_percentile(const u64 *buckets, u64 count, f64 fraction) {
+  u64 target = (u64)(count * fraction);
+  u64 seen   = 0;
+  for (u32 i = 0; i < histogram_bucket_count; ++i) {
+    seen += buckets[i];
+    if (seen > target) {
+      return (f64)(1ull << i);
+    }
+  }
+  return (f64)(1ull << (histogram_bucket_count - 1));
+}
+
+bool write_snapshot() {
+  if (!state.file) {
+    return false;
+  }
+  for (u32 i = 0; i < state.collector_count; ++i) {
+    state.collectors[i](state.collector_data[i]);
+  }
+
+  FILE *file = state.file;
+  fprintf(file, "%.3f %llu", platform::get_system_time() - state.start_time, state.frame);
+  u32 count = state.metric_count.load(std::memory_order_acquire);
+  for (u32 i = 0; i < count && i < max_metrics; ++i) {
+    Metric &metric = state.metrics[i];
+    if (!metric.ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    u64 value = metric.value.load(std::memory_order_relaxed);
+    switch (metric.kind) {
+    case KindCounter: fprintf(file, " %s=%llu", metric.name, value); break;
+    case KindGauge: {
+      // Whole numbers, e.g. byte counts, print exactly.
+      f64 gauge = std::bit_cast<f64>(value);
+      if (gauge == (f64)(i64)gauge) {
+        fprintf(file, " %s=%lld", metric.name, (i64)gauge);
+      } else {
+        fprintf(file, " %s=%g", metric.name, gauge);
+      }
+      break;
+    }
+    case KindHistogram: {
+      Histogram *data = metric.histogram;
+      if (!data) {
+        break;
+      }
+      // Percentiles come from the bucket counts alone, which may run ahead of `count`.
+      u64 buckets[histogram_bucket_count];
+      u64 bucketed = 0;
+      for (u32 b = 0; b < histogram_bucket_count; ++b) {
+        buckets[b] = data->buckets[b].load(std::memory_order_relaxed);
+        bucketed += buckets[b];
+      }
+      u64 samples = data->count.load(std::memory_order_relaxed);
+      f64 mean    = samples ? data->sum.load(std::memory_order_relaxed) / 1000.0 / samples : 0;
+      fprintf(file, " %s=%llu/%.1f/%g/%g/%.1f", metric.name, samples, mean,
+              histogram_percentile(buckets, bucketed, 0.5),
+              histogram_percentile(buckets, bucketed, 0.99),
+              data->max.load(std::memory_order_relaxed) / 1000.0);
+      break;
+    }
+    }
+  }
+  fputc('\n', file);
+  return fflush(file) == 0;
+}
+
+} // namespace hn::metrics
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "defines.h"
+
+namespace hn::metrics {
+
+// Identifies a registered metric. Zero is never a valid handle; updating it does nothing, so
+// subsystems can feed metrics whether or not the registry is running.
+typedef u32 MetricHandle;
+
+const MetricHandle invalid_metric = 0;
+
+// Metrics the registry can hold.
+const u32 max_metrics = 512;
+
+// Of which histograms.
+const u32 max_histograms = 32;
+
+// Longest metric name, including the terminator.
+const u32 max_name_length = 48;
+
+// Histogram buckets: bucket 0 holds values under 1 us, bucket k values in [2^(k-1), 2^k) us, and
+// the last one everything from 2^(histogram_bucket_count - 2) us up.
+const u32 histogram_bucket_count = 24;
+
+// Frames between snapshots unless configured otherwise.
+const u32 default_snapshot_interval = 600;
+
+// Called before each snapshot so subsystems can refresh gauges they only sample.
+typedef void (*PFN_collect)(void *data);
+
+/**
+ * Starts the registry. Metrics can be registered and updated without a snapshot file.
+ * @param snapshot_path If set, a snapshot line is appended here every `snapshot_interval` frames
+ * and on terminate.
+ * @param snapshot_interval Frames between snapshots; 0 uses the default.
+ * @return True on success; otherwise false.
+ */
+bool initialize(const char *snapshot_path = nullptr, u32 snapshot_interval = 0);
+
+// Writes a final snapshot, then clears the registry.
+void terminate();
+
+/**
+ * Registers a metric, or returns the existing one of the same name and kind. Registration is
+ * lock-free but meant for setup; updates are the cheap part.
+ * @param name The metric name, e.g. "frame.time"; copied and cut to max_name_length.
+ * @returns The handle, or invalid_metric if the registry is not running or full.
+ */
+MetricHandle register_counter(const char *name);
+MetricHandle register_gauge(const char *name);
+MetricHandle register_histogram(const char *name);
+
+// Adds to a monotonic counter. Lock-free; safe from any thread.
+void counter_add(MetricHandle counter, u64 value = 1);
+
+// Sets a gauge to its latest value. Lock-free; safe from any thread.
+void gauge_set(MetricHandle gauge, f64 value);
+
+// Records a latency in nanoseconds. Lock-free; safe from any thread.
+void histogram_record(MetricHandle histogram, u64 nanoseconds);
+
+/**
+ * Adds a callback run before every snapshot.
+ * @return True on success; false if there is no room for more.
+ */
+bool add_collector(PFN_collect collect, void *data);
+
+// Counts a frame and writes a snapshot when one is due. Call once per frame from the main thread.
+void frame_end();
+
+/**
+ * Appends a snapshot of every metric as one line:
+ *   <seconds> <frame> name=value ... name=count/mean/p50/p99/max ...
+ * Counters are cumulative, gauges their last value, histograms in microseconds.
+ * @return True on success; false if there is no snapshot file or writing fails.
+ */
+bool write_snapshot();
+
+} // namespace hn::metrics
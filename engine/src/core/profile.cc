@@ -0,0 +1,274 @@
+#include "profile.h"
+#include "log.h"
+#include "memory.h"
+#include <atomic>
+#include <cstdio>
+#include <new>
+
+namespace hn::profile {
+
+#if HN_PROFILING
+
+// A finished zone. The fields are atomics because the exporter may read a slot while its thread
+// reuses it; such reads are detected and dropped.
+struct Zone {
+  std::atomic<const char *> name;
+  std::atomic<u64>          start;
+  std::atomic<u64>          end;
+};
+
+// Per-thread ring of zones. Only the owning thread writes it. `writing` is bumped before a slot is
+// overwritten and `written` after, so the exporter can tell which slots it read intact.
+struct ThreadBuffer {
+  alignas(64) std::atomic<u64> writing{0};
+  std::atomic<u64>             written{0};
+  Zone                        *zones = nullptr;
+  u32                          mask  = 0;
+  u32                          tid   = 0;
+  ThreadBuffer                *next  = nullptr;
+  char                         name[32]{};
+  std::atomic<bool>            named{false};
+};
+
+struct ProfileState {
+  std::atomic<bool>           initialized{false};
+  u32                         generation    = 0;
+  u32                         zone_capacity = 0;
+  std::atomic<ThreadBuffer *> buffers{nullptr}; // Lock-free list of every thread's buffer.
+  std::atomic<u32>            next_tid{0};
+  // Frame starts, written and read by the main thread only.
+  u64           frames[max_frames]{};
+  u64           frame_count  = 0;
+  ThreadBuffer *frame_thread = nullptr;
+};
+
+static ProfileState state{};
+
+// The calling thread's buffer, valid while its generation matches the profiler's.
+static thread_local ThreadBuffer *local            = nullptr;
+static thread_local u32           local_generation = 0;
+
+static ThreadBuffer *get_local_buffer() {
+  if (local && local_generation == state.generation) {
+    return local;
+  }
+
+  auto *buffer = (ThreadBuffer *)mem::allocate_aligned(sizeof(ThreadBuffer), alignof(ThreadBuffer),
+                                                       mem::TagProfile);
+  new (buffer) ThreadBuffer();
+  buffer->zones = (Zone *)mem::allocate(state.zone_capacity * sizeof(Zone), mem::TagProfile);
+  buffer->mask  = state.zone_capacity - 1;
+  buffer->tid   = state.next_tid.fetch_add(1, std::memory_order_relaxed);
+
+  ThreadBuffer *head = state.buffers.load(std::memory_order_relaxed);
+  do {
+    buffer->next = head;
+  } while (!state.buffers.compare_exchange_weak(head, buffer, std::memory_order_release,
+                                                std::memory_order_relaxed));
+
+  local            = buffer;
+  local_generation = state.generation;
+  return buffer;
+}
+
+bool initialize(u32 zone_capacity) {
+  if (state.initialized.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  u32 capacity = 1;
+  while (capacity < zone_capacity) {
+    capacity <<= 1;
+  }
+  state.zone_capacity = capacity;
+  state.frame_count   = 0;
+  state.frame_thread  = nullptr;
+  state.generation++;
+  state.initialized.store(true, std::memory_order_release);
+  HN_debug("Profiler initialized with %u zones per thread.", capacity);
+  return true;
+}
+
+// Other threads must have stopped recording.
+void terminate() {
+  if (!state.initialized.load(std::memory_order_relaxed)) {
+    return;
+  }
+  state.initialized.store(false, std::memory_order_relaxed);
+
+  ThreadBuffer *buffer = state.buffers.exchange(nullptr, std::memory_order_acquire);
+  while (buffer) {
+    ThreadBuffer *next = buffer->next;
+    mem::free(buffer->zones, state.zone_capacity * sizeof(Zone), mem::TagProfile);
+    buffer->~ThreadBuffer();
+    mem::free_aligned(buffer, sizeof(ThreadBuffer), alignof(ThreadBuffer), mem::TagProfile);
+    buffer = next;
+  }
+  state.next_tid.store(0, std::memory_order_relaxed);
+  local = nullptr;
+}
+
+void set_thread_name(const char *name) {
+  if (!state.initialized.load(std::memory_order_acquire)) {
+    return;
+  }
+  ThreadBuffer *buffer = get_local_buffer();
+  snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+  buffer->named.store(true, std::memory_order_release);
+}
+
+void record(const char *name, u64 start, u64 end) {
+  if (!state.initialized.load(std::memory_order_acquire)) {
+    return;
+  }
+  ThreadBuffer *buffer = get_local_buffer();
+  u64           index  = buffer->written.load(std::memory_order_relaxed);
+  Zone         &zone   = buffer->zones[index & buffer->mask];
+  buffer->writing.store(index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  zone.name.store(name, std::memory_order_relaxed);
+  zone.start.store(start, std::memory_order_relaxed);
+  zone.end.store(end, std::memory_order_relaxed);
+  buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void frame_mark() {
+  if (!state.initialized.load(std::memory_order_acquire)) {
+    return;
+  }
+  state.frame_thread = get_local_buffer();
+  state.frames[state.frame_count % max_frames] = platform::get_timestamp_ns();
+  state.frame_count++;
+}
+
+static void write_string(FILE *file, const char *string) {
+  fputc('"', file);
+  for (const char *c = string; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', file);
+      fputc(*c, file);
+    } else if ((u8)*c < 0x20) {
+      fprintf(file, "\\u%04x", *c);
+    } else {
+      fputc(*c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+// Writes a complete ("X") event; times are in microseconds relative to the window start.
+static void write_zone(FILE *file, bool &first, const char *name, const char *category, u32 tid,
+                       u64 start, u64 end, u64 base) {
+  fputs(first ? "\n" : ",\n", file);
+  first = false;
+  fputs("{\"name\":", file);
+  write_string(file, name);
+  fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+          category, (f64)(start - base) / 1000.0, (f64)(end - start) / 1000.0, tid);
+}
+
+bool write_chrome_trace(const char *path, u32 frame_count) {
+  if (!state.initialized.load(std::memory_order_acquire)) {
+    return false;
+  }
+  // A frame is complete once the next one has started, so k frames take k + 1 marks.
+  u64 available = state.frame_count > 0 ? state.frame_count - 1 : 0;
+  if (available > max_frames - 1) {
+    available = max_frames - 1;
+  }
+  if (frame_count > available) {
+    frame_count = (u32)available;
+  }
+  if (frame_count == 0) {
+    HN_warn("No complete frames to write to the trace %s.", path);
+    return false;
+  }
+
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    HN_error("Failed to open the trace file %s.", path);
+    return false;
+  }
+
+  u64 last         = state.frame_count - 1;
+  u64 first_frame  = last - frame_count;
+  u64 window_start = state.frames[first_frame % max_frames];
+  u64 window_end   = state.frames[last % max_frames];
+
+  bool first = true;
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+
+  // Frames go on the thread that marked them.
+  char frame_name[32];
+  u32  frame_tid = state.frame_thread->tid;
+  for (u64 frame = first_frame; frame < last; ++frame) {
+    snprintf(frame_name, sizeof(frame_name), "Frame %llu", frame);
+    write_zone(file, first, frame_name, "frame", frame_tid, state.frames[frame % max_frames],
+               state.frames[(frame + 1) % max_frames], window_start);
+  }
+
+  u64           zone_count = 0;
+  u64           torn_count = 0;
+  ThreadBuffer *buffer     = state.buffers.load(std::memory_order_acquire);
+  for (; buffer; buffer = buffer->next) {
+    // Thread names are metadata ("M") events.
+    if (buffer->named.load(std::memory_order_acquire)) {
+      fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,",
+              buffer->tid);
+      fputs("\"args\":{\"name\":", file);
+      write_string(file, buffer->name);
+      fputs("}}", file);
+    }
+
+    u64 capacity = (u64)buffer->mask + 1;
+    u64 written  = buffer->written.load(std::memory_order_acquire);
+    u64 begin    = written > capacity ? written - capacity : 0;
+    for (u64 index = begin; index < written; ++index) {
+      Zone       &zone  = buffer->zones[index & buffer->mask];
+      const char *name  = zone.name.load(std::memory_order_relaxed);
+      u64         start = zone.start.load(std::memory_order_relaxed);
+      u64         end   = zone.end.load(std::memory_order_relaxed);
+      // The slot is intact unless its owner has since started on the zone that reuses it.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (buffer->writing.load(std::memory_order_relaxed) > index + capacity) {
+        torn_count++;
+        continue;
+      }
+      if (end <= window_start || start >= window_end) {
+        continue;
+      }
+      write_zone(file, first, name, "zone", buffer->tid, start < window_start ? window_start : start,
+                 end, window_start);
+      zone_count++;
+    }
+  }
+
+  fputs("\n]}\n", file);
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  if (!ok) {
+    HN_error("Failed to write the trace file %s.", path);
+    return false;
+  }
+  HN_debug("Wrote %llu zones over %u frames to %s (%llu overwritten during export).", zone_count,
+           frame_count, path, torn_count);
+  return true;
+}
+
+#else
+
+// Profiling is compiled out; keep the API so callers need no guards.
+
+bool initialize(u32 zone_capacity) { return true; }
+void terminate() {}
+void set_thread_name(const char *name) {}
+void record(const char *name, u64 start, u64 end) {}
+void frame_mark() {}
+
+bool write_chrome_trace(const char *path, u32 frame_count) {
+  HN_warn("Profiling is compiled out; not writing the trace %s.", path);
+  return false;
+}
+
+#endif
+
+} // namespace hn::profile
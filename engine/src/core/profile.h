@@ -0,0 +1,85 @@
+#pragma once
+
+#include "defines.h"
+#include "platform/platform.h"
+
+// Profiling is on unless building for release; define HN_PROFILING to 0 or 1 to override.
+#ifndef HN_PROFILING
+#ifdef NDEBUG
+#define HN_PROFILING 0
+#else
+#define HN_PROFILING 1
+#endif
+#endif
+
+#if HN_PROFILING
+#define HN_PROFILE_CONCAT_INNER(a, b) a##b
+#define HN_PROFILE_CONCAT(a, b)       HN_PROFILE_CONCAT_INNER(a, b)
+// Times the enclosing scope. The name must outlive the profiler, e.g. a string literal.
+#define HN_PROFILE_SCOPE(name) ::hn::profile::Scope HN_PROFILE_CONCAT(hn_profile_, __LINE__)(name)
+#define HN_PROFILE_FUNCTION()  HN_PROFILE_SCOPE(__FUNCTION__)
+// Marks the start of a frame on the calling (main) thread.
+#define HN_PROFILE_FRAME() ::hn::profile::frame_mark()
+#else
+#define HN_PROFILE_SCOPE(name)
+#define HN_PROFILE_FUNCTION()
+#define HN_PROFILE_FRAME()
+#endif
+
+namespace hn::profile {
+
+// Zones each thread keeps; older ones are overwritten.
+const u32 default_zone_capacity = 64 * 1024;
+
+// Frame starts kept for choosing the window to export.
+const u32 max_frames = 1024;
+
+/**
+ * Sets up the profiler. Threads get their zone buffer on their first zone.
+ * @param zone_capacity Zones kept per thread, rounded up to a power of two.
+ * @return True on success; otherwise false.
+ */
+bool initialize(u32 zone_capacity = default_zone_capacity);
+void terminate();
+
+/**
+ * Names the calling thread in exported traces. The name is copied.
+ * @param name The thread name.
+ */
+void set_thread_name(const char *name);
+
+/**
+ * Records a finished zone for the calling thread. Lock-free; only the calling thread writes its
+ * buffer.
+ * @param name The zone name; must outlive the profiler.
+ * @param start Start time, from platform::get_timestamp_ns.
+ * @param end End time, from platform::get_timestamp_ns.
+ */
+void record(const char *name, u64 start, u64 end);
+
+// Marks the start of a frame. Call once per frame from the main thread.
+void frame_mark();
+
+/**
+ * Writes the zones of the most recent complete frames as Chrome trace event JSON, viewable in
+ * chrome://tracing or Perfetto. Other threads may keep recording meanwhile; zones they overwrite
+ * during the export are left out.
+ * @param path The output file.
+ * @param frame_count The number of frames to export, counting back from the last complete one.
+ * @return True on success; otherwise false.
+ */
+bool write_chrome_trace(const char *path, u32 frame_count);
+
+// Times its own lifetime.
+struct Scope {
+  const char *name;
+  u64         start;
+
+  explicit Scope(const char *name) : name(name), start(platform::get_timestamp_ns()) {}
+  ~Scope() { record(name, start, platform::get_timestamp_ns()); }
+
+  Scope(const Scope &)            = delete;
+  Scope &operator=(const Scope &) = delete;
+};
+
+} // namespace hn::profile
@@ -0,0 +1,685 @@
+#include "resource.h"
+#include "container/darray_t.h"
+#include "container/hash_map.h"
+#include "container/mpsc_queue.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include "core/profile.h"
+#include "core/strings.h"
+#include "platform/platform.h"
+#include <atomic>
+#include <thread>
+
+namespace hn::resource {
+
+// Ends the slot free list, the cache list and waiter lists.
+const u32 invalid_index = 0xffffffff;
+
+// Read results the I/O thread collects per wait.
+const u32 max_results = 16;
+
+enum SlotState : u8 {
+  SlotFree,
+  SlotReading,  // Queued for, or with, the I/O thread.
+  SlotDecoding, // With a job worker.
+  SlotReady,
+  SlotFailed,
+};
+
+struct Slot {
+  strings::StringId path;
+  Loader            loader;
+  Data              data;
+  // The file's contents between the read and the decode: a buffer or a mapping.
+  u8       *bytes;
+  u64       size;
+  bool      mapped;
+  bool      success; // Set by the I/O thread, then by the decoder.
+  SlotState state;
+  u32       generation;
+  u32       references;
+  u32       next;     // The free list; while cached, the next more recently released resource.
+  u32       previous; // While cached, the next less recently released resource.
+  u32       first_waiter;
+  u32       last_waiter;
+};
+
+// A completion callback waiting for its resource.
+struct Waiter {
+  PFN_on_loaded on_loaded;
+  void         *user_data;
+  u32           next;
+};
+
+// Main thread to I/O thread.
+struct ReadRequest {
+  u32         slot;
+  const char *path; // Owned by the string table.
+  bool        map;
+};
+
+// I/O thread to main thread.
+struct ReadDone {
+  u32  slot;
+  u8  *bytes;
+  u64  size;
+  bool mapped;
+  bool success;
+};
+
+// A file being read by the I/O thread.
+struct PendingRead {
+  u32            slot;
+  platform::File file;
+  u8            *buffer;
+  u64            done;
+};
+
+struct ResourceState {
+  Config config{};
+  Slot  *slots     = nullptr;
+  u32    free_list = invalid_index;
+  // Unreferenced, loaded resources in the order they were released, oldest first.
+  u32                             oldest_cached = invalid_index;
+  u32                             newest_cached = invalid_index;
+  HashMap<strings::StringId, u32> paths{mem::TagResource};
+  DArray<Waiter>                  waiters{mem::TagResource};
+  u32                             free_waiters = invalid_index;
+  DArray<u32>                     notify{mem::TagResource}; // Slots whose waiters are due.
+  u32                             pending = 0;              // Loads reading or decoding.
+  Stats                           stats{};
+
+  // Hand-offs between the main thread, the I/O thread and the decoders. Each slot is in at most
+  // one queue at a time, so none can fill up.
+  MpscQueue<ReadRequest> requests;
+  MpscQueue<ReadDone>    reads_done;
+  MpscQueue<u32>         decoded;
+  job::Counter           decoding;
+
+  // The I/O thread's.
+  platform::AsyncReader reader{};
+  PendingRead          *reads       = nullptr;
+  u32                  *free_reads  = nullptr;
+  u32                   free_count  = 0;
+  u32                   unsignalled = 0; // Reads handed back since the last signal_done.
+  std::thread           io_thread;
+  std::atomic<bool>     running{false};
+  // Bumped whenever a request is queued; the idle I/O thread waits for it to change.
+  std::atomic<u32> io_epoch{0};
+  std::atomic<u64> bytes_read{0};
+  // Bumped whenever a read or a decode finishes; flush waits for it to change.
+  std::atomic<u32> done_epoch{0};
+};
+
+static ResourceState state;
+
+static Handle make_handle(u32 index) {
+  return (Handle)state.slots[index].generation << 32 | index;
+}
+
+// The slot of a live handle; invalid_index otherwise.
+static u32 resolve(Handle handle) {
+  u32 index = (u32)handle;
+  if (!state.slots || index >= state.config.max_resources ||
+      state.slots[index].generation != (u32)(handle >> 32) ||
+      state.slots[index].state == SlotFree) {
+    return invalid_index;
+  }
+  return index;
+}
+
+// I/O thread.
+
+static void signal_done() {
+  state.done_epoch.fetch_add(1);
+  state.done_epoch.notify_one();
+}
+
+static void send(const ReadDone &done) {
+  while (!state.reads_done.push(done)) {
+    std::this_thread::yield();
+  }
+  state.unsignalled++;
+}
+
+static void start_read(const ReadRequest &request) {
+  if (request.map) {
+    platform::MappedFile file;
+    bool                 success = platform::map_file(request.path, file);
+    if (success) {
+      state.bytes_read.fetch_add(file.size, std::memory_order_relaxed);
+    }
+    send({request.slot, (u8 *)file.data, file.size, true, success});
+    return;
+  }
+
+  platform::File file;
+  if (!platform::open_file(request.path, file)) {
+    send({request.slot, nullptr, 0, false, false});
+    return;
+  }
+  if (file.size == 0) {
+    platform::close_file(file);
+    send({request.slot, nullptr, 0, false, true});
+    return;
+  }
+  u8 *buffer = (u8 *)mem::allocate(file.size, mem::TagResource, mem::AllocateUninitialized);
+  if (!buffer) {
+    platform::close_file(file);
+    send({request.slot, nullptr, 0, false, false});
+    return;
+  }
+  u32 read = state.free_reads[--state.free_count];
+  platform::async_read(state.reader, {file, 0, buffer, file.size, read});
+  state.reads[read] = {request.slot, file, buffer, 0};
+}
+
+static void finish_read(u32 read, bool success) {
+  PendingRead &pending = state.reads[read];
+  if (success) {
+    state.bytes_read.fetch_add(pending.done, std::memory_order_relaxed);
+  } else {
+    mem::free(pending.buffer, pending.file.size, mem::TagResource);
+  }
+  platform::close_file(pending.file);
+  send({pending.slot, success ? pending.buffer : nullptr, success ? pending.done : 0, false,
+        success});
+  state.free_reads[state.free_count++] = read;
+}
+
+// Keeps up to queue_depth reads in flight. While any is, the thread blocks on their completion
+// and picks up new requests between completions; otherwise it sleeps until one is queued.
+static void io_loop() {
+  profile::set_thread_name("Resource I/O");
+  platform::AsyncReadResult results[max_results];
+  while (true) {
+    u32 epoch = state.io_epoch.load();
+
+    ReadRequest request;
+    while (state.free_count > 0 && state.running.load(std::memory_order_relaxed) &&
+           state.requests.pop(request)) {
+      start_read(request);
+    }
+    platform::async_reader_submit(state.reader);
+    // One wake-up per batch rather than per file.
+    if (state.unsignalled > 0) {
+      signal_done();
+      state.unsignalled = 0;
+    }
+
+    if (state.free_count == state.reader.depth) {
+      if (!state.running.load()) {
+        break;
+      }
+      state.io_epoch.wait(epoch);
+      continue;
+    }
+
+    u32 count = platform::async_reader_complete(state.reader, results, max_results, true);
+    for (u32 i = 0; i < count; ++i) {
+      u32          read    = (u32)results[i].user_data;
+      PendingRead &pending = state.reads[read];
+      if (results[i].result <= 0) {
+        // An error, or the file shrank since it was opened.
+        finish_read(read, false);
+        continue;
+      }
+      pending.done += (u64)results[i].result;
+      if (pending.done == pending.file.size) {
+        finish_read(read, true);
+        continue;
+      }
+      // Short read: queue the rest, in the room this one left.
+      platform::async_read(state.reader, {pending.file, pending.done, pending.buffer + pending.done,
+                                          pending.file.size - pending.done, read});
+    }
+  }
+}
+
+// Decoders.
+
+// Frees the file's contents once they are decoded, or if the load failed.
+static void free_contents(Slot &slot) {
+  if (slot.mapped) {
+    platform::MappedFile file{slot.bytes, slot.size};
+    platform::unmap_file(file);
+  } else if (slot.bytes) {
+    mem::free(slot.bytes, slot.size, mem::TagResource);
+  }
+  slot.bytes  = nullptr;
+  slot.size   = 0;
+  slot.mapped = false;
+}
+
+static void decode(void *data) {
+  auto slot     = (Slot *)data;
+  slot->success = slot->loader.decode(slot->bytes, slot->size, slot->data);
+  free_contents(*slot);
+  while (!state.decoded.push((u32)(slot - state.slots))) {
+    std::this_thread::yield();
+  }
+  signal_done();
+}
+
+// Main thread.
+
+static void free_slot(u32 index) {
+  Slot &slot = state.slots[index];
+  state.paths.erase(slot.path);
+  slot.state = SlotFree;
+  // Outstanding handles to the slot stop resolving.
+  if (++slot.generation == 0) {
+    slot.generation = 1;
+  }
+  slot.next       = state.free_list;
+  state.free_list = index;
+}
+
+static void cache_insert(u32 index) {
+  Slot &slot    = state.slots[index];
+  slot.previous = state.newest_cached;
+  slot.next     = invalid_index;
+  if (state.newest_cached != invalid_index) {
+    state.slots[state.newest_cached].next = index;
+  } else {
+    state.oldest_cached = index;
+  }
+  state.newest_cached = index;
+  state.stats.cached_bytes += slot.data.size;
+}
+
+static void cache_remove(u32 index) {
+  Slot &slot = state.slots[index];
+  if (slot.previous != invalid_index) {
+    state.slots[slot.previous].next = slot.next;
+  } else {
+    state.oldest_cached = slot.next;
+  }
+  if (slot.next != invalid_index) {
+    state.slots[slot.next].previous = slot.previous;
+  } else {
+    state.newest_cached = slot.previous;
+  }
+  state.stats.cached_bytes -= slot.data.size;
+}
+
+static void unload(Slot &slot) {
+  state.stats.resident_bytes -= slot.data.size;
+  if (slot.loader.decode) {
+    if (slot.loader.free) {
+      slot.loader.free(slot.data);
+    }
+  } else {
+    // The resource is the file's contents.
+    free_contents(slot);
+  }
+  slot.data = {};
+}
+
+static void evict(u32 index) {
+  cache_remove(index);
+  unload(state.slots[index]);
+  free_slot(index);
+  state.stats.evictions++;
+}
+
+static void start_load(u32 index, const char *path) {
+  Slot &slot  = state.slots[index];
+  slot.state  = SlotReading;
+  slot.bytes  = nullptr;
+  slot.size   = 0;
+  slot.mapped = false;
+  slot.data   = {};
+  state.pending++;
+  while (!state.requests.push({index, path, slot.loader.map})) {
+    std::this_thread::yield();
+  }
+  state.io_epoch.fetch_add(1);
+  state.io_epoch.notify_one();
+}
+
+static void finish_load(u32 index, bool success) {
+  Slot &slot = state.slots[index];
+  state.pending--;
+  if (success) {
+    slot.state = SlotReady;
+    state.stats.loads++;
+    state.stats.resident_bytes += slot.data.size;
+    if (slot.references == 0) {
+      cache_insert(index);
+    }
+  } else {
+    free_contents(slot);
+    slot.state = SlotFailed;
+    state.stats.failures++;
+    HN_warn("Failed to load resource '%s'.", strings::lookup(slot.path));
+  }
+  state.notify.push_back(index);
+}
+
+// Runs the slot's waiting callbacks if its load has finished.
+static void notify(u32 index) {
+  Slot &slot = state.slots[index];
+  if (slot.state != SlotReady && slot.state != SlotFailed) {
+    return;
+  }
+  Handle handle     = make_handle(index);
+  bool   success    = slot.state == SlotReady;
+  u32    waiter     = slot.first_waiter;
+  slot.first_waiter = slot.last_waiter = invalid_index;
+  while (waiter != invalid_index) {
+    // Callbacks may load resources, reusing the waiter or growing the array.
+    Waiter current             = state.waiters[waiter];
+    state.waiters[waiter].next = state.free_waiters;
+    state.free_waiters         = waiter;
+    current.on_loaded(handle, success, current.user_data);
+    waiter = current.next;
+  }
+  if (slot.state == SlotFailed && slot.references == 0) {
+    free_slot(index);
+  }
+}
+
+static void add_waiter(u32 index, PFN_on_loaded on_loaded, void *user_data) {
+  u32 waiter = state.free_waiters;
+  if (waiter != invalid_index) {
+    state.free_waiters = state.waiters[waiter].next;
+  } else {
+    waiter = (u32)state.waiters.size();
+    state.waiters.push_back({});
+  }
+  state.waiters[waiter] = {on_loaded, user_data, invalid_index};
+  Slot &slot            = state.slots[index];
+  if (slot.last_waiter != invalid_index) {
+    state.waiters[slot.last_waiter].next = waiter;
+  } else {
+    slot.first_waiter = waiter;
+  }
+  slot.last_waiter = waiter;
+}
+
+bool initialize(const Config &config) {
+  if (state.slots) {
+    HN_error("Resource system is already initialized.");
+    return false;
+  }
+  if (config.max_resources == 0 || config.queue_depth == 0) {
+    HN_error("Resource system needs at least one slot and one read in flight.");
+    return false;
+  }
+
+  u64 queue_capacity = 1;
+  while (queue_capacity < config.max_resources) {
+    queue_capacity <<= 1;
+  }
+  if (!state.requests.create(queue_capacity, mem::TagResource) ||
+      !state.reads_done.create(queue_capacity, mem::TagResource) ||
+      !state.decoded.create(queue_capacity, mem::TagResource)) {
+    return false;
+  }
+  if (!platform::async_reader_create(state.reader, config.queue_depth, config.native_io)) {
+    return false;
+  }
+
+  state.config = config;
+  state.slots  = (Slot *)mem::allocate(config.max_resources * sizeof(Slot), mem::TagResource);
+  for (u32 i = 0; i < config.max_resources; ++i) {
+    Slot &slot        = state.slots[i];
+    slot.generation   = 1;
+    slot.next         = i + 1 < config.max_resources ? i + 1 : invalid_index;
+    slot.first_waiter = slot.last_waiter = invalid_index;
+  }
+  state.free_list = 0;
+
+  state.reads      = (PendingRead *)mem::allocate(config.queue_depth * sizeof(PendingRead),
+                                                  mem::TagResource);
+  state.free_reads = (u32 *)mem::allocate(config.queue_depth * sizeof(u32), mem::TagResource);
+  for (u32 i = 0; i < config.queue_depth; ++i) {
+    state.free_reads[i] = i;
+  }
+  state.free_count      = config.queue_depth;
+  state.stats           = {};
+  state.stats.native_io = state.reader.native;
+  state.running.store(true);
+  state.io_thread = std::thread(io_loop);
+
+  HN_debug("Resource system initialized: %u slots, %llu byte cache, %s reads.",
+           config.max_resources, config.cache_budget,
+           state.reader.native ? "asynchronous" : "blocking");
+  return true;
+}
+
+void terminate() {
+  if (!state.slots) {
+    return;
+  }
+
+  // The I/O thread finishes its reads in flight and leaves the rest queued.
+  state.running.store(false);
+  state.io_epoch.fetch_add(1);
+  state.io_epoch.notify_all();
+  state.io_thread.join();
+  job::wait(state.decoding);
+
+  // Take back what the threads finished since the last update.
+  ReadDone done;
+  while (state.reads_done.pop(done)) {
+    Slot &slot  = state.slots[done.slot];
+    slot.bytes  = done.bytes;
+    slot.size   = done.size;
+    slot.mapped = done.mapped;
+    free_contents(slot);
+  }
+  u32 index;
+  while (state.decoded.pop(index)) {
+    if (state.slots[index].success) {
+      state.slots[index].state = SlotReady;
+    }
+  }
+
+  u32 referenced = 0;
+  for (u32 i = 0; i < state.config.max_resources; ++i) {
+    Slot &slot = state.slots[i];
+    if (slot.state == SlotReady) {
+      unload(slot);
+    }
+    referenced += slot.state != SlotFree && slot.references > 0;
+  }
+  if (referenced > 0) {
+    HN_warn("%u resources were still referenced at shutdown.", referenced);
+  }
+  HN_debug("Resources: %llu requests, %llu cache hits, %llu loads, %llu failures, %llu evictions, "
+           "%llu bytes read.",
+           state.stats.requests, state.stats.cache_hits, state.stats.loads, state.stats.failures,
+           state.stats.evictions, state.bytes_read.load());
+
+  platform::async_reader_destroy(state.reader);
+  mem::free(state.reads, state.config.queue_depth * sizeof(PendingRead), mem::TagResource);
+  mem::free(state.free_reads, state.config.queue_depth * sizeof(u32), mem::TagResource);
+  mem::free(state.slots, state.config.max_resources * sizeof(Slot), mem::TagResource);
+  state.requests.destroy();
+  state.reads_done.destroy();
+  state.decoded.destroy();
+  state.paths         = HashMap<strings::StringId, u32>{mem::TagResource};
+  state.waiters       = DArray<Waiter>{mem::TagResource};
+  state.notify        = DArray<u32>{mem::TagResource};
+  state.slots         = nullptr;
+  state.reads         = nullptr;
+  state.free_reads    = nullptr;
+  state.free_list     = invalid_index;
+  state.free_waiters  = invalid_index;
+  state.oldest_cached = state.newest_cached = invalid_index;
+  state.pending       = 0;
+  state.stats         = {};
+  state.bytes_read.store(0);
+}
+
+Handle load(const char *path, const Loader *loader, PFN_on_loaded on_loaded, void *user_data) {
+  if (!state.slots) {
+    HN_error("Resource system is not initialized; cannot load '%s'.", path);
+    return invalid_handle;
+  }
+  state.stats.requests++;
+
+  strings::StringId id    = strings::intern(path);
+  u32              *found = state.paths.find(id);
+  u32               index = found ? *found : invalid_index;
+  if (index != invalid_index) {
+    Slot &slot = state.slots[index];
+    if (slot.state == SlotReady) {
+      state.stats.cache_hits++;
+      if (slot.references == 0) {
+        cache_remove(index);
+      }
+    } else if (slot.state == SlotFailed) {
+      // Try again; the file may be there now.
+      start_load(index, strings::lookup(id));
+    }
+  } else {
+    const char *stored_path = strings::lookup(id);
+    if (!stored_path) {
+      HN_error("Resource system needs the string table; cannot load '%s'.", path);
+      return invalid_handle;
+    }
+    // Out of slots: make room by evicting the least recently used cached resource.
+    if (state.free_list == invalid_index && state.oldest_cached != invalid_index) {
+      evict(state.oldest_cached);
+    }
+    index = state.free_list;
+    if (index == invalid_index) {
+      HN_error("All %u resource slots are referenced; cannot load '%s'.",
+               state.config.max_resources, path);
+      return invalid_handle;
+    }
+    Slot &slot        = state.slots[index];
+    state.free_list   = slot.next;
+    slot.path         = id;
+    slot.loader       = loader ? *loader : Loader{};
+    slot.references   = 0;
+    slot.first_waiter = slot.last_waiter = invalid_index;
+    state.paths.insert(id, index);
+    start_load(index, stored_path);
+  }
+
+  Slot &slot = state.slots[index];
+  slot.references++;
+  if (on_loaded) {
+    add_waiter(index, on_loaded, user_data);
+    if (slot.state == SlotReady) {
+      // Callbacks always run from update(), never from inside load.
+      state.notify.push_back(index);
+    }
+  }
+  return make_handle(index);
+}
+
+void release(Handle handle) {
+  u32 index = resolve(handle);
+  if (index == invalid_index) {
+    HN_warn("Releasing an invalid resource handle.");
+    return;
+  }
+  Slot &slot = state.slots[index];
+  if (slot.references == 0) {
+    HN_warn("Resource '%s' released more often than loaded.", strings::lookup(slot.path));
+    return;
+  }
+  if (--slot.references > 0) {
+    return;
+  }
+  if (slot.state == SlotReady) {
+    cache_insert(index);
+  } else if (slot.state == SlotFailed && slot.first_waiter == invalid_index) {
+    free_slot(index);
+  }
+  // Loads in flight are cached or freed when they finish.
+}
+
+Status get_status(Handle handle) {
+  u32 index = resolve(handle);
+  if (index == invalid_index) {
+    return Status::Invalid;
+  }
+  switch (state.slots[index].state) {
+  case SlotReady: return Status::Ready;
+  case SlotFailed: return Status::Failed;
+  default: return Status::Loading;
+  }
+}
+
+const Data *get_data(Handle handle) {
+  u32 index = resolve(handle);
+  if (index == invalid_index || state.slots[index].state != SlotReady) {
+    return nullptr;
+  }
+  return &state.slots[index].data;
+}
+
+void update() {
+  if (!state.slots) {
+    return;
+  }
+  HN_PROFILE_FUNCTION();
+
+  ReadDone done;
+  while (state.reads_done.pop(done)) {
+    Slot &slot  = state.slots[done.slot];
+    slot.bytes  = done.bytes;
+    slot.size   = done.size;
+    slot.mapped = done.mapped;
+    if (!done.success) {
+      finish_load(done.slot, false);
+    } else if (!slot.loader.decode) {
+      slot.data = {slot.bytes, slot.size};
+      finish_load(done.slot, true);
+    } else {
+      slot.state = SlotDecoding;
+      // Without workers a queued job would only run once the main thread waits; decode now.
+      if (job::get_thread_count() > 1) {
+        job::run(decode, &slot, &state.decoding);
+      } else {
+        decode(&slot);
+      }
+    }
+  }
+  u32 index;
+  while (state.decoded.pop(index)) {
+    finish_load(index, state.slots[index].success);
+  }
+
+  // Callbacks may queue more notifications; those run in this pass too.
+  for (u64 i = 0; i < state.notify.size(); ++i) {
+    notify(state.notify[i]);
+  }
+  state.notify.clear();
+
+  while (state.stats.cached_bytes > state.config.cache_budget &&
+         state.oldest_cached != invalid_index) {
+    evict(state.oldest_cached);
+  }
+}
+
+void flush() {
+  HN_PROFILE_FUNCTION();
+  while (true) {
+    u32 epoch = state.done_epoch.load();
+    update();
+    if (state.pending == 0) {
+      return;
+    }
+    // Help with the decoding, or sleep until the I/O thread or a decoder hands something back.
+    if (state.decoding.pending.load(std::memory_order_acquire) > 0) {
+      job::wait(state.decoding);
+    } else {
+      state.done_epoch.wait(epoch);
+    }
+  }
+}
+
+void get_stats(Stats &out_stats) {
+  out_stats            = state.stats;
+  out_stats.bytes_read = state.bytes_read.load(std::memory_order_relaxed);
+}
+
+} // namespace hn::resource
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "defines.h"
+
+namespace hn::resource {
+
+// Asynchronous resource loading. load() returns a handle at once. A dedicated I/O thread reads
+// the file, with io_uring on Linux where available, and a job worker decodes it. The completion
+// callback then runs on the main thread in update(). Resources are reference counted by path:
+// loading a path again shares the resource. Ones nobody references stay loaded in an LRU cache up
+// to a byte budget, so loading them again costs nothing.
+
+// A resource: its slot in the low 32 bits, the slot's generation in the high ones. Zero is never a
+// valid handle.
+typedef u64 Handle;
+
+const Handle invalid_handle = 0;
+
+enum class Status : u8 {
+  Invalid, // Not a live handle.
+  Loading,
+  Ready,
+  Failed,
+};
+
+// A loaded resource.
+struct Data {
+  void *memory = nullptr;
+  u64   size   = 0; // Bytes counted against the cache budget.
+};
+
+/**
+ * Turns file contents into a resource. Runs on a job worker, so it must be thread-safe.
+ * @param bytes The file's contents; only valid during the call.
+ * @param out_data Receives the resource.
+ * @returns False if the contents are invalid, failing the load.
+ */
+typedef bool (*PFN_decode)(const u8 *bytes, u64 size, Data &out_data);
+
+// Frees what a decoder produced. Runs on the main thread.
+typedef void (*PFN_free)(Data &data);
+
+// How to load a kind of resource. Without a decoder the resource is the file's contents as is.
+struct Loader {
+  PFN_decode decode = nullptr;
+  PFN_free   free   = nullptr;
+  bool       map    = false; // Map the file rather than read it: no copy, pages load when touched.
+};
+
+// Called on the main thread once a load has finished, successfully or not.
+typedef void (*PFN_on_loaded)(Handle handle, bool success, void *user_data);
+
+struct Config {
+  u32  max_resources = 4096;              // Resources loading, loaded or cached at once.
+  u64  cache_budget  = 256 * 1024 * 1024; // Bytes of unreferenced resources kept loaded.
+  u32  queue_depth   = 64;                // File reads in flight at once.
+  bool native_io     = true;              // Use the OS's asynchronous reads where it has them.
+};
+
+bool initialize(const Config &config = {});
+
+// Waits for the loads in flight, then frees every resource, referenced or not.
+void terminate();
+
+/**
+ * Requests a resource and adds a reference to it. Main thread only.
+ * @param path The file to load.
+ * @param loader How to load it; null loads the raw contents. Ignored if the path is already
+ * loading or loaded. Copied.
+ * @param on_loaded Optional; called from update() once the resource is ready or has failed, even
+ * if it was ready already.
+ * @param user_data Passed to `on_loaded`.
+ * @returns The resource's handle; invalid_handle if every slot is taken by referenced resources.
+ */
+Handle load(const char *path, const Loader *loader = nullptr, PFN_on_loaded on_loaded = nullptr,
+            void *user_data = nullptr);
+
+// Drops a reference. An unreferenced resource stays cached until the budget evicts it.
+void release(Handle handle);
+
+Status get_status(Handle handle);
+
+/**
+ * The loaded resource.
+ * @returns Null unless the resource is ready.
+ */
+const Data *get_data(Handle handle);
+
+// Starts decoding finished reads, runs completion callbacks and trims the cache to its budget.
+// Call once per frame on the main thread.
+void update();
+
+// Calls update() until every load requested so far has finished and its callbacks have run.
+void flush();
+
+struct Stats {
+  u64  requests;       // Calls to load.
+  u64  cache_hits;     // Requests for resources that were loaded already.
+  u64  loads;          // Loads that finished successfully.
+  u64  failures;       // Loads that failed.
+  u64  evictions;      // Unreferenced resources freed to stay within the budget.
+  u64  bytes_read;     // File bytes read or mapped.
+  u64  resident_bytes; // Size of every loaded resource.
+  u64  cached_bytes;   // The part of it nobody references.
+  bool native_io;      // Whether reads go through the OS's asynchronous interface.
+};
+
+void get_stats(Stats &out_stats);
+
+} // namespace hn::resource
@@ -0,0 +1,116 @@
+#include "strings.h"
+#include "container/darray_t.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+
+namespace hn::strings {
+
+struct Page {
+  char *data;
+  u64   size;
+};
+
+struct StringsState {
+  std::shared_mutex               lock;
+  HashMap<StringId, const char *> strings{mem::TagString};
+  DArray<Page>                    pages{mem::TagString}; // Every block allocated, to free them.
+  char                           *page      = nullptr;  // The page being filled.
+  u64                             page_used = 0;
+  u64                             bytes     = 0;
+  bool                            running   = false;
+};
+
+static StringsState state;
+
+// Room for `size` bytes of string storage. Expects the lock to be held exclusively.
+static char *reserve(u64 size) {
+  // Long strings get a block of their own rather than wasting the rest of the current page.
+  if (size > page_size / 4) {
+    char *data = (char *)mem::allocate(size, mem::TagString, mem::AllocateUninitialized);
+    state.pages.push_back({data, size});
+    return data;
+  }
+  if (!state.page || state.page_used + size > page_size) {
+    state.page      = (char *)mem::allocate(page_size, mem::TagString, mem::AllocateUninitialized);
+    state.page_used = 0;
+    state.pages.push_back({state.page, page_size});
+  }
+  char *data = state.page + state.page_used;
+  state.page_used += size;
+  return data;
+}
+
+bool initialize() {
+  std::unique_lock lock(state.lock);
+  if (state.running) {
+    return false;
+  }
+  state.running = true;
+  HN_debug("String table initialized.");
+  return true;
+}
+
+void terminate() {
+  std::unique_lock lock(state.lock);
+  if (!state.running) {
+    return;
+  }
+  HN_debug("String table: %llu strings, %llu bytes in %llu pages.", state.strings.size(),
+           state.bytes, state.pages.size());
+  for (const Page &page : state.pages) {
+    mem::free(page.data, page.size, mem::TagString);
+  }
+  state.pages     = DArray<Page>{mem::TagString};
+  state.strings   = HashMap<StringId, const char *>{mem::TagString};
+  state.page      = nullptr;
+  state.page_used = 0;
+  state.bytes     = 0;
+  state.running   = false;
+}
+
+StringId intern(const char *string, u64 length) {
+  StringId id = {hash(string, length)};
+  {
+    std::shared_lock lock(state.lock);
+    if (!state.running) {
+      return id;
+    }
+    if (const char *const *stored = state.strings.find(id)) {
+      if (strncmp(*stored, string, length) != 0 || (*stored)[length] != '\0') {
+        HN_error("String id collision: \"%s\" and \"%.*s\" share id %016llx.", *stored,
+                 (int)length, string, id.value);
+      }
+      return id;
+    }
+  }
+
+  std::unique_lock lock(state.lock);
+  // Another thread may have stored it, or terminated, between the two locks.
+  if (state.running && !state.strings.contains(id)) {
+    char *stored = reserve(length + 1);
+    memcpy(stored, string, length);
+    stored[length] = '\0';
+    state.bytes += length + 1;
+    state.strings.insert(id, stored);
+  }
+  return id;
+}
+
+StringId intern(const char *string) { return intern(string, strlen(string)); }
+
+const char *lookup(StringId id) {
+  std::shared_lock lock(state.lock);
+  const char *const *stored = state.strings.find(id);
+  return stored ? *stored : nullptr;
+}
+
+void get_stats(u64 &out_count, u64 &out_bytes) {
+  std::shared_lock lock(state.lock);
+  out_count = state.strings.size();
+  out_bytes = state.bytes;
+}
+
+} // namespace hn::strings
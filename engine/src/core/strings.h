@@ -0,0 +1,77 @@
+#pragma once
+
+#include "container/hash_map.h"
+#include "defines.h"
+
+namespace hn::strings {
+
+// String interning. Every distinct string is stored once, in pages allocated under TagString, and
+// named by a StringId: a 64-bit hash of its contents. Ids compare and hash as integers, stay the
+// same across runs and builds, and can be computed at compile time, so code can match a runtime
+// name against `strings::id("player")` without touching the table.
+
+struct StringId {
+  u64 value;
+
+  bool operator==(const StringId &other) const = default;
+};
+
+// FNV-1a followed by a finalizer that spreads it over all 64 bits, so ids can key a HashMap as is.
+constexpr u64 hash(const char *string, u64 length) {
+  u64 hash = 0xcbf29ce484222325ull;
+  for (u64 i = 0; i < length; ++i) {
+    hash = (hash ^ (u8)string[i]) * 0x100000001b3ull;
+  }
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ull;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebull;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+// The id of a string literal, computed at compile time.
+template <u64 N> consteval StringId id(const char (&literal)[N]) {
+  return {hash(literal, N - 1)};
+}
+
+const StringId empty_string_id = id("");
+
+// Bytes per page of string storage; longer strings get a block of their own.
+const u64 page_size = 64 * 1024;
+
+bool initialize();
+
+// Frees every stored string. Ids remain valid, but lookup no longer resolves them.
+void terminate();
+
+/**
+ * Stores the string if it is new. Thread-safe; strings already stored only take a shared lock.
+ * Before initialize, or after terminate, the id is computed but nothing is stored.
+ * @param string The string; copied.
+ * @param length Its length in bytes, not counting a terminator.
+ * @returns The string's id.
+ */
+StringId intern(const char *string, u64 length);
+StringId intern(const char *string);
+
+/**
+ * Reverse lookup, meant for logs and debugging. Thread-safe.
+ * @returns The stored, null-terminated string, valid until terminate; or nullptr if the id was
+ * never interned.
+ */
+const char *lookup(StringId id);
+
+// The number of distinct strings stored and the bytes they occupy.
+void get_stats(u64 &out_count, u64 &out_bytes);
+
+} // namespace hn::strings
+
+namespace hn {
+
+// Ids are hashes already.
+template <> struct Hasher<strings::StringId> {
+  u64 operator()(strings::StringId id) const { return id.value; }
+};
+
+} // namespace hn
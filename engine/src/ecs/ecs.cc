@@ -0,0 +1,482 @@
+#include "ecs.h"
+#include "core/job.h"
+#include "core/log.h"
+#include "core/memory.h"
+#include "core/profile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace hn::ecs {
+
+// Chunk layout: a header, the entities, then one array per component, each starting on a cache
+// line.
+struct ChunkHeader {
+  u32 count;
+};
+
+const u64 chunk_alignment = 64;
+const u64 entities_offset = chunk_alignment;
+
+struct Archetype {
+  Signature    signature;
+  u32          capacity; // Entities per chunk.
+  u32          entity_count;
+  u32          component_count;
+  ComponentId  components[max_components];
+  u32          offsets[max_components]; // Of each component's array in a chunk by id; 0 if absent.
+  DArray<u8 *> chunks{mem::TagScene};
+};
+
+// Process-wide component registry.
+static std::atomic<u32> component_count{0};
+static u32              component_sizes[max_components];
+static u32              component_alignments[max_components];
+
+static u64 align_up(u64 value, u64 alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+ComponentId register_component(u32 size, u32 alignment) {
+  u32 id = component_count.fetch_add(1, std::memory_order_relaxed);
+  if (id >= max_components || alignment > chunk_alignment) {
+    // Any id handed out instead would alias a live component of another size.
+    HN_fatal("Cannot register component %u of size %u, alignment %u.", id, size, alignment);
+    std::abort();
+  }
+  component_sizes[id]      = size;
+  component_alignments[id] = alignment;
+  return (ComponentId)id;
+}
+
+// Lays out a chunk for `capacity` entities; returns the bytes used.
+static u64 layout_chunk(Archetype &archetype, u32 capacity) {
+  u64 offset = entities_offset + capacity * sizeof(Entity);
+  for (u32 i = 0; i < archetype.component_count; ++i) {
+    ComponentId component        = archetype.components[i];
+    offset                       = align_up(offset, chunk_alignment);
+    archetype.offsets[component] = (u32)offset;
+    offset += (u64)capacity * component_sizes[component];
+  }
+  return offset;
+}
+
+static Archetype *find_archetype(World &world, const Signature &signature) {
+  for (Archetype *archetype : world.archetypes) {
+    if (archetype->signature == signature) {
+      return archetype;
+    }
+  }
+
+  auto archetype = (Archetype *)mem::allocate(sizeof(Archetype), mem::TagScene);
+  if (!archetype) {
+    HN_fatal("Failed to allocate an archetype.");
+    std::abort();
+  }
+  new (archetype) Archetype();
+  archetype->signature = signature;
+  for (u32 component = 0; component < max_components; ++component) {
+    if (signature.test(component)) {
+      archetype->components[archetype->component_count++] = (ComponentId)component;
+    }
+  }
+
+  // Start from the capacity ignoring alignment padding and shrink until the layout fits.
+  u64 entity_size = sizeof(Entity);
+  for (u32 i = 0; i < archetype->component_count; ++i) {
+    entity_size += component_sizes[archetype->components[i]];
+  }
+  u32 capacity = (u32)((chunk_size - entities_offset) / entity_size);
+  while (capacity > 1 && layout_chunk(*archetype, capacity) > chunk_size) {
+    capacity--;
+  }
+  if (layout_chunk(*archetype, capacity) > chunk_size) {
+    HN_fatal("Components of %u bytes per entity do not fit in a chunk.", (u32)entity_size);
+    std::abort();
+  }
+  archetype->capacity = capacity;
+  world.archetypes.push_back(archetype);
+  return archetype;
+}
+
+static u32 &chunk_count(u8 *chunk) { return ((ChunkHeader *)chunk)->count; }
+
+static Entity *chunk_entities(u8 *chunk) { return (Entity *)(chunk + entities_offset); }
+
+static u8 *component_at(const Archetype &archetype, u8 *chunk, ComponentId component, u32 row) {
+  return chunk + archetype.offsets[component] + (u64)row * component_sizes[component];
+}
+
+static Entity make_entity(u32 index, u32 generation) { return (u64)generation << 32 | index; }
+
+static EntityRecord *find_record(const World &world, Entity entity) {
+  u32 index = (u32)entity;
+  if (index >= world.records.size()) {
+    return nullptr;
+  }
+  auto record = const_cast<EntityRecord *>(&world.records[index]);
+  if (record->generation != (u32)(entity >> 32) || !record->archetype) {
+    return nullptr;
+  }
+  return record;
+}
+
+// Claims up to `count` rows at the end of the archetype's last chunk, allocating a chunk if it is
+// full, and returns how many it got. The rows' entities and components are left uninitialized.
+static u32 push_rows(Archetype &archetype, u32 count, u32 &out_chunk, u32 &out_row) {
+  if (archetype.chunks.empty() || chunk_count(archetype.chunks.back()) == archetype.capacity) {
+    auto chunk = (u8 *)mem::allocate_aligned(chunk_size, chunk_alignment, mem::TagEntity,
+                                             mem::AllocateUninitialized);
+    if (!chunk) {
+      HN_fatal("Failed to allocate a chunk of %llu bytes.", chunk_size);
+      std::abort();
+    }
+    chunk_count(chunk) = 0;
+    archetype.chunks.push_back(chunk);
+  }
+  u8 *chunk = archetype.chunks.back();
+  u32 free  = archetype.capacity - chunk_count(chunk);
+  count     = count < free ? count : free;
+  out_chunk = (u32)archetype.chunks.size() - 1;
+  out_row   = chunk_count(chunk);
+  chunk_count(chunk) += count;
+  archetype.entity_count += count;
+  return count;
+}
+
+// Appends a row for the entity; its components are left uninitialized.
+static void push_row(Archetype &archetype, Entity entity, EntityRecord &record) {
+  push_rows(archetype, 1, record.chunk, record.row);
+  chunk_entities(archetype.chunks[record.chunk])[record.row] = entity;
+  record.archetype                                          = &archetype;
+}
+
+// Removes a row by moving the archetype's last row into it, which keeps every chunk but the last
+// one full.
+static void remove_row(World &world, Archetype &archetype, u32 chunk_index, u32 row) {
+  u8 *chunk = archetype.chunks[chunk_index];
+  u8 *last  = archetype.chunks.back();
+  u32 tail  = chunk_count(last) - 1;
+  if (chunk != last || row != tail) {
+    Entity moved               = chunk_entities(last)[tail];
+    chunk_entities(chunk)[row] = moved;
+    for (u32 i = 0; i < archetype.component_count; ++i) {
+      ComponentId component = archetype.components[i];
+      mem::copy(component_at(archetype, chunk, component, row),
+                component_at(archetype, last, component, tail), component_sizes[component]);
+    }
+    EntityRecord &record = world.records[(u32)moved];
+    record.chunk         = chunk_index;
+    record.row           = row;
+  }
+  if (--chunk_count(last) == 0) {
+    mem::free_aligned(last, chunk_size, chunk_alignment, mem::TagEntity);
+    archetype.chunks.pop_back();
+  }
+  archetype.entity_count--;
+}
+
+static EntityRecord &new_record(World &world, Entity &out_entity) {
+  u32 index;
+  if (!world.free_records.empty()) {
+    index = world.free_records.back();
+    world.free_records.pop_back();
+  } else {
+    index = (u32)world.records.size();
+    world.records.push_back({nullptr, 0, 0, 1});
+  }
+  out_entity = make_entity(index, world.records[index].generation);
+  return world.records[index];
+}
+
+// Moves an entity to another archetype, keeping the components both have and zeroing new ones.
+static void move_entity(World &world, Entity entity, EntityRecord &record, Archetype &target) {
+  Archetype &source = *record.archetype;
+  u8        *from   = source.chunks[record.chunk];
+  u32        row    = record.row;
+  u32        chunk  = record.chunk;
+  push_row(target, entity, record);
+  u8 *to = target.chunks[record.chunk];
+  for (u32 i = 0; i < target.component_count; ++i) {
+    ComponentId component   = target.components[i];
+    u8         *destination = component_at(target, to, component, record.row);
+    if (source.signature.test(component)) {
+      mem::copy(destination, component_at(source, from, component, row),
+                component_sizes[component]);
+    } else {
+      mem::zero(destination, component_sizes[component]);
+    }
+  }
+  // The entity's record now points into the target; fix up whichever entity fills the hole.
+  remove_row(world, source, chunk, row);
+}
+
+static bool check_structural_change(const World &world) {
+  if (world.iterating) {
+    HN_error("Structural changes are not allowed while a query runs; use a CommandBuffer.");
+    return false;
+  }
+  return true;
+}
+
+bool world_create(World &out_world) {
+  out_world.entity_count = 0;
+  out_world.iterating    = 0;
+  return true;
+}
+
+void world_destroy(World &world) {
+  for (Archetype *archetype : world.archetypes) {
+    for (u8 *chunk : archetype->chunks) {
+      mem::free_aligned(chunk, chunk_size, chunk_alignment, mem::TagEntity);
+    }
+    archetype->~Archetype();
+    mem::free(archetype, sizeof(Archetype), mem::TagScene);
+  }
+  world.archetypes   = DArray<Archetype *>(mem::TagScene);
+  world.records      = DArray<EntityRecord>(mem::TagEntity);
+  world.free_records = DArray<u32>(mem::TagEntity);
+  world.entity_count = 0;
+}
+
+bool create(World &world, const Signature &components, u32 count, Entity *out_entities) {
+  if (!check_structural_change(world)) {
+    return false;
+  }
+  Archetype &archetype = *find_archetype(world, components);
+  // Room for the records the free list cannot supply, growing geometrically as push_back would.
+  u64 free_count = world.free_records.size();
+  u64 needed     = world.records.size() + (count > free_count ? count - free_count : 0);
+  if (needed > world.records.capacity()) {
+    world.records.reserve(std::max(needed, world.records.capacity() * 2));
+  }
+  // A chunk at a time, so the components are zeroed a whole range per array.
+  for (u32 created = 0; created < count;) {
+    u32 chunk_index;
+    u32 first;
+    u32 rows  = push_rows(archetype, count - created, chunk_index, first);
+    u8 *chunk = archetype.chunks[chunk_index];
+    for (u32 row = first; row < first + rows; ++row) {
+      Entity        entity;
+      EntityRecord &record       = new_record(world, entity);
+      record                     = {&archetype, chunk_index, row, record.generation};
+      chunk_entities(chunk)[row] = entity;
+      if (out_entities) {
+        out_entities[created + row - first] = entity;
+      }
+    }
+    for (u32 c = 0; c < archetype.component_count; ++c) {
+      ComponentId component = archetype.components[c];
+      mem::zero(component_at(archetype, chunk, component, first),
+                (u64)rows * component_sizes[component]);
+    }
+    created += rows;
+  }
+  world.entity_count += count;
+  return true;
+}
+
+Entity create(World &world, const Signature &components) {
+  Entity entity = invalid_entity;
+  create(world, components, 1, &entity);
+  return entity;
+}
+
+bool destroy(World &world, Entity entity) {
+  EntityRecord *record = find_record(world, entity);
+  if (!record || !check_structural_change(world)) {
+    return false;
+  }
+  remove_row(world, *record->archetype, record->chunk, record->row);
+  record->archetype = nullptr;
+  // Generation 0 would let a stale handle of the wrapped-around record alias invalid_entity.
+  record->generation = record->generation + 1 ? record->generation + 1 : 1;
+  world.free_records.push_back((u32)entity);
+  world.entity_count--;
+  return true;
+}
+
+bool is_alive(const World &world, Entity entity) { return find_record(world, entity) != nullptr; }
+
+void *add(World &world, Entity entity, ComponentId component) {
+  EntityRecord *record = find_record(world, entity);
+  if (!record) {
+    return nullptr;
+  }
+  if (!record->archetype->signature.test(component)) {
+    if (!check_structural_change(world)) {
+      return nullptr;
+    }
+    Signature signature = record->archetype->signature;
+    signature.set(component);
+    move_entity(world, entity, *record, *find_archetype(world, signature));
+  }
+  return component_at(*record->archetype, record->archetype->chunks[record->chunk], component,
+                      record->row);
+}
+
+bool remove(World &world, Entity entity, ComponentId component) {
+  EntityRecord *record = find_record(world, entity);
+  if (!record || !record->archetype->signature.test(component) ||
+      !check_structural_change(world)) {
+    return false;
+  }
+  Signature signature = record->archetype->signature;
+  signature.reset(component);
+  move_entity(world, entity, *record, *find_archetype(world, signature));
+  return true;
+}
+
+void *get(const World &world, Entity entity, ComponentId component) {
+  EntityRecord *record = find_record(world, entity);
+  if (!record || !record->archetype->signature.test(component)) {
+    return nullptr;
+  }
+  return component_at(*record->archetype, record->archetype->chunks[record->chunk], component,
+                      record->row);
+}
+
+void *ChunkView::column(ComponentId component) const {
+  u32 offset = archetype->offsets[component];
+  return offset ? data + offset : nullptr;
+}
+
+static bool matches(const Archetype &archetype, const Query &query) {
+  return archetype.entity_count > 0 && archetype.signature.contains(query.all) &&
+         !archetype.signature.intersects(query.none);
+}
+
+static ChunkView make_view(const Archetype &archetype, u8 *chunk) {
+  return {chunk_count(chunk), chunk_entities(chunk), chunk, &archetype};
+}
+
+u32 count(World &world, const Query &query) {
+  u32 total = 0;
+  for (const Archetype *archetype : world.archetypes) {
+    if (matches(*archetype, query)) {
+      total += archetype->entity_count;
+    }
+  }
+  return total;
+}
+
+void for_each_chunk(World &world, const Query &query, PFN_chunk callback, void *data) {
+  HN_PROFILE_FUNCTION();
+  world.iterating++;
+  for (const Archetype *archetype : world.archetypes) {
+    if (!matches(*archetype, query)) {
+      continue;
+    }
+    for (u8 *chunk : archetype->chunks) {
+      callback(make_view(*archetype, chunk), data);
+    }
+  }
+  world.iterating--;
+}
+
+struct ParallelQuery {
+  const ChunkView *views;
+  PFN_chunk        callback;
+  void            *data;
+};
+
+static void run_chunks(u32 begin, u32 end, void *data) {
+  auto query = (ParallelQuery *)data;
+  for (u32 i = begin; i < end; ++i) {
+    query->callback(query->views[i], query->data);
+  }
+}
+
+void for_each_chunk_parallel(World &world, const Query &query, PFN_chunk callback, void *data,
+                             u32 chunks_per_job) {
+  HN_PROFILE_FUNCTION();
+  DArray<ChunkView> views(mem::TagScene);
+  for (const Archetype *archetype : world.archetypes) {
+    if (!matches(*archetype, query)) {
+      continue;
+    }
+    for (u8 *chunk : archetype->chunks) {
+      views.push_back(make_view(*archetype, chunk));
+    }
+  }
+  if (views.empty()) {
+    return;
+  }
+  world.iterating++;
+  ParallelQuery parallel{views.data(), callback, data};
+  job::parallel_for((u32)views.size(), chunks_per_job ? chunks_per_job : 1, run_chunks, &parallel);
+  world.iterating--;
+}
+
+// Command buffer encoding: a Command, then for CommandAdd with a value the component's bytes,
+// padded to 8.
+enum CommandType : u8 { CommandCreate, CommandDestroy, CommandAdd, CommandRemove };
+
+struct Command {
+  CommandType type;
+  ComponentId component;
+  bool        has_value;
+  u32         count;
+  Entity      entity;
+  Signature   signature;
+};
+
+static void record(CommandBuffer &buffer, const Command &command, const void *value) {
+  u64 value_size = value ? align_up(component_sizes[command.component], 8) : 0;
+  std::lock_guard<std::mutex> guard(buffer.lock);
+  u64 offset = buffer.commands.size();
+  buffer.commands.resize_uninitialized(offset + sizeof(Command) + value_size);
+  mem::copy(buffer.commands.data() + offset, &command, sizeof(Command));
+  if (value) {
+    mem::copy(buffer.commands.data() + offset + sizeof(Command), value,
+              component_sizes[command.component]);
+  }
+}
+
+void command_create(CommandBuffer &buffer, const Signature &components, u32 count) {
+  record(buffer, {CommandCreate, 0, false, count, invalid_entity, components}, nullptr);
+}
+
+void command_destroy(CommandBuffer &buffer, Entity entity) {
+  record(buffer, {CommandDestroy, 0, false, 0, entity, {}}, nullptr);
+}
+
+void command_add(CommandBuffer &buffer, Entity entity, ComponentId component, const void *value) {
+  record(buffer, {CommandAdd, component, value != nullptr, 0, entity, {}}, value);
+}
+
+void command_remove(CommandBuffer &buffer, Entity entity, ComponentId component) {
+  record(buffer, {CommandRemove, component, false, 0, entity, {}}, nullptr);
+}
+
+bool flush(World &world, CommandBuffer &buffer) {
+  if (!check_structural_change(world)) {
+    return false;
+  }
+  HN_PROFILE_FUNCTION();
+  std::lock_guard<std::mutex> guard(buffer.lock);
+  u64 offset = 0;
+  while (offset < buffer.commands.size()) {
+    Command command;
+    mem::copy(&command, buffer.commands.data() + offset, sizeof(Command));
+    offset += sizeof(Command);
+    switch (command.type) {
+    case CommandCreate: create(world, command.signature, command.count); break;
+    case CommandDestroy: destroy(world, command.entity); break;
+    case CommandAdd: {
+      void *component = add(world, command.entity, command.component);
+      if (command.has_value) {
+        if (component) {
+          mem::copy(component, buffer.commands.data() + offset,
+                    component_sizes[command.component]);
+        }
+        offset += align_up(component_sizes[command.component], 8);
+      }
+      break;
+    }
+    case CommandRemove: remove(world, command.entity, command.component); break;
+    }
+  }
+  buffer.commands.clear();
+  return true;
+}
+
+} // namespace hn::ecs
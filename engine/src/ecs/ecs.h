@@ -0,0 +1,181 @@
+#pragma once
+
+#include "container/bitset.h"
+#include "container/darray_t.h"
+#include "defines.h"
+#include <mutex>
+#include <type_traits>
+
+namespace hn::ecs {
+
+// Archetype-based entity component system. Entities with the same set of components share an
+// archetype, which stores them in fixed-size chunks, one tightly packed array per component
+// (structure of arrays). Queries walk the chunks of every matching archetype linearly, optionally
+// spread across the job system. Adding or removing components moves an entity to another
+// archetype, so such structural changes are not allowed while a query runs; record them in a
+// CommandBuffer and flush it afterwards.
+
+// An entity: the index of its record in the low 32 bits, the record's generation in the high ones.
+// Zero is never a valid entity.
+typedef u64 Entity;
+
+const Entity invalid_entity = 0;
+
+// Component types that can be registered, process-wide.
+const u32 max_components = 64;
+
+// Size of a chunk in bytes; entities per chunk follow from the archetype's component sizes.
+const u64 chunk_size = 16 * 1024;
+
+typedef u8 ComponentId;
+
+// A set of component types.
+typedef BitSet<max_components> Signature;
+
+/**
+ * Registers a component type. Components are moved with memcpy and start out zeroed, so they must
+ * be trivially copyable.
+ * @param size The size of the component in bytes.
+ * @param alignment The alignment of the component; at most 64.
+ * @returns The component's id. Registering more than max_components aborts.
+ */
+ComponentId register_component(u32 size, u32 alignment);
+
+// The id of component type T, registered on first use.
+template <typename T> ComponentId component_id() {
+  static_assert(std::is_trivially_copyable_v<T>, "Components must be trivially copyable.");
+  static const ComponentId id = register_component(sizeof(T), alignof(T));
+  return id;
+}
+
+// The signature of the given component types.
+template <typename... T> Signature signature() { return Signature::of({component_id<T>()...}); }
+
+struct Archetype;
+
+// Where an entity's components live.
+struct EntityRecord {
+  Archetype *archetype;
+  u32        chunk;
+  u32        row;
+  u32        generation;
+};
+
+struct World {
+  DArray<EntityRecord> records{mem::TagEntity};
+  DArray<u32>          free_records{mem::TagEntity};
+  DArray<Archetype *>  archetypes{mem::TagScene};
+  u32                  entity_count = 0;
+  u32                  iterating    = 0; // Queries in progress; structural changes fail meanwhile.
+};
+
+bool world_create(World &out_world);
+void world_destroy(World &world);
+
+/**
+ * Creates entities with the given components, zeroed.
+ * @param world The world to create them in.
+ * @param components The components the entities start with.
+ * @param count The number of entities to create.
+ * @param out_entities Optional; receives the `count` new entities.
+ * @returns True on success; otherwise false.
+ */
+bool create(World &world, const Signature &components, u32 count, Entity *out_entities = nullptr);
+
+Entity create(World &world, const Signature &components = {});
+bool   destroy(World &world, Entity entity);
+bool   is_alive(const World &world, Entity entity);
+
+/**
+ * Adds a component to an entity, moving it to the archetype with that component.
+ * @returns The new, zeroed component; the existing one if the entity already had it; nullptr if
+ * the entity is not alive or a query is running.
+ */
+void *add(World &world, Entity entity, ComponentId component);
+bool  remove(World &world, Entity entity, ComponentId component);
+
+// The entity's component, or nullptr if it has none or is not alive.
+void *get(const World &world, Entity entity, ComponentId component);
+
+template <typename T> T *add(World &world, Entity entity) {
+  return (T *)add(world, entity, component_id<T>());
+}
+
+template <typename T> bool remove(World &world, Entity entity) {
+  return remove(world, entity, component_id<T>());
+}
+
+template <typename T> T *get(const World &world, Entity entity) {
+  return (T *)get(world, entity, component_id<T>());
+}
+
+// Queries.
+
+// Matches the archetypes that have every component of `all` and none of `none`.
+struct Query {
+  Signature all;
+  Signature none;
+};
+
+// One chunk of a query's results. The arrays hold `count` entries each.
+struct ChunkView {
+  u32              count;
+  const Entity    *entities;
+  u8              *data;
+  const Archetype *archetype;
+
+  // The chunk's array of the component, or nullptr if its archetype does not have it.
+  void *column(ComponentId component) const;
+
+  template <typename T> T *get() const { return (T *)column(component_id<T>()); }
+};
+
+typedef void (*PFN_chunk)(const ChunkView &chunk, void *data);
+
+// The number of entities a query matches.
+u32 count(World &world, const Query &query);
+
+// Calls `callback` for every chunk the query matches, on the calling thread.
+void for_each_chunk(World &world, const Query &query, PFN_chunk callback, void *data);
+
+/**
+ * Calls `callback` for every chunk the query matches, spread across the job system's threads, and
+ * waits for all of them. Chunks are independent, so the callback may write their components
+ * without locking. Must be called from the main thread or from a job.
+ * @param chunks_per_job The number of chunks each job processes.
+ */
+void for_each_chunk_parallel(World &world, const Query &query, PFN_chunk callback, void *data,
+                             u32 chunks_per_job = 4);
+
+// Deferred structural changes.
+
+// Records structural changes to apply later with flush(). Recording is thread-safe, so parallel
+// query callbacks can share one buffer.
+struct CommandBuffer {
+  DArray<u8> commands{mem::TagScene};
+  std::mutex lock;
+};
+
+void command_create(CommandBuffer &buffer, const Signature &components, u32 count = 1);
+void command_destroy(CommandBuffer &buffer, Entity entity);
+
+/**
+ * Records adding a component.
+ * @param value The component's value, copied now; nullptr adds it zeroed.
+ */
+void command_add(CommandBuffer &buffer, Entity entity, ComponentId component,
+                 const void *value = nullptr);
+void command_remove(CommandBuffer &buffer, Entity entity, ComponentId component);
+
+template <typename T> void command_add(CommandBuffer &buffer, Entity entity, const T &value) {
+  command_add(buffer, entity, component_id<T>(), &value);
+}
+
+/**
+ * Applies the recorded changes in order, then clears the buffer. Changes to entities that have
+ * been destroyed in the meantime are skipped.
+ * @returns False if a query is running, in which case nothing is applied.
+ */
+bool flush(World &world, CommandBuffer &buffer);
+
+} // namespace hn::ecs
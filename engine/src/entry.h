@@ -4,25 +4,58 @@
 #include "core/log.h"
 #include "core/memory.h"
 #include "game_types.h"
+#include <cstdlib>
+#include <cstring>
 
 // External-defined function to create a game.
 extern bool create_game(hn::Game &out_game);
 
 // The main entry point of the application.
-int main() {
+int main(int argc, char **argv) {
   hn::mem::initialize();
 
   // Request the game instance from the application.
   hn::Game game{};
   if (!create_game(game)) {
     return 1;
-  } else if (!game.validate()) {
+  }
+
+  // Command line overrides, e.g. `--headless --benchmark 10000 --trace trace.json`.
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      game.config.headless = true;
+    } else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+      game.config.benchmark_frames = (u32)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      game.config.trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--binary-log") == 0 && i + 1 < argc) {
+      game.config.binary_log_path = argv[++i];
+    } else if (strcmp(argv[i], "--alloc-sample") == 0 && i + 1 < argc) {
+      game.config.alloc_sample_rate = (u32)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--alloc-sample-size") == 0 && i + 1 < argc) {
+      game.config.alloc_sample_threshold = strtoull(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--alloc-report") == 0 && i + 1 < argc) {
+      game.config.alloc_report_path = argv[++i];
+    } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+      game.config.metrics_path = argv[++i];
+    } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+      game.config.metrics_interval = (u32)strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--record-input") == 0 && i + 1 < argc) {
+      game.config.input_record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay-input") == 0 && i + 1 < argc) {
+      game.config.input_replay_path = argv[++i];
+    }
+  }
+
+  if (!game.validate()) {
     return 2;
   }
 
   // Initialization.
   if (!hn::application::create(game)) {
     HN_error("Application failed to create.");
+    // Flush the errors and stop the log writer before exiting.
+    hn::log::terminate();
     return 3;
   }
 
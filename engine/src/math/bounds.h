@@ -0,0 +1,79 @@
+#pragma once
+
+#include "math.h"
+
+namespace hn::math {
+
+// Axis-aligned bounding box.
+struct Aabb {
+  vec3 min;
+  vec3 max;
+};
+
+inline vec3 min(const vec3 &a, const vec3 &b) {
+  return {fminf(a.x, b.x), fminf(a.y, b.y), fminf(a.z, b.z)};
+}
+
+inline vec3 max(const vec3 &a, const vec3 &b) {
+  return {fmaxf(a.x, b.x), fmaxf(a.y, b.y), fmaxf(a.z, b.z)};
+}
+
+inline Aabb merge(const Aabb &a, const Aabb &b) { return {min(a.min, b.min), max(a.max, b.max)}; }
+inline vec3 center(const Aabb &box) { return (box.min + box.max) * 0.5f; }
+
+inline Aabb expand(const Aabb &box, f32 margin) {
+  return {box.min - vec3{margin, margin, margin}, box.max + vec3{margin, margin, margin}};
+}
+
+// Half the surface area, which is all the surface area heuristic needs.
+inline f32 half_area(const Aabb &box) {
+  vec3 d = box.max - box.min;
+  return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// Whether `inner` lies entirely inside `outer`.
+inline bool contains(const Aabb &outer, const Aabb &inner) {
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+         inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+inline bool overlaps(const Aabb &a, const Aabb &b) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y &&
+         a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+// The points p with dot(normal, p) + distance >= 0 are in front of the plane.
+struct Plane {
+  vec3 normal;
+  f32  distance;
+};
+
+// Six planes facing inwards: left, right, bottom, top, near, far.
+struct Frustum {
+  Plane planes[6];
+};
+
+/**
+ * Extracts the frustum planes of a view-projection matrix (Gribb and Hartmann), normalized.
+ * @param view_projection Maps world space to clip space with depth in [0, 1], as Vulkan expects.
+ */
+inline Frustum frustum_from_matrix(const mat4 &view_projection) {
+  const vec4 *c = view_projection.columns;
+  vec4        rows[4];
+  rows[0] = {c[0].x, c[1].x, c[2].x, c[3].x};
+  rows[1] = {c[0].y, c[1].y, c[2].y, c[3].y};
+  rows[2] = {c[0].z, c[1].z, c[2].z, c[3].z};
+  rows[3] = {c[0].w, c[1].w, c[2].w, c[3].w};
+  vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                    rows[3] - rows[1], rows[2],           rows[3] - rows[2]};
+
+  Frustum frustum;
+  for (u32 i = 0; i < 6; ++i) {
+    const vec4 &p     = planes[i];
+    f32         scale = 1.0f / length(vec3{p.x, p.y, p.z});
+    frustum.planes[i] = {{p.x * scale, p.y * scale, p.z * scale}, p.w * scale};
+  }
+  return frustum;
+}
+
+} // namespace hn::math
@@ -0,0 +1,28 @@
+#include "math.h"
+
+namespace hn::math {
+
+mat4 inverse_affine(const mat4 &m) {
+  // Invert the upper 3x3 by its adjugate, then move the translation through it.
+  const vec4 &a = m.columns[0];
+  const vec4 &b = m.columns[1];
+  const vec4 &c = m.columns[2];
+  vec3        r0 = cross({b.x, b.y, b.z}, {c.x, c.y, c.z});
+  vec3        r1 = cross({c.x, c.y, c.z}, {a.x, a.y, a.z});
+  vec3        r2 = cross({a.x, a.y, a.z}, {b.x, b.y, b.z});
+
+  f32 inverse_determinant = 1.0f / dot({a.x, a.y, a.z}, r0);
+  r0                      = r0 * inverse_determinant;
+  r1                      = r1 * inverse_determinant;
+  r2                      = r2 * inverse_determinant;
+
+  // r0, r1 and r2 are the rows of the inverse.
+  const vec4 &t = m.columns[3];
+  vec3        p = {t.x, t.y, t.z};
+  return {{{r0.x, r1.x, r2.x, 0},
+           {r0.y, r1.y, r2.y, 0},
+           {r0.z, r1.z, r2.z, 0},
+           {-dot(r0, p), -dot(r1, p), -dot(r2, p), 1}}};
+}
+
+} // namespace hn::math
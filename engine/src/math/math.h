@@ -0,0 +1,349 @@
+#pragma once
+
+#include "defines.h"
+#include <cmath>
+
+// SIMD backend: SSE on x86-64 unless HN_MATH_SCALAR is defined, with AVX and FMA used where the
+// compiler targets them (see HN_MATH_AVX2 in the engine's CMakeLists). Other architectures use
+// the scalar code, which compilers vectorize well enough.
+#if !defined(HN_MATH_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#define HN_MATH_SSE 1
+#include <immintrin.h>
+#else
+#define HN_MATH_SSE 0
+#endif
+
+#if HN_MATH_SSE && defined(__AVX__)
+#define HN_MATH_AVX 1
+#else
+#define HN_MATH_AVX 0
+#endif
+
+namespace hn::math {
+
+const f32 pi = 3.14159265358979323846f;
+
+struct vec2 {
+  f32 x, y;
+};
+
+struct vec3 {
+  f32 x, y, z;
+};
+
+struct alignas(16) vec4 {
+  f32 x, y, z, w;
+};
+
+// A rotation, x/y/z being the vector part.
+struct alignas(16) quat {
+  f32 x, y, z, w;
+};
+
+// Column-major 4x4 matrix; columns[3] holds the translation.
+struct alignas(16) mat4 {
+  vec4 columns[4];
+};
+
+// vec2
+
+inline vec2 operator+(vec2 a, vec2 b) { return {a.x + b.x, a.y + b.y}; }
+inline vec2 operator-(vec2 a, vec2 b) { return {a.x - b.x, a.y - b.y}; }
+inline vec2 operator*(vec2 a, f32 s) { return {a.x * s, a.y * s}; }
+inline f32  dot(vec2 a, vec2 b) { return a.x * b.x + a.y * b.y; }
+inline f32  length(vec2 v) { return sqrtf(dot(v, v)); }
+
+// vec3
+
+inline vec3 operator+(const vec3 &a, const vec3 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline vec3 operator-(const vec3 &a, const vec3 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline vec3 operator*(const vec3 &a, const vec3 &b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+inline vec3 operator*(const vec3 &a, f32 s) { return {a.x * s, a.y * s, a.z * s}; }
+inline f32  dot(const vec3 &a, const vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline f32  length(const vec3 &v) { return sqrtf(dot(v, v)); }
+
+inline vec3 cross(const vec3 &a, const vec3 &b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+inline vec3 normalize(const vec3 &v) { return v * (1.0f / length(v)); }
+inline vec3 lerp(const vec3 &a, const vec3 &b, f32 t) { return a + (b - a) * t; }
+
+// vec4
+
+#if HN_MATH_SSE
+inline __m128 load(const vec4 &v) { return _mm_load_ps(&v.x); }
+
+inline vec4 store(__m128 m) {
+  vec4 v;
+  _mm_store_ps(&v.x, m);
+  return v;
+}
+
+inline vec4 operator+(const vec4 &a, const vec4 &b) { return store(_mm_add_ps(load(a), load(b))); }
+inline vec4 operator-(const vec4 &a, const vec4 &b) { return store(_mm_sub_ps(load(a), load(b))); }
+inline vec4 operator*(const vec4 &a, const vec4 &b) { return store(_mm_mul_ps(load(a), load(b))); }
+inline vec4 operator*(const vec4 &a, f32 s) { return store(_mm_mul_ps(load(a), _mm_set1_ps(s))); }
+
+inline f32 dot(const vec4 &a, const vec4 &b) {
+  __m128 product = _mm_mul_ps(load(a), load(b));
+  __m128 pairs   = _mm_add_ps(product, _mm_movehl_ps(product, product));
+  return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+#else
+inline vec4 operator+(const vec4 &a, const vec4 &b) {
+  return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+}
+inline vec4 operator-(const vec4 &a, const vec4 &b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+}
+inline vec4 operator*(const vec4 &a, const vec4 &b) {
+  return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w};
+}
+inline vec4 operator*(const vec4 &a, f32 s) { return {a.x * s, a.y * s, a.z * s, a.w * s}; }
+inline f32  dot(const vec4 &a, const vec4 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+#endif
+
+inline f32 length(const vec4 &v) { return sqrtf(dot(v, v)); }
+
+// quat
+
+inline quat quat_identity() { return {0, 0, 0, 1}; }
+
+// Rotation of `angle` radians around a unit axis.
+inline quat quat_from_axis_angle(const vec3 &axis, f32 angle) {
+  f32 s = sinf(angle * 0.5f);
+  return {axis.x * s, axis.y * s, axis.z * s, cosf(angle * 0.5f)};
+}
+
+// The rotation `b` followed by `a`.
+inline quat operator*(const quat &a, const quat &b) {
+  return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+          a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+inline quat conjugate(const quat &q) { return {-q.x, -q.y, -q.z, q.w}; }
+
+inline quat normalize(const quat &q) {
+  vec4 v = {q.x, q.y, q.z, q.w};
+  v      = v * (1.0f / length(v));
+  return {v.x, v.y, v.z, v.w};
+}
+
+// Rotates a vector by a unit quaternion.
+inline vec3 rotate(const quat &q, const vec3 &v) {
+  vec3 u = {q.x, q.y, q.z};
+  vec3 t = cross(u, v) * 2.0f;
+  return v + t * q.w + cross(u, t);
+}
+
+// Normalized linear interpolation along the shorter arc.
+inline quat nlerp(const quat &a, const quat &b, f32 t) {
+  f32 sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0 ? -1.0f : 1.0f;
+  return normalize(quat{a.x + (b.x * sign - a.x) * t, a.y + (b.y * sign - a.y) * t,
+                        a.z + (b.z * sign - a.z) * t, a.w + (b.w * sign - a.w) * t});
+}
+
+// mat4
+
+inline mat4 mat4_identity() { return {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}}}; }
+
+inline mat4 mat4_translation(const vec3 &t) {
+  return {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {t.x, t.y, t.z, 1}}};
+}
+
+inline mat4 mat4_scaling(const vec3 &s) {
+  return {{{s.x, 0, 0, 0}, {0, s.y, 0, 0}, {0, 0, s.z, 0}, {0, 0, 0, 1}}};
+}
+
+// Translation * rotation * scale, the local matrix of a transform.
+#if HN_MATH_SSE
+inline mat4 mat4_compose(const vec3 &t, const quat &r, const vec3 &s) {
+  // The rotation's diagonal, then its off-diagonal sums and differences, shuffled into columns.
+  __m128 q        = _mm_load_ps(&r.x);
+  __m128 q2       = _mm_add_ps(q, q);
+  __m128 squares  = _mm_mul_ps(q, q2);
+  __m128 yy_xx_xx = _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 0, 0, 1));
+  __m128 zz_zz_yy = _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 1, 2, 2));
+  __m128 diagonal = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1), yy_xx_xx), zz_zz_yy);
+  __m128 xz_xy_yz = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 1, 0, 0)),
+                               _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 2, 1, 2)));
+  __m128 wy_wz_wx = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 3, 3)),
+                               _mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 0, 2, 1)));
+  __m128 sums        = _mm_add_ps(xz_xy_yz, wy_wz_wx);
+  __m128 differences = _mm_sub_ps(xz_xy_yz, wy_wz_wx);
+  __m128 middle      = _mm_shuffle_ps(sums, differences, _MM_SHUFFLE(1, 0, 2, 1));
+  __m128 ends        = _mm_shuffle_ps(sums, differences, _MM_SHUFFLE(2, 2, 0, 0));
+  __m128 c0          = _mm_shuffle_ps(diagonal, middle, _MM_SHUFFLE(2, 0, 0, 0));
+  __m128 c1          = _mm_shuffle_ps(diagonal, middle, _MM_SHUFFLE(1, 3, 1, 1));
+  __m128 c2          = _mm_shuffle_ps(ends, diagonal, _MM_SHUFFLE(2, 2, 2, 0));
+  c0                 = _mm_shuffle_ps(c0, c0, _MM_SHUFFLE(1, 3, 2, 0));
+  c1                 = _mm_shuffle_ps(c1, c1, _MM_SHUFFLE(1, 3, 0, 2));
+
+  __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+  mat4   result;
+  _mm_store_ps(&result.columns[0].x, _mm_and_ps(_mm_mul_ps(c0, _mm_set1_ps(s.x)), xyz));
+  _mm_store_ps(&result.columns[1].x, _mm_and_ps(_mm_mul_ps(c1, _mm_set1_ps(s.y)), xyz));
+  _mm_store_ps(&result.columns[2].x, _mm_and_ps(_mm_mul_ps(c2, _mm_set1_ps(s.z)), xyz));
+  _mm_store_ps(&result.columns[3].x, _mm_set_ps(1, t.z, t.y, t.x));
+  return result;
+}
+#else
+inline mat4 mat4_compose(const vec3 &t, const quat &r, const vec3 &s) {
+  f32 xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+  f32 xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+  f32 wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+  return {{{(1 - 2 * (yy + zz)) * s.x, 2 * (xy + wz) * s.x, 2 * (xz - wy) * s.x, 0},
+           {2 * (xy - wz) * s.y, (1 - 2 * (xx + zz)) * s.y, 2 * (yz + wx) * s.y, 0},
+           {2 * (xz + wy) * s.z, 2 * (yz - wx) * s.z, (1 - 2 * (xx + yy)) * s.z, 0},
+           {t.x, t.y, t.z, 1}}};
+}
+#endif
+
+inline mat4 mat4_rotation(const quat &r) { return mat4_compose({0, 0, 0}, r, {1, 1, 1}); }
+
+#if HN_MATH_SSE
+// a * column, as a linear combination of a's columns.
+inline __m128 mul_column(const mat4 &a, __m128 column) {
+  __m128 x  = _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0));
+  __m128 y  = _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1));
+  __m128 z  = _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2));
+  __m128 w  = _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3));
+  __m128 xy = _mm_add_ps(_mm_mul_ps(load(a.columns[0]), x), _mm_mul_ps(load(a.columns[1]), y));
+  __m128 zw = _mm_add_ps(_mm_mul_ps(load(a.columns[2]), z), _mm_mul_ps(load(a.columns[3]), w));
+  return _mm_add_ps(xy, zw);
+}
+
+inline vec4 operator*(const mat4 &a, const vec4 &v) { return store(mul_column(a, load(v))); }
+
+inline mat4 operator*(const mat4 &a, const mat4 &b) {
+  mat4 result;
+#if HN_MATH_AVX
+  // Two columns of b per 256-bit register, each lane multiplying a's columns.
+  __m256 a0 = _mm256_broadcast_ps((const __m128 *)&a.columns[0]);
+  __m256 a1 = _mm256_broadcast_ps((const __m128 *)&a.columns[1]);
+  __m256 a2 = _mm256_broadcast_ps((const __m128 *)&a.columns[2]);
+  __m256 a3 = _mm256_broadcast_ps((const __m128 *)&a.columns[3]);
+  for (u32 i = 0; i < 4; i += 2) {
+    __m256 c = _mm256_loadu_ps(&b.columns[i].x);
+    __m256 r = _mm256_mul_ps(a0, _mm256_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)));
+#if defined(__FMA__)
+    r = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)), r);
+    r = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2)), r);
+    r = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3)), r);
+#else
+    r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))));
+    r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))));
+    r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3))));
+#endif
+    _mm256_storeu_ps(&result.columns[i].x, r);
+  }
+#else
+  for (u32 i = 0; i < 4; ++i) {
+    _mm_store_ps(&result.columns[i].x, mul_column(a, load(b.columns[i])));
+  }
+#endif
+  return result;
+}
+#else
+inline vec4 operator*(const mat4 &a, const vec4 &v) {
+  return a.columns[0] * v.x + a.columns[1] * v.y + a.columns[2] * v.z + a.columns[3] * v.w;
+}
+
+inline mat4 operator*(const mat4 &a, const mat4 &b) {
+  mat4 result;
+  for (u32 i = 0; i < 4; ++i) {
+    result.columns[i] = a * b.columns[i];
+  }
+  return result;
+}
+#endif
+
+#if HN_MATH_SSE
+// The rotation and scale part of an affine a times column.
+inline __m128 mul_affine_column(__m128 a0, __m128 a1, __m128 a2, __m128 column) {
+  __m128 x = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+  __m128 y = _mm_mul_ps(a1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1)));
+  __m128 z = _mm_mul_ps(a2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2)));
+  return _mm_add_ps(_mm_add_ps(x, y), z);
+}
+#endif
+
+// a * b for affine matrices (bottom row 0, 0, 0, 1), skipping the terms that row makes constant.
+inline mat4 mul_affine(const mat4 &a, const mat4 &b) {
+#if HN_MATH_SSE
+  // Unrolled so that b, often just composed, stays in registers.
+  __m128 a0 = load(a.columns[0]);
+  __m128 a1 = load(a.columns[1]);
+  __m128 a2 = load(a.columns[2]);
+  __m128 t  = mul_affine_column(a0, a1, a2, load(b.columns[3]));
+  mat4   result;
+  _mm_store_ps(&result.columns[0].x, mul_affine_column(a0, a1, a2, load(b.columns[0])));
+  _mm_store_ps(&result.columns[1].x, mul_affine_column(a0, a1, a2, load(b.columns[1])));
+  _mm_store_ps(&result.columns[2].x, mul_affine_column(a0, a1, a2, load(b.columns[2])));
+  _mm_store_ps(&result.columns[3].x, _mm_add_ps(t, load(a.columns[3])));
+  return result;
+#else
+  mat4 result;
+  for (u32 i = 0; i < 4; ++i) {
+    const vec4 &c     = b.columns[i];
+    result.columns[i] = a.columns[0] * c.x + a.columns[1] * c.y + a.columns[2] * c.z;
+  }
+  result.columns[3] = result.columns[3] + a.columns[3];
+  return result;
+#endif
+}
+
+inline vec3 transform_point(const mat4 &m, const vec3 &p) {
+  vec4 r = m * vec4{p.x, p.y, p.z, 1};
+  return {r.x, r.y, r.z};
+}
+
+inline vec3 transform_direction(const mat4 &m, const vec3 &d) {
+  vec4 r = m * vec4{d.x, d.y, d.z, 0};
+  return {r.x, r.y, r.z};
+}
+
+inline mat4 transpose(const mat4 &m) {
+  mat4 r;
+  const f32 *a = &m.columns[0].x;
+  f32       *b = &r.columns[0].x;
+  for (u32 i = 0; i < 4; ++i) {
+    for (u32 j = 0; j < 4; ++j) {
+      b[i * 4 + j] = a[j * 4 + i];
+    }
+  }
+  return r;
+}
+
+// Right-handed view matrix looking from `eye` towards `target`.
+inline mat4 mat4_look_at(const vec3 &eye, const vec3 &target, const vec3 &up) {
+  vec3 f = normalize(target - eye);
+  vec3 s = normalize(cross(f, up));
+  vec3 u = cross(s, f);
+  return {{{s.x, u.x, -f.x, 0},
+           {s.y, u.y, -f.y, 0},
+           {s.z, u.z, -f.z, 0},
+           {-dot(s, eye), -dot(u, eye), dot(f, eye), 1}}};
+}
+
+// Right-handed perspective projection looking down -z, mapping depth to [0, 1].
+inline mat4 mat4_perspective(f32 fov_y, f32 aspect, f32 z_near, f32 z_far) {
+  f32 f = 1.0f / tanf(fov_y * 0.5f);
+  return {{{f / aspect, 0, 0, 0},
+           {0, f, 0, 0},
+           {0, 0, z_far / (z_near - z_far), -1},
+           {0, 0, z_near * z_far / (z_near - z_far), 0}}};
+}
+
+/**
+ * Inverts an affine matrix (bottom row 0, 0, 0, 1), such as any composition of translations,
+ * rotations and non-zero scales.
+ */
+mat4 inverse_affine(const mat4 &m);
+
+} // namespace hn::math
@@ -0,0 +1,90 @@
+#include "transform.h"
+#include "core/memory.h"
+#include "core/profile.h"
+
+namespace hn::math {
+
+void compose_transforms(const vec3 *positions, const quat *rotations, const vec3 *scales,
+                        u32 count, mat4 *out_local) {
+  for (u32 i = 0; i < count; ++i) {
+    out_local[i] = mat4_compose(positions[i], rotations[i], scales[i]);
+  }
+}
+
+void propagate_transforms(const mat4 *local, const u32 *parents, u32 count, mat4 *out_world) {
+  for (u32 i = 0; i < count; ++i) {
+    u32 parent   = parents[i];
+    out_world[i] = parent == no_parent ? local[i] : mul_affine(out_world[parent], local[i]);
+  }
+}
+
+void update_transforms(const vec3 *positions, const quat *rotations, const vec3 *scales,
+                       const u32 *parents, u32 count, mat4 *out_world) {
+  for (u32 i = 0; i < count; ++i) {
+    mat4 local   = mat4_compose(positions[i], rotations[i], scales[i]);
+    u32  parent  = parents[i];
+    out_world[i] = parent == no_parent ? local : mul_affine(out_world[parent], local);
+  }
+}
+
+bool transform_hierarchy_create(TransformHierarchy &out_hierarchy, u32 capacity) {
+  TransformHierarchy &h = out_hierarchy;
+  h.positions = (vec3 *)mem::allocate(capacity * sizeof(vec3), mem::TagTransform);
+  h.rotations = (quat *)mem::allocate_aligned(capacity * sizeof(quat), alignof(quat),
+                                              mem::TagTransform);
+  h.scales    = (vec3 *)mem::allocate(capacity * sizeof(vec3), mem::TagTransform);
+  h.parents   = (u32 *)mem::allocate(capacity * sizeof(u32), mem::TagTransform);
+  h.world     = (mat4 *)mem::allocate_aligned(capacity * sizeof(mat4), alignof(mat4),
+                                              mem::TagTransform);
+  h.count     = 0;
+  h.capacity  = capacity;
+  if (!h.positions || !h.rotations || !h.scales || !h.parents || !h.world) {
+    transform_hierarchy_destroy(h);
+    return false;
+  }
+  return true;
+}
+
+void transform_hierarchy_destroy(TransformHierarchy &hierarchy) {
+  TransformHierarchy &h = hierarchy;
+  u32                 n = h.capacity;
+  if (h.positions) {
+    mem::free(h.positions, n * sizeof(vec3), mem::TagTransform);
+  }
+  if (h.rotations) {
+    mem::free_aligned(h.rotations, n * sizeof(quat), alignof(quat), mem::TagTransform);
+  }
+  if (h.scales) {
+    mem::free(h.scales, n * sizeof(vec3), mem::TagTransform);
+  }
+  if (h.parents) {
+    mem::free(h.parents, n * sizeof(u32), mem::TagTransform);
+  }
+  if (h.world) {
+    mem::free_aligned(h.world, n * sizeof(mat4), alignof(mat4), mem::TagTransform);
+  }
+  h = {};
+}
+
+u32 transform_hierarchy_add(TransformHierarchy &hierarchy, u32 parent, const vec3 &position,
+                            const quat &rotation, const vec3 &scale) {
+  if (hierarchy.count == hierarchy.capacity ||
+      (parent != no_parent && parent >= hierarchy.count)) {
+    return no_parent;
+  }
+  u32 index                  = hierarchy.count++;
+  hierarchy.positions[index] = position;
+  hierarchy.rotations[index] = rotation;
+  hierarchy.scales[index]    = scale;
+  hierarchy.parents[index]   = parent;
+  hierarchy.world[index]     = mat4_identity();
+  return index;
+}
+
+void transform_hierarchy_update(TransformHierarchy &hierarchy) {
+  HN_PROFILE_FUNCTION();
+  update_transforms(hierarchy.positions, hierarchy.rotations, hierarchy.scales, hierarchy.parents,
+                    hierarchy.count, hierarchy.world);
+}
+
+} // namespace hn::math
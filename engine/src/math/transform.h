@@ -0,0 +1,53 @@
+#pragma once
+
+#include "math.h"
+
+namespace hn::math {
+
+// Batched transform kernels. Transforms are stored in hierarchy order, as parallel arrays: every
+// parent precedes its children, so world matrices can be computed in a single forward pass with
+// each parent's world matrix already final when its children need it.
+
+// Marks a root in a parent array.
+const u32 no_parent = 0xffffffff;
+
+// Local matrices from positions, rotations and scales.
+void compose_transforms(const vec3 *positions, const quat *rotations, const vec3 *scales,
+                        u32 count, mat4 *out_local);
+
+/**
+ * World matrices from local ones.
+ * @param parents For each transform its parent's index, lower than its own, or no_parent.
+ */
+void propagate_transforms(const mat4 *local, const u32 *parents, u32 count, mat4 *out_world);
+
+// compose_transforms and propagate_transforms fused into one pass, without the local matrices.
+void update_transforms(const vec3 *positions, const quat *rotations, const vec3 *scales,
+                       const u32 *parents, u32 count, mat4 *out_world);
+
+// A transform hierarchy of fixed capacity, its arrays allocated under TagTransform.
+struct TransformHierarchy {
+  vec3 *positions = nullptr;
+  quat *rotations = nullptr;
+  vec3 *scales    = nullptr;
+  u32  *parents   = nullptr;
+  mat4 *world     = nullptr; // As of the last transform_hierarchy_update.
+  u32   count     = 0;
+  u32   capacity  = 0;
+};
+
+bool transform_hierarchy_create(TransformHierarchy &out_hierarchy, u32 capacity);
+void transform_hierarchy_destroy(TransformHierarchy &hierarchy);
+
+/**
+ * Appends a transform, which keeps the hierarchy order as parents must already exist.
+ * @param parent The parent's index, or no_parent for a root.
+ * @returns The transform's index, or no_parent if the hierarchy is full or the parent unknown.
+ */
+u32 transform_hierarchy_add(TransformHierarchy &hierarchy, u32 parent, const vec3 &position,
+                            const quat &rotation = quat_identity(), const vec3 &scale = {1, 1, 1});
+
+// Recomputes every world matrix.
+void transform_hierarchy_update(TransformHierarchy &hierarchy);
+
+} // namespace hn::math
@@ -5,8 +5,9 @@
 namespace hn::platform {
 
 struct State {
-  void *pState = nullptr; // internal state
-  bool  quit   = false;
+  void *pState   = nullptr; // internal state
+  bool  quit     = false;
+  bool  headless = false; // no window system; poll_events only reports quit requests
 };
 
 bool initialize(State *state, const char *application_name, i32 x, i32 y, u32 width, u32 height);
@@ -14,8 +15,12 @@ void terminate(State *state);
 
 bool poll_events(State *state);
 
-void *allocate(u64 size, bool aligned = false);
-void  free(void *block, bool aligned = false);
+// Alignment must be zero (malloc's natural alignment) or a power of two.
+void *allocate(u64 size, u64 alignment = 0);
+void  free(void *block, u64 alignment = 0);
+// Grows or shrinks a block from `allocate`, in place when the allocator can. The contents up to the
+// smaller of both sizes are preserved; anything beyond is uninitialized.
+void *reallocate(void *block, u64 old_size, u64 new_size, u64 alignment = 0);
 void *memory_zero(void *block, u64 size);
 void *memory_copy(void *dst, const void *src, u64 size);
 void *memory_set(void *dst, i32 value, u64 size);
@@ -24,7 +29,117 @@ void console_write(const char *message, u8 color);
 void console_write_error(const char *message, u8 color);
 
 f64 get_system_time();
+// Monotonic timestamp in nanoseconds, for profiling.
+u64 get_timestamp_ns();
+
+/**
+ * Captures the calling thread's return addresses, innermost first.
+ * @param frames Receives the addresses.
+ * @param max_frames The capacity of `frames`.
+ * @param skip Frames to leave out above the caller of this function.
+ * @returns The number of addresses captured.
+ */
+u32 capture_stack_trace(void **frames, u32 max_frames, u32 skip);
+
+/**
+ * Describes a code address as `symbol+offset (module)`, or `module+offset` when the symbol is not
+ * exported, for reports. Slow; may allocate outside of hn::mem.
+ * @returns False if the address is not in any loaded module.
+ */
+bool describe_address(void *address, char *out, u64 size);
+
+// A read-only view of a whole file.
+struct MappedFile {
+  const u8 *data = nullptr;
+  u64       size = 0;
+};
+
+/**
+ * Maps a file into memory, read-only. Pages are loaded on first access.
+ * @param path The file to map.
+ * @param out_file Receives the view; an empty file maps to a null view of size 0.
+ * @returns True on success; otherwise false.
+ */
+bool map_file(const char *path, MappedFile &out_file);
+void unmap_file(MappedFile &file);
+
+// A file opened for reading.
+struct File {
+  i64 handle = -1; // OS descriptor; -1 when closed.
+  u64 size   = 0;  // Size when opened.
+};
+
+/**
+ * Opens a file for reading.
+ * @param path The file to open.
+ * @param out_file Receives the file.
+ * @returns True on success; otherwise false.
+ */
+bool open_file(const char *path, File &out_file);
+void close_file(File &file);
+
+/**
+ * Reads from an offset without moving a file cursor, so threads may read one File concurrently.
+ * Blocks until done.
+ * @returns The number of bytes read, short only at the end of the file; or -1 on error.
+ */
+i64 read_file(const File &file, u64 offset, void *buffer, u64 size);
+
+// Asks the OS to drop the file's cached pages, so the next read comes from the device; for
+// measuring cold loads. Best effort.
+void evict_file_cache(const File &file);
+
+// A read for an AsyncReader.
+struct AsyncRead {
+  File  file;
+  u64   offset;
+  void *buffer;
+  u64   size;
+  u64   user_data; // Handed back with the result.
+};
+
+struct AsyncReadResult {
+  u64 user_data;
+  i64 result; // As read_file: bytes read, or -1 on error.
+};
+
+// Reads files without blocking the thread that queues them: io_uring on Linux where the kernel
+// allows it; elsewhere each read runs synchronously when submitted. One thread at a time.
+struct AsyncReader {
+  void *pState = nullptr; // internal state
+  u32   depth  = 0;       // Reads in flight at once.
+  bool  native = false;   // False if reads are emulated with read_file.
+};
+
+/**
+ * @param depth The number of reads that can be in flight at once.
+ * @param allow_native False to emulate even where the OS offers asynchronous reads.
+ * @returns True on success; otherwise false.
+ */
+bool async_reader_create(AsyncReader &out_reader, u32 depth, bool allow_native = true);
+void async_reader_destroy(AsyncReader &reader);
+
+/**
+ * Queues a read; nothing happens before async_reader_submit. Reads may come back short, and
+ * reads beyond 1 GiB always do; queue the rest again.
+ * @returns False if `depth` reads are queued or in flight already.
+ */
+bool async_read(AsyncReader &reader, const AsyncRead &read);
+
+// Starts the reads queued since the last submit.
+void async_reader_submit(AsyncReader &reader);
+
+/**
+ * Collects finished reads.
+ * @param out_results Receives up to `max_results` results.
+ * @param wait True to block until at least one read has finished, unless none is in flight.
+ * @returns The number of results written.
+ */
+u32 async_reader_complete(AsyncReader &reader, AsyncReadResult *out_results, u32 max_results,
+                          bool wait);
 
 void sleep(u64 ms);
+// Sleeps with sub-millisecond resolution where the OS allows; may oversleep by scheduler slack.
+void sleep_us(u64 us);
 
 } // namespace hn::platform
@@ -0,0 +1,473 @@
+#include "core/log.h"
+#include "core/profile.h"
+#include "platform.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include <algorithm>
+#include <cerrno>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <cstddef>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Set from the signal handler so that a headless run can be stopped with Ctrl-C.
+static volatile sig_atomic_t quit_requested = 0;
+
+static void on_signal([[maybe_unused]] int signal) { quit_requested = 1; }
+
+namespace hn::platform {
+
+bool initialize(State *state, const char *application_name, i32 x, i32 y, u32 width, u32 height) {
+  if (!state->headless) {
+    HN_warn("No window system backend on Linux yet, running '%s' headless.", application_name);
+    state->headless = true;
+  }
+  state->pState  = nullptr;
+  quit_requested = 0;
+
+  struct sigaction action {};
+  action.sa_handler = on_signal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  return true;
+}
+
+void terminate(State *state) {
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  state->pState = nullptr;
+}
+
+bool poll_events(State *state) {
+  HN_PROFILE_SCOPE("platform::poll_events");
+  // Headless: there is no window system to pump, only external quit requests.
+  if (quit_requested) {
+    state->quit = true;
+  }
+  return !state->quit;
+}
+
+void *allocate(u64 size, u64 alignment) {
+  if (alignment <= alignof(max_align_t)) {
+    return malloc(size);
+  }
+  void *block = nullptr;
+  if (posix_memalign(&block, alignment, size) != 0) {
+    return nullptr;
+  }
+  return block;
+}
+
+// posix_memalign blocks are released with free() as well.
+void free(void *block, [[maybe_unused]] u64 alignment) { ::free(block); }
+
+void *reallocate(void *block, u64 old_size, u64 new_size, u64 alignment) {
+  if (alignment <= alignof(max_align_t)) {
+    // glibc serves large blocks with mmap and grows them with mremap, without copying.
+    return realloc(block, new_size);
+  }
+
+  // There is no aligned realloc; move the contents by hand.
+  void *moved = allocate(new_size, alignment);
+  if (moved) {
+    memcpy(moved, block, old_size < new_size ? old_size : new_size);
+    ::free(block);
+  }
+  return moved;
+}
+
+void *memory_zero(void *block, u64 size) { return memset(block, 0, size); }
+
+void *memory_copy(void *dst, const void *src, u64 size) { return memcpy(dst, src, size); }
+
+void *memory_set(void *dst, i32 value, u64 size) { return memset(dst, value, size); }
+
+// Colours: Fatal, Error, Warn, Info, Debug, Trace.
+static const char *color_strings[] = {"0;41", "1;31", "1;33", "1;32", "1;34", "1;30"};
+
+void console_write(const char *message, u8 color) {
+  fprintf(stdout, "\033[%sm%s\033[0m", color_strings[color % 6], message);
+}
+
+void console_write_error(const char *message, u8 color) {
+  fprintf(stderr, "\033[%sm%s\033[0m", color_strings[color % 6], message);
+}
+
+f64 get_system_time() {
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (f64)now.tv_sec + (f64)now.tv_nsec * 0.000000001;
+}
+
+u64 get_timestamp_ns() {
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (u64)now.tv_sec * 1000000000 + (u64)now.tv_nsec;
+}
+
+u32 capture_stack_trace(void **frames, u32 max_frames, u32 skip) {
+  void *buffer[64];
+  u32   wanted = max_frames + skip + 1 < 64 ? max_frames + skip + 1 : 64;
+  i32   count  = backtrace(buffer, (i32)wanted);
+  u32   first  = skip + 1; // This function's own frame too.
+  u32   copied = 0;
+  for (u32 i = first; i < (u32)count && copied < max_frames; ++i) {
+    frames[copied++] = buffer[i];
+  }
+  return copied;
+}
+
+bool describe_address(void *address, char *out, u64 size) {
+  Dl_info info{};
+  if (!dladdr(address, &info) || !info.dli_fname) {
+    return false;
+  }
+  const char *module = strrchr(info.dli_fname, '/');
+  module             = module ? module + 1 : info.dli_fname;
+  if (info.dli_sname) {
+    char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, nullptr);
+    snprintf(out, size, "%s+0x%llx (%s)", demangled ? demangled : info.dli_sname,
+             (u64)((u8 *)address - (u8 *)info.dli_saddr), module);
+    ::free(demangled);
+  } else {
+    snprintf(out, size, "%s+0x%llx", module, (u64)((u8 *)address - (u8 *)info.dli_fbase));
+  }
+  return true;
+}
+
+bool map_file(const char *path, MappedFile &out_file) {
+  out_file = {};
+  int fd   = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat info{};
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    return false;
+  }
+  if (info.st_size > 0) {
+    void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    out_file.data = (const u8 *)data;
+    out_file.size = (u64)info.st_size;
+  }
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  return true;
+}
+
+void unmap_file(MappedFile &file) {
+  if (file.data) {
+    munmap((void *)file.data, file.size);
+  }
+  file = {};
+}
+
+bool open_file(const char *path, File &out_file) {
+  out_file = {};
+  int fd   = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat info{};
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    return false;
+  }
+  out_file.handle = fd;
+  out_file.size   = (u64)info.st_size;
+  return true;
+}
+
+void close_file(File &file) {
+  if (file.handle != -1) {
+    close((int)file.handle);
+  }
+  file = {};
+}
+
+i64 read_file(const File &file, u64 offset, void *buffer, u64 size) {
+  u64 done = 0;
+  while (done < size) {
+    ssize_t result =
+        pread((int)file.handle, (u8 *)buffer + done, size - done, (off_t)(offset + done));
+    if (result == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (result == 0) {
+      break;
+    }
+    done += (u64)result;
+  }
+  return (i64)done;
+}
+
+void evict_file_cache(const File &file) {
+  posix_fadvise((int)file.handle, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+// io_uring takes 32-bit lengths; longer reads come back short.
+const u64 max_async_read = 1ull << 30;
+
+struct AsyncReaderState {
+  u32 queued    = 0; // Since the last submit.
+  u32 in_flight = 0; // Queued, submitted or finished but not collected.
+
+  // io_uring, when native: the submission and completion rings shared with the kernel.
+  int           ring         = -1;
+  u8           *sq_ring      = nullptr;
+  u64           sq_ring_size = 0;
+  u8           *cq_ring      = nullptr;
+  u64           cq_ring_size = 0;
+  io_uring_sqe *sqes         = nullptr;
+  u64           sqes_size    = 0;
+  u32          *sq_head      = nullptr;
+  u32          *sq_tail      = nullptr;
+  u32          *sq_mask      = nullptr;
+  u32          *sq_array     = nullptr;
+  u32          *cq_head      = nullptr;
+  u32          *cq_tail      = nullptr;
+  u32          *cq_mask      = nullptr;
+  io_uring_cqe *cqes         = nullptr;
+
+  // Emulation: reads wait in `reads` until submitted, then results wait in `results`. Natively,
+  // `results` holds the failures of reads the kernel refused to take.
+  AsyncRead       *reads        = nullptr;
+  AsyncReadResult *results      = nullptr;
+  u32              result_count = 0;
+};
+
+static void close_ring(AsyncReaderState &state) {
+  if (state.sqes) {
+    munmap(state.sqes, state.sqes_size);
+  }
+  if (state.cq_ring && state.cq_ring != state.sq_ring) {
+    munmap(state.cq_ring, state.cq_ring_size);
+  }
+  if (state.sq_ring) {
+    munmap(state.sq_ring, state.sq_ring_size);
+  }
+  if (state.ring != -1) {
+    close(state.ring);
+  }
+  state.ring    = -1;
+  state.sq_ring = state.cq_ring = nullptr;
+  state.sqes    = nullptr;
+}
+
+// Sets up io_uring without liburing: the raw system calls, and the rings mapped by hand.
+static bool open_ring(AsyncReaderState &state, u32 depth) {
+  io_uring_params params{};
+  int             ring = (int)syscall(__NR_io_uring_setup, depth, &params);
+  if (ring == -1) {
+    // Old kernels, and sandboxes that filter io_uring out.
+    return false;
+  }
+  state.ring         = ring;
+  state.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+  state.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap   = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    state.sq_ring_size = state.cq_ring_size = std::max(state.sq_ring_size, state.cq_ring_size);
+  }
+  void *sq_ring = mmap(nullptr, state.sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) {
+    close_ring(state);
+    return false;
+  }
+  state.sq_ring = (u8 *)sq_ring;
+  if (single_mmap) {
+    state.cq_ring = state.sq_ring;
+  } else {
+    void *cq_ring = mmap(nullptr, state.cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+      close_ring(state);
+      return false;
+    }
+    state.cq_ring = (u8 *)cq_ring;
+  }
+  state.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes      = mmap(nullptr, state.sqes_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    close_ring(state);
+    return false;
+  }
+  state.sqes     = (io_uring_sqe *)sqes;
+  state.sq_head  = (u32 *)(state.sq_ring + params.sq_off.head);
+  state.sq_tail  = (u32 *)(state.sq_ring + params.sq_off.tail);
+  state.sq_mask  = (u32 *)(state.sq_ring + params.sq_off.ring_mask);
+  state.sq_array = (u32 *)(state.sq_ring + params.sq_off.array);
+  state.cq_head  = (u32 *)(state.cq_ring + params.cq_off.head);
+  state.cq_tail  = (u32 *)(state.cq_ring + params.cq_off.tail);
+  state.cq_mask  = (u32 *)(state.cq_ring + params.cq_off.ring_mask);
+  state.cqes     = (io_uring_cqe *)(state.cq_ring + params.cq_off.cqes);
+  return true;
+}
+
+bool async_reader_create(AsyncReader &out_reader, u32 depth, bool allow_native) {
+  out_reader = {};
+  if (depth == 0) {
+    return false;
+  }
+  auto state = new AsyncReaderState();
+  if (allow_native && open_ring(*state, depth)) {
+    out_reader.native = true;
+  } else {
+    state->reads = new AsyncRead[depth];
+  }
+  state->results = new AsyncReadResult[depth];
+  out_reader.pState = state;
+  out_reader.depth  = depth;
+  return true;
+}
+
+void async_reader_destroy(AsyncReader &reader) {
+  auto state = (AsyncReaderState *)reader.pState;
+  if (!state) {
+    return;
+  }
+  // Closing the ring cancels whatever is still in flight.
+  close_ring(*state);
+  delete[] state->reads;
+  delete[] state->results;
+  delete state;
+  reader = {};
+}
+
+bool async_read(AsyncReader &reader, const AsyncRead &read) {
+  auto state = (AsyncReaderState *)reader.pState;
+  if (state->in_flight == reader.depth) {
+    return false;
+  }
+  if (reader.native) {
+    u32           tail  = *state->sq_tail + state->queued;
+    u32           index = tail & *state->sq_mask;
+    io_uring_sqe &sqe   = state->sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode             = IORING_OP_READ;
+    sqe.fd                 = (i32)read.file.handle;
+    sqe.off                = read.offset;
+    sqe.addr               = (u64)read.buffer;
+    sqe.len                = (u32)std::min(read.size, max_async_read);
+    sqe.user_data          = read.user_data;
+    state->sq_array[index] = index;
+  } else {
+    state->reads[state->queued] = read;
+  }
+  state->queued++;
+  state->in_flight++;
+  return true;
+}
+
+void async_reader_submit(AsyncReader &reader) {
+  auto state = (AsyncReaderState *)reader.pState;
+  if (state->queued == 0) {
+    return;
+  }
+  if (!reader.native) {
+    for (u32 i = 0; i < state->queued; ++i) {
+      const AsyncRead &read = state->reads[i];
+      state->results[state->result_count++] = {
+          read.user_data, read_file(read.file, read.offset, read.buffer, read.size)};
+    }
+    state->queued = 0;
+    return;
+  }
+  // Publish the entries, then hand them to the kernel.
+  __atomic_store_n(state->sq_tail, *state->sq_tail + state->queued, __ATOMIC_RELEASE);
+  u32 remaining = state->queued;
+  while (remaining > 0) {
+    int submitted = (int)syscall(__NR_io_uring_enter, state->ring, remaining, 0, 0, nullptr, 0);
+    if (submitted == -1) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        continue;
+      }
+      HN_error("io_uring_enter failed to submit %u reads: %s.", remaining, strerror(errno));
+      break;
+    }
+    remaining -= (u32)submitted;
+  }
+  if (remaining > 0) {
+    // Take back what the kernel did not consume, so it never reads into buffers handed back as
+    // failed, and so nobody waits for completions that will not come.
+    u32 head = __atomic_load_n(state->sq_head, __ATOMIC_ACQUIRE);
+    u32 tail = *state->sq_tail;
+    for (u32 position = head; position != tail; ++position) {
+      const io_uring_sqe &sqe = state->sqes[state->sq_array[position & *state->sq_mask]];
+      state->results[state->result_count++] = {sqe.user_data, -1};
+    }
+    __atomic_store_n(state->sq_tail, head, __ATOMIC_RELEASE);
+  }
+  state->queued = 0;
+}
+
+// Hands out the results kept in `results`, oldest first.
+static u32 take_results(AsyncReaderState &state, AsyncReadResult *out_results, u32 max_results) {
+  u32 count = std::min(state.result_count, max_results);
+  memcpy(out_results, state.results, count * sizeof(AsyncReadResult));
+  memmove(state.results, state.results + count,
+          (state.result_count - count) * sizeof(AsyncReadResult));
+  state.result_count -= count;
+  state.in_flight -= count;
+  return count;
+}
+
+u32 async_reader_complete(AsyncReader &reader, AsyncReadResult *out_results, u32 max_results,
+                          bool wait) {
+  auto state = (AsyncReaderState *)reader.pState;
+  u32  count = take_results(*state, out_results, max_results);
+  if (!reader.native || count > 0) {
+    return count;
+  }
+
+  while (true) {
+    u32 head = *state->cq_head;
+    u32 tail = __atomic_load_n(state->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail && count < max_results; ++head) {
+      const io_uring_cqe &cqe = state->cqes[head & *state->cq_mask];
+      out_results[count++]    = {cqe.user_data, cqe.res < 0 ? -1 : (i64)cqe.res};
+    }
+    __atomic_store_n(state->cq_head, head, __ATOMIC_RELEASE);
+    state->in_flight -= count;
+    if (count > 0 || !wait || state->in_flight == state->queued) {
+      return count;
+    }
+    syscall(__NR_io_uring_enter, state->ring, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+  }
+}
+
+void sleep(u64 ms) { sleep_us(ms * 1000); }
+
+void sleep_us(u64 us) {
+  timespec remaining{(time_t)(us / 1000000), (long)((us % 1000000) * 1000)};
+  while (nanosleep(&remaining, &remaining) == -1 && errno == EINTR) {
+  }
+}
+
+} // namespace hn::platform
+
+#endif
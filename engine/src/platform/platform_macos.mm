@@ -1,11 +1,22 @@
 #include "core/input.h"
 #include "core/log.h"
+#include "core/profile.h"
 #include "platform.h"
 
 #if defined(PLATFORM_APPLE)
 
 #import <Cocoa/Cocoa.h>
 #import <QuartzCore/QuartzCore.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 @class AppDelegate;
 @class WindowDelegate;
@@ -13,6 +24,9 @@
 
 hn::input::Key translate_key_code(u32 key_code);
 
+// NSEvent timestamps count seconds since boot, the CLOCK_UPTIME_RAW base of get_timestamp_ns.
+static u64 event_timestamp(NSEvent *event) { return (u64)(event.timestamp * 1000000000.0); }
+
 struct InternalState {
   AppDelegate    *appDelegate = nullptr;
   WindowDelegate *wndDelegate = nullptr;
@@ -67,45 +81,46 @@ struct InternalState {
 
 - (void)keyDown:(NSEvent *)event {
   auto key = translate_key_code(event.keyCode);
-  hn::input::process_key(key, YES);
+  hn::input::queue_key(key, YES, event_timestamp(event));
 }
 
 - (void)keyUp:(NSEvent *)event {
   auto key = translate_key_code(event.keyCode);
-  hn::input::process_key(key, NO);
+  hn::input::queue_key(key, NO, event_timestamp(event));
 }
 
 - (void)mouseDown:(NSEvent *)event {
-  hn::input::process_button(hn::input::ButtonLeft, true);
+  hn::input::queue_button(hn::input::ButtonLeft, true, event_timestamp(event));
 }
 
 - (void)mouseUp:(NSEvent *)event {
-  hn::input::process_button(hn::input::ButtonLeft, false);
+  hn::input::queue_button(hn::input::ButtonLeft, false, event_timestamp(event));
 }
 
 - (void)rightMouseDown:(NSEvent *)event {
-  hn::input::process_button(hn::input::ButtonRight, true);
+  hn::input::queue_button(hn::input::ButtonRight, true, event_timestamp(event));
 }
 
 - (void)rightMouseUp:(NSEvent *)event {
-  hn::input::process_button(hn::input::ButtonRight, false);
+  hn::input::queue_button(hn::input::ButtonRight, false, event_timestamp(event));
 }
 
 - (void)otherMouseDown:(NSEvent *)event {
-  hn::input::process_button(hn::input::ButtonMiddle, true);
+  hn::input::queue_button(hn::input::ButtonMiddle, true, event_timestamp(event));
 }
 
 - (void)otherMouseUp:(NSEvent *)event {
-  hn::input::process_button(hn::input::ButtonMiddle, false);
+  hn::input::queue_button(hn::input::ButtonMiddle, false, event_timestamp(event));
 }
 
 - (void)mouseMoved:(NSEvent *)event {
   const auto &loc = event.locationInWindow;
-  hn::input::process_mouse_move((f32)loc.x, (f32)loc.y);
+  hn::input::queue_mouse_move((f32)loc.x, (f32)loc.y, event_timestamp(event));
 }
 
 - (void)scrollWheel:(NSEvent *)event {
-  hn::input::process_mouse_wheel((f32)event.scrollingDeltaX, (f32)event.scrollingDeltaY);
+  hn::input::queue_mouse_wheel((f32)event.scrollingDeltaX, (f32)event.scrollingDeltaY,
+                               event_timestamp(event));
 }
 
 @end
@@ -143,6 +158,11 @@ struct InternalState {
 namespace hn::platform {
 
 bool initialize(State *state, const char *application_name, i32 x, i32 y, u32 width, u32 height) {
+  if (state->headless) {
+    state->pState = nullptr;
+    return true;
+  }
+
   auto s        = new InternalState();
   state->pState = s;
 
@@ -192,6 +212,10 @@ bool initialize(State *state, const char *application_name, i32 x, i32 y, u32 wi
 }
 
 void terminate(State *state) {
+  if (state->headless) {
+    return;
+  }
+
   @autoreleasepool {
     auto pState = (InternalState *)state->pState;
 
@@ -211,6 +235,11 @@ void terminate(State *state) {
 }
 
 bool poll_events(State *state) {
+  HN_PROFILE_SCOPE("platform::poll_events");
+  if (state->headless) {
+    return !state->quit;
+  }
+
   @autoreleasepool {
     while (YES) {
       NSEvent *event = [NSApp nextEventMatchingMask:NSEventMaskAny
@@ -226,11 +255,33 @@ bool poll_events(State *state) {
   }
 }
 
-void *allocate(u64 size, bool aligned) { return malloc(size); }
+void *allocate(u64 size, u64 alignment) {
+  if (alignment <= alignof(max_align_t)) {
+    return malloc(size);
+  }
+  void *block = nullptr;
+  if (posix_memalign(&block, alignment, size) != 0) {
+    return nullptr;
+  }
+  return block;
+}
+
+// posix_memalign blocks are released with free() as well.
+void free(void *block, [[maybe_unused]] u64 alignment) { ::free(block); }
+
+void *reallocate(void *block, u64 old_size, u64 new_size, u64 alignment) {
+  if (alignment <= alignof(max_align_t)) {
+    // Grows in place when the zone has room after the block.
+    return realloc(block, new_size);
+  }
 
-void free(void *block, bool aligned) {
-  ::free(block);
-  block = nullptr;
+  // There is no aligned realloc; move the contents by hand.
+  void *moved = allocate(new_size, alignment);
+  if (moved) {
+    memcpy(moved, block, old_size < new_size ? old_size : new_size);
+    ::free(block);
+  }
+  return moved;
 }
 
 void *memory_zero(void *block, u64 size) { return memset(block, 0, size); }
@@ -241,7 +292,185 @@ void *memory_set(void *dst, i32 value, u64 size) { return memset(dst, value, siz
 
 f64 get_system_time() { return CACurrentMediaTime(); }
 
-void sleep(u64 ms) {}
+u64 get_timestamp_ns() { return clock_gettime_nsec_np(CLOCK_UPTIME_RAW); }
+
+u32 capture_stack_trace(void **frames, u32 max_frames, u32 skip) {
+  void *buffer[64];
+  u32   wanted = max_frames + skip + 1 < 64 ? max_frames + skip + 1 : 64;
+  i32   count  = backtrace(buffer, (i32)wanted);
+  u32   first  = skip + 1; // This function's own frame too.
+  u32   copied = 0;
+  for (u32 i = first; i < (u32)count && copied < max_frames; ++i) {
+    frames[copied++] = buffer[i];
+  }
+  return copied;
+}
+
+bool describe_address(void *address, char *out, u64 size) {
+  Dl_info info{};
+  if (!dladdr(address, &info) || !info.dli_fname) {
+    return false;
+  }
+  const char *module = strrchr(info.dli_fname, '/');
+  module             = module ? module + 1 : info.dli_fname;
+  if (info.dli_sname) {
+    char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, nullptr);
+    snprintf(out, size, "%s+0x%llx (%s)", demangled ? demangled : info.dli_sname,
+             (u64)((u8 *)address - (u8 *)info.dli_saddr), module);
+    ::free(demangled);
+  } else {
+    snprintf(out, size, "%s+0x%llx", module, (u64)((u8 *)address - (u8 *)info.dli_fbase));
+  }
+  return true;
+}
+
+bool map_file(const char *path, MappedFile &out_file) {
+  out_file = {};
+  int fd   = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat info{};
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    return false;
+  }
+  if (info.st_size > 0) {
+    void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    out_file.data = (const u8 *)data;
+    out_file.size = (u64)info.st_size;
+  }
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  return true;
+}
+
+void unmap_file(MappedFile &file) {
+  if (file.data) {
+    munmap((void *)file.data, file.size);
+  }
+  file = {};
+}
+
+bool open_file(const char *path, File &out_file) {
+  out_file = {};
+  int fd   = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat info{};
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    return false;
+  }
+  out_file.handle = fd;
+  out_file.size   = (u64)info.st_size;
+  return true;
+}
+
+void close_file(File &file) {
+  if (file.handle != -1) {
+    close((int)file.handle);
+  }
+  file = {};
+}
+
+i64 read_file(const File &file, u64 offset, void *buffer, u64 size) {
+  u64 done = 0;
+  while (done < size) {
+    ssize_t result =
+        pread((int)file.handle, (u8 *)buffer + done, size - done, (off_t)(offset + done));
+    if (result == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (result == 0) {
+      break;
+    }
+    done += (u64)result;
+  }
+  return (i64)done;
+}
+
+// macOS only purges the unified buffer cache as a whole (purge(8), as root).
+void evict_file_cache(const File &file) {}
+
+// No native backend: reads wait in `reads` until submitted, then run, and their results wait in
+// `results`.
+struct AsyncReaderState {
+  AsyncRead       *reads        = nullptr;
+  AsyncReadResult *results      = nullptr;
+  u32              queued       = 0;
+  u32              result_count = 0;
+};
+
+bool async_reader_create(AsyncReader &out_reader, u32 depth, bool allow_native) {
+  out_reader = {};
+  if (depth == 0) {
+    return false;
+  }
+  auto state        = new AsyncReaderState();
+  state->reads      = new AsyncRead[depth];
+  state->results    = new AsyncReadResult[depth];
+  out_reader.pState = state;
+  out_reader.depth  = depth;
+  return true;
+}
+
+void async_reader_destroy(AsyncReader &reader) {
+  auto state = (AsyncReaderState *)reader.pState;
+  if (!state) {
+    return;
+  }
+  delete[] state->reads;
+  delete[] state->results;
+  delete state;
+  reader = {};
+}
+
+bool async_read(AsyncReader &reader, const AsyncRead &read) {
+  auto state = (AsyncReaderState *)reader.pState;
+  if (state->queued + state->result_count == reader.depth) {
+    return false;
+  }
+  state->reads[state->queued++] = read;
+  return true;
+}
+
+void async_reader_submit(AsyncReader &reader) {
+  auto state = (AsyncReaderState *)reader.pState;
+  for (u32 i = 0; i < state->queued; ++i) {
+    const AsyncRead &read = state->reads[i];
+    state->results[state->result_count++] = {
+        read.user_data, read_file(read.file, read.offset, read.buffer, read.size)};
+  }
+  state->queued = 0;
+}
+
+u32 async_reader_complete(AsyncReader &reader, AsyncReadResult *out_results, u32 max_results,
+                          bool wait) {
+  auto state = (AsyncReaderState *)reader.pState;
+  u32  count = std::min(state->result_count, max_results);
+  memcpy(out_results, state->results, count * sizeof(AsyncReadResult));
+  memmove(state->results, state->results + count,
+          (state->result_count - count) * sizeof(AsyncReadResult));
+  state->result_count -= count;
+  return count;
+}
+
+void sleep(u64 ms) { sleep_us(ms * 1000); }
+
+void sleep_us(u64 us) {
+  timespec remaining{(time_t)(us / 1000000), (long)((us % 1000000) * 1000)};
+  while (nanosleep(&remaining, &remaining) == -1 && errno == EINTR) {
+  }
+}
 
 } // namespace platform
 
@@ -0,0 +1,629 @@
+#include "bvh.h"
+#include "core/log.h"
+#include "core/profile.h"
+#include <bit>
+
+namespace hn::scene {
+
+using math::Aabb;
+
+// Marks nodes on the free list.
+static const u32 free_height = 0xffffffff;
+
+// Nodes a query can have pending. Each step takes up to four and adds at most eight, so this
+// covers trees far deeper than rotations and rebuilds let them grow.
+static const u32 query_stack_size = 1024;
+
+// Bins the rebuild sorts centroids into along the split axis.
+static const u32 bin_count = 16;
+
+static bool is_leaf(const BvhNode &node) { return node.children[0] == invalid_proxy; }
+
+static bool same_bounds(const Aabb &a, const Aabb &b) {
+  return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z && a.max.x == b.max.x &&
+         a.max.y == b.max.y && a.max.z == b.max.z;
+}
+
+static u32 allocate_node(Bvh &bvh) {
+  u32 index;
+  if (bvh.free_list != invalid_proxy) {
+    index         = bvh.free_list;
+    bvh.free_list = bvh.nodes[index].parent;
+  } else {
+    index = (u32)bvh.nodes.size();
+    bvh.nodes.push_back({});
+  }
+  BvhNode &node    = bvh.nodes[index];
+  node.parent      = invalid_proxy;
+  node.children[0] = invalid_proxy;
+  node.children[1] = invalid_proxy;
+  node.item        = 0;
+  node.height      = 0;
+  node.dirty       = false;
+  return index;
+}
+
+static void free_node(Bvh &bvh, u32 index) {
+  BvhNode &node = bvh.nodes[index];
+  node.parent   = bvh.free_list;
+  node.height   = free_height;
+  bvh.free_list = index;
+}
+
+static void update_node(BvhNode *nodes, BvhNode &node) {
+  const BvhNode &a = nodes[node.children[0]];
+  const BvhNode &b = nodes[node.children[1]];
+  node.bounds      = math::merge(a.bounds, b.bounds);
+  node.height      = 1 + (a.height > b.height ? a.height : b.height);
+}
+
+// Swaps a child of the node with a grandchild under its other child when that shrinks the other
+// child's box the most (Kopta et al., "Fast, Effective BVH Updates for Animated Scenes"). The
+// node's own box stays the same.
+static void rotate(Bvh &bvh, u32 index) {
+  BvhNode *nodes = bvh.nodes.data();
+  BvhNode &node  = nodes[index];
+  if (node.height < 2) {
+    return;
+  }
+
+  f32 best_change = 0;
+  u32 best_side   = 0;
+  u32 best_slot   = 2;
+  for (u32 side = 0; side < 2; ++side) {
+    const BvhNode &child = nodes[node.children[side]];
+    const BvhNode &other = nodes[node.children[1 - side]];
+    if (is_leaf(other)) {
+      continue;
+    }
+    f32 area = math::half_area(other.bounds);
+    for (u32 slot = 0; slot < 2; ++slot) {
+      // `child` would take the place of other's child at `slot`, next to the one that stays.
+      const BvhNode &stays  = nodes[other.children[1 - slot]];
+      f32            change = math::half_area(math::merge(child.bounds, stays.bounds)) - area;
+      if (change < best_change) {
+        best_change = change;
+        best_side   = side;
+        best_slot   = slot;
+      }
+    }
+  }
+  if (best_slot == 2) {
+    return;
+  }
+
+  u32 child      = node.children[best_side];
+  u32 other      = node.children[1 - best_side];
+  u32 grandchild = nodes[other].children[best_slot];
+
+  node.children[best_side]         = grandchild;
+  nodes[other].children[best_slot] = child;
+  nodes[grandchild].parent         = index;
+  nodes[child].parent              = other;
+  nodes[other].dirty |= nodes[child].dirty;
+  update_node(nodes, nodes[other]);
+  update_node(nodes, node);
+}
+
+// Recomputes boxes and heights from the node up, rotating each, until one comes out unchanged.
+static void refit(Bvh &bvh, u32 index) {
+  while (index != invalid_proxy) {
+    BvhNode &node   = bvh.nodes[index];
+    Aabb     bounds = node.bounds;
+    u32      height = node.height;
+    update_node(bvh.nodes.data(), node);
+    rotate(bvh, index);
+    if (same_bounds(bounds, node.bounds) && height == node.height) {
+      return;
+    }
+    index = node.parent;
+  }
+}
+
+// The node to pair a new leaf with: descends while the cheapest place by surface area lies below
+// the current node, counting the growth of the boxes on the way (Box2D's branch heuristic).
+static u32 find_sibling(const Bvh &bvh, const Aabb &bounds) {
+  const BvhNode *nodes = bvh.nodes.data();
+  u32            index = bvh.root;
+  while (!is_leaf(nodes[index])) {
+    const BvhNode &node        = nodes[index];
+    f32            area        = math::half_area(node.bounds);
+    f32            combined    = math::half_area(math::merge(node.bounds, bounds));
+    f32            cost        = 2 * combined;
+    f32            inheritance = 2 * (combined - area);
+
+    f32 child_costs[2];
+    for (u32 i = 0; i < 2; ++i) {
+      const BvhNode &child    = nodes[node.children[i]];
+      f32            enlarged = math::half_area(math::merge(child.bounds, bounds));
+      child_costs[i] =
+          inheritance + (is_leaf(child) ? enlarged : enlarged - math::half_area(child.bounds));
+    }
+    if (cost < child_costs[0] && cost < child_costs[1]) {
+      break;
+    }
+    index = node.children[child_costs[0] <= child_costs[1] ? 0 : 1];
+  }
+  return index;
+}
+
+static void attach(Bvh &bvh, u32 leaf) {
+  if (bvh.root == invalid_proxy) {
+    bvh.root               = leaf;
+    bvh.nodes[leaf].parent = invalid_proxy;
+    return;
+  }
+  u32 sibling = find_sibling(bvh, bvh.nodes[leaf].bounds);
+  u32 parent  = allocate_node(bvh);
+
+  BvhNode *nodes       = bvh.nodes.data();
+  u32      grandparent = nodes[sibling].parent;
+
+  BvhNode &node    = nodes[parent];
+  node.parent      = grandparent;
+  node.children[0] = sibling;
+  node.children[1] = leaf;
+  node.dirty       = nodes[sibling].dirty;
+  update_node(nodes, node);
+  nodes[sibling].parent = parent;
+  nodes[leaf].parent    = parent;
+  if (grandparent == invalid_proxy) {
+    bvh.root = parent;
+    return;
+  }
+  BvhNode &above = nodes[grandparent];
+  above.children[above.children[0] == sibling ? 0 : 1] = parent;
+  refit(bvh, grandparent);
+}
+
+static void detach(Bvh &bvh, u32 leaf) {
+  if (leaf == bvh.root) {
+    bvh.root = invalid_proxy;
+    return;
+  }
+  BvhNode *nodes       = bvh.nodes.data();
+  u32      parent      = nodes[leaf].parent;
+  u32      grandparent = nodes[parent].parent;
+  u32      sibling     = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+  nodes[sibling].parent = grandparent;
+  nodes[leaf].parent    = invalid_proxy;
+  free_node(bvh, parent);
+  if (grandparent == invalid_proxy) {
+    bvh.root = sibling;
+    return;
+  }
+  BvhNode &node = nodes[grandparent];
+  node.children[node.children[0] == parent ? 0 : 1] = sibling;
+  refit(bvh, grandparent);
+}
+
+bool bvh_create(Bvh &out_bvh, f32 margin) {
+  out_bvh.nodes.clear();
+  out_bvh.root       = invalid_proxy;
+  out_bvh.free_list  = invalid_proxy;
+  out_bvh.leaf_count = 0;
+  out_bvh.margin     = margin;
+  return true;
+}
+
+void bvh_destroy(Bvh &bvh) {
+  bvh.nodes      = DArray<BvhNode>{mem::TagScene};
+  bvh.root       = invalid_proxy;
+  bvh.free_list  = invalid_proxy;
+  bvh.leaf_count = 0;
+}
+
+static u32 create_leaf(Bvh &bvh, const Aabb &bounds, u32 item) {
+  u32      leaf = allocate_node(bvh);
+  BvhNode &node = bvh.nodes[leaf];
+  node.bounds   = math::expand(bounds, bvh.margin);
+  node.item     = item;
+  bvh.leaf_count++;
+  return leaf;
+}
+
+ProxyId bvh_insert(Bvh &bvh, const Aabb &bounds, u32 item) {
+  u32 leaf = create_leaf(bvh, bounds, item);
+  attach(bvh, leaf);
+  return leaf;
+}
+
+void bvh_insert_bulk(Bvh &bvh, const Aabb *bounds, const u32 *items, u32 count,
+                     ProxyId *out_proxies) {
+  bvh.nodes.reserve(bvh.nodes.size() + 2 * count);
+  for (u32 i = 0; i < count; ++i) {
+    out_proxies[i] = create_leaf(bvh, bounds[i], items[i]);
+  }
+  bvh_rebuild(bvh);
+}
+
+void bvh_remove(Bvh &bvh, ProxyId proxy) {
+  detach(bvh, proxy);
+  free_node(bvh, proxy);
+  bvh.leaf_count--;
+}
+
+bool bvh_move(Bvh &bvh, ProxyId proxy, const Aabb &bounds) {
+  BvhNode &leaf = bvh.nodes[proxy];
+  if (math::contains(leaf.bounds, bounds)) {
+    return false;
+  }
+  // Refitting would stretch every ancestor towards the new place; beyond the old box it is better
+  // to find the item a new spot right away.
+  bool jumped = !math::overlaps(leaf.bounds, bounds);
+  if (jumped) {
+    detach(bvh, proxy);
+  }
+  leaf.bounds = math::expand(bounds, bvh.margin);
+  if (jumped) {
+    attach(bvh, proxy);
+    return true;
+  }
+  u32 index = leaf.parent;
+  while (index != invalid_proxy && !bvh.nodes[index].dirty) {
+    bvh.nodes[index].dirty = true;
+    index                  = bvh.nodes[index].parent;
+  }
+  return true;
+}
+
+// Refits the dirty nodes under and including this one, children first, rotating each.
+static void refit_dirty(Bvh &bvh, u32 index) {
+  BvhNode &node = bvh.nodes[index];
+  if (!node.dirty) {
+    return;
+  }
+  node.dirty = false;
+  for (u32 child : node.children) {
+    refit_dirty(bvh, child);
+  }
+  update_node(bvh.nodes.data(), node);
+  rotate(bvh, index);
+}
+
+void bvh_refit(Bvh &bvh) {
+  HN_PROFILE_FUNCTION();
+  if (bvh.root != invalid_proxy) {
+    refit_dirty(bvh, bvh.root);
+  }
+}
+
+// Builds a subtree over the leaves, which it reorders, and returns its root.
+static u32 build(Bvh &bvh, u32 *leaves, u32 count) {
+  if (count == 1) {
+    return leaves[0];
+  }
+
+  // Bin the centroids along the axis they spread the most on.
+  const BvhNode *nodes     = bvh.nodes.data();
+  math::vec3     first     = math::center(nodes[leaves[0]].bounds);
+  Aabb           centroids = {first, first};
+  for (u32 i = 1; i < count; ++i) {
+    math::vec3 c  = math::center(nodes[leaves[i]].bounds);
+    centroids.min = math::min(centroids.min, c);
+    centroids.max = math::max(centroids.max, c);
+  }
+  math::vec3 extent = centroids.max - centroids.min;
+  u32        axis   = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                          : (extent.y > extent.z ? 1 : 2);
+  f32        lowest = (&centroids.min.x)[axis];
+  f32        width  = (&extent.x)[axis];
+
+  u32 split = count / 2;
+  if (width > 0) {
+    f32  scale = bin_count / width;
+    auto bin   = [&](u32 leaf) {
+      f32 c = ((&nodes[leaf].bounds.min.x)[axis] + (&nodes[leaf].bounds.max.x)[axis]) * 0.5f;
+      u32 b = (u32)((c - lowest) * scale);
+      return b < bin_count ? b : bin_count - 1;
+    };
+
+    Aabb bounds[bin_count];
+    u32  counts[bin_count] = {};
+    for (u32 i = 0; i < count; ++i) {
+      u32 b     = bin(leaves[i]);
+      bounds[b] = counts[b]++ ? math::merge(bounds[b], nodes[leaves[i]].bounds)
+                              : nodes[leaves[i]].bounds;
+    }
+
+    // Cost of splitting after bin k: the area of each side times the leaves in it.
+    f32  right_costs[bin_count];
+    Aabb right;
+    u32  right_count = 0;
+    for (u32 k = bin_count - 1; k > 0; --k) {
+      if (counts[k]) {
+        right = right_count ? math::merge(right, bounds[k]) : bounds[k];
+        right_count += counts[k];
+      }
+      right_costs[k - 1] = right_count ? math::half_area(right) * right_count : 0;
+    }
+    f32  best_cost  = 0;
+    u32  best_split = bin_count;
+    Aabb left;
+    u32  left_count = 0;
+    for (u32 k = 0; k + 1 < bin_count; ++k) {
+      if (counts[k]) {
+        left = left_count ? math::merge(left, bounds[k]) : bounds[k];
+        left_count += counts[k];
+      }
+      if (left_count == 0 || left_count == count) {
+        continue;
+      }
+      f32 cost = math::half_area(left) * left_count + right_costs[k];
+      if (best_split == bin_count || cost < best_cost) {
+        best_cost  = cost;
+        best_split = k;
+      }
+    }
+
+    // The centroids spread over at least two bins, so some split leaves both sides non-empty.
+    u32 i = 0, j = count;
+    while (i < j) {
+      if (bin(leaves[i]) <= best_split) {
+        ++i;
+      } else {
+        u32 swap  = leaves[i];
+        leaves[i] = leaves[--j];
+        leaves[j] = swap;
+      }
+    }
+    split = i;
+  }
+
+  u32 left  = build(bvh, leaves, split);
+  u32 right = build(bvh, leaves + split, count - split);
+  u32 index = allocate_node(bvh);
+
+  BvhNode *all           = bvh.nodes.data();
+  all[index].children[0] = left;
+  all[index].children[1] = right;
+  all[left].parent       = index;
+  all[right].parent      = index;
+  update_node(all, all[index]);
+  return index;
+}
+
+void bvh_rebuild(Bvh &bvh) {
+  HN_PROFILE_FUNCTION();
+  DArray<u32> leaves{mem::TagScene};
+  leaves.reserve(bvh.leaf_count);
+  for (u32 i = 0; i < bvh.nodes.size(); ++i) {
+    const BvhNode &node = bvh.nodes[i];
+    if (node.height == free_height) {
+      continue;
+    }
+    if (is_leaf(node)) {
+      leaves.push_back(i);
+    } else {
+      free_node(bvh, i);
+    }
+  }
+  if (leaves.empty()) {
+    bvh.root = invalid_proxy;
+    return;
+  }
+  bvh.root                   = build(bvh, leaves.data(), (u32)leaves.size());
+  bvh.nodes[bvh.root].parent = invalid_proxy;
+}
+
+f32 bvh_cost(const Bvh &bvh) {
+  if (bvh.root == invalid_proxy || is_leaf(bvh.nodes[bvh.root])) {
+    return 0;
+  }
+  f32 total = 0;
+  for (const BvhNode &node : bvh.nodes) {
+    if (node.height != free_height && !is_leaf(node)) {
+      total += math::half_area(node.bounds);
+    }
+  }
+  return total / math::half_area(bvh.nodes[bvh.root].bounds);
+}
+
+// Queries: the boxes of four nodes side by side, one register per coordinate, against a test
+// that returns a bit per node that passes.
+
+#if HN_MATH_SSE
+struct NodeBatch {
+  __m128 min_x, min_y, min_z;
+  __m128 max_x, max_y, max_z;
+};
+
+static NodeBatch gather(const BvhNode *nodes, const u32 *ids) {
+  // Each box loads as (min.x, min.y, min.z, max.x) and (max.x, max.y, max.z, parent); transposing
+  // gives a register per coordinate, with the last rows left unused.
+  __m128 a0 = _mm_loadu_ps(&nodes[ids[0]].bounds.min.x);
+  __m128 a1 = _mm_loadu_ps(&nodes[ids[1]].bounds.min.x);
+  __m128 a2 = _mm_loadu_ps(&nodes[ids[2]].bounds.min.x);
+  __m128 a3 = _mm_loadu_ps(&nodes[ids[3]].bounds.min.x);
+  __m128 b0 = _mm_loadu_ps(&nodes[ids[0]].bounds.max.x);
+  __m128 b1 = _mm_loadu_ps(&nodes[ids[1]].bounds.max.x);
+  __m128 b2 = _mm_loadu_ps(&nodes[ids[2]].bounds.max.x);
+  __m128 b3 = _mm_loadu_ps(&nodes[ids[3]].bounds.max.x);
+  _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+  _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+  return {a0, a1, a2, b0, b1, b2};
+}
+
+struct BoxTest {
+  __m128 min_x, min_y, min_z;
+  __m128 max_x, max_y, max_z;
+
+  explicit BoxTest(const Aabb &box)
+      : min_x(_mm_set1_ps(box.min.x)), min_y(_mm_set1_ps(box.min.y)),
+        min_z(_mm_set1_ps(box.min.z)), max_x(_mm_set1_ps(box.max.x)),
+        max_y(_mm_set1_ps(box.max.y)), max_z(_mm_set1_ps(box.max.z)) {}
+
+  u32 operator()(const NodeBatch &n) const {
+    __m128 x = _mm_and_ps(_mm_cmple_ps(n.min_x, max_x), _mm_cmpge_ps(n.max_x, min_x));
+    __m128 y = _mm_and_ps(_mm_cmple_ps(n.min_y, max_y), _mm_cmpge_ps(n.max_y, min_y));
+    __m128 z = _mm_and_ps(_mm_cmple_ps(n.min_z, max_z), _mm_cmpge_ps(n.max_z, min_z));
+    return (u32)_mm_movemask_ps(_mm_and_ps(_mm_and_ps(x, y), z));
+  }
+};
+
+struct SphereTest {
+  __m128 x, y, z;
+  __m128 radius_squared;
+
+  SphereTest(const math::vec3 &center, f32 radius)
+      : x(_mm_set1_ps(center.x)), y(_mm_set1_ps(center.y)), z(_mm_set1_ps(center.z)),
+        radius_squared(_mm_set1_ps(radius * radius)) {}
+
+  u32 operator()(const NodeBatch &n) const {
+    // The distance from the center to the nearest point of each box.
+    __m128 dx = _mm_sub_ps(x, _mm_min_ps(_mm_max_ps(x, n.min_x), n.max_x));
+    __m128 dy = _mm_sub_ps(y, _mm_min_ps(_mm_max_ps(y, n.min_y), n.max_y));
+    __m128 dz = _mm_sub_ps(z, _mm_min_ps(_mm_max_ps(z, n.min_z), n.max_z));
+    __m128 d  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return (u32)_mm_movemask_ps(_mm_cmple_ps(d, radius_squared));
+  }
+};
+
+struct FrustumTest {
+  __m128 normal_x[6], normal_y[6], normal_z[6], distance[6];
+  bool   positive[6][3]; // Whether each normal's coordinate is >= 0.
+
+  explicit FrustumTest(const math::Frustum &frustum) {
+    for (u32 i = 0; i < 6; ++i) {
+      const math::Plane &plane = frustum.planes[i];
+      normal_x[i]              = _mm_set1_ps(plane.normal.x);
+      normal_y[i]              = _mm_set1_ps(plane.normal.y);
+      normal_z[i]              = _mm_set1_ps(plane.normal.z);
+      distance[i]              = _mm_set1_ps(plane.distance);
+      positive[i][0]           = plane.normal.x >= 0;
+      positive[i][1]           = plane.normal.y >= 0;
+      positive[i][2]           = plane.normal.z >= 0;
+    }
+  }
+
+  u32 operator()(const NodeBatch &n) const {
+    // A box is outside when its corner furthest along a plane's normal is behind it.
+    __m128 outside = _mm_setzero_ps();
+    for (u32 i = 0; i < 6; ++i) {
+      __m128 x = positive[i][0] ? n.max_x : n.min_x;
+      __m128 y = positive[i][1] ? n.max_y : n.min_y;
+      __m128 z = positive[i][2] ? n.max_z : n.min_z;
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal_x[i], x), _mm_mul_ps(normal_y[i], y)),
+                            _mm_add_ps(_mm_mul_ps(normal_z[i], z), distance[i]));
+      outside  = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+    }
+    return ~(u32)_mm_movemask_ps(outside) & 0xf;
+  }
+};
+#else
+struct NodeBatch {
+  const Aabb *boxes[4];
+};
+
+static NodeBatch gather(const BvhNode *nodes, const u32 *ids) {
+  return {{&nodes[ids[0]].bounds, &nodes[ids[1]].bounds, &nodes[ids[2]].bounds,
+           &nodes[ids[3]].bounds}};
+}
+
+struct BoxTest {
+  Aabb box;
+
+  explicit BoxTest(const Aabb &box) : box(box) {}
+
+  u32 operator()(const NodeBatch &n) const {
+    u32 hits = 0;
+    for (u32 i = 0; i < 4; ++i) {
+      hits |= (u32)math::overlaps(*n.boxes[i], box) << i;
+    }
+    return hits;
+  }
+};
+
+struct SphereTest {
+  math::vec3 center;
+  f32        radius_squared;
+
+  SphereTest(const math::vec3 &center, f32 radius)
+      : center(center), radius_squared(radius * radius) {}
+
+  u32 operator()(const NodeBatch &n) const {
+    u32 hits = 0;
+    for (u32 i = 0; i < 4; ++i) {
+      math::vec3 d = center - math::min(math::max(center, n.boxes[i]->min), n.boxes[i]->max);
+      hits |= (u32)(math::dot(d, d) <= radius_squared) << i;
+    }
+    return hits;
+  }
+};
+
+struct FrustumTest {
+  math::Frustum frustum;
+
+  explicit FrustumTest(const math::Frustum &frustum) : frustum(frustum) {}
+
+  u32 operator()(const NodeBatch &n) const {
+    u32 hits = 0;
+    for (u32 i = 0; i < 4; ++i) {
+      const Aabb &box     = *n.boxes[i];
+      bool        outside = false;
+      for (const math::Plane &plane : frustum.planes) {
+        math::vec3 corner = {plane.normal.x >= 0 ? box.max.x : box.min.x,
+                             plane.normal.y >= 0 ? box.max.y : box.min.y,
+                             plane.normal.z >= 0 ? box.max.z : box.min.z};
+        outside |= math::dot(plane.normal, corner) + plane.distance < 0;
+      }
+      hits |= (u32)!outside << i;
+    }
+    return hits;
+  }
+};
+#endif
+
+// Depth-first traversal, taking up to four pending nodes per test.
+template <typename Test>
+static u32 query(const Bvh &bvh, const Test &test, u32 *out_items, u32 max_items) {
+  if (bvh.root == invalid_proxy) {
+    return 0;
+  }
+  const BvhNode *nodes = bvh.nodes.data();
+  u32            stack[query_stack_size];
+  u32            top   = 0;
+  u32            found = 0;
+  stack[top++]         = bvh.root;
+  while (top) {
+    // Short batches repeat a node; their extra lanes are masked off.
+    u32 lanes = top < 4 ? top : 4;
+    u32 ids[4];
+    for (u32 i = 0; i < 4; ++i) {
+      ids[i] = stack[top - 1 - (i < lanes ? i : 0)];
+    }
+    top -= lanes;
+
+    for (u32 hits = test(gather(nodes, ids)) & ((1u << lanes) - 1); hits; hits &= hits - 1) {
+      const BvhNode &node = nodes[ids[std::countr_zero(hits)]];
+      if (is_leaf(node)) {
+        if (found < max_items) {
+          out_items[found] = node.item;
+        }
+        found++;
+      } else if (top + 2 <= query_stack_size) {
+        stack[top++] = node.children[0];
+        stack[top++] = node.children[1];
+      } else {
+        HN_error("BVH query stack overflow; results are incomplete.");
+      }
+    }
+  }
+  return found;
+}
+
+u32 bvh_query_box(const Bvh &bvh, const Aabb &box, u32 *out_items, u32 max_items) {
+  return query(bvh, BoxTest(box), out_items, max_items);
+}
+
+u32 bvh_query_sphere(const Bvh &bvh, const math::vec3 &center, f32 radius, u32 *out_items,
+                     u32 max_items) {
+  return query(bvh, SphereTest(center, radius), out_items, max_items);
+}
+
+u32 bvh_query_frustum(const Bvh &bvh, const math::Frustum &frustum, u32 *out_items,
+                      u32 max_items) {
+  return query(bvh, FrustumTest(frustum), out_items, max_items);
+}
+
+} // namespace hn::scene
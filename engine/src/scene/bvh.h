@@ -0,0 +1,99 @@
+#pragma once
+
+#include "container/darray_t.h"
+#include "defines.h"
+#include "math/bounds.h"
+
+namespace hn::scene {
+
+// Dynamic bounding volume hierarchy: a binary tree of axis-aligned boxes over caller items, for
+// visibility and proximity queries. Leaves hold each item's bounds enlarged by a margin, so small
+// movements cost nothing. Larger ones mark the leaf's ancestors for refitting, which bvh_refit
+// does once per frame for all of them, rotating subtrees along the way to keep the tree tight;
+// items that jump are reinserted at once. bvh_rebuild rebuilds the whole tree with the surface
+// area heuristic, for bulk loads or after quality has drifted.
+// Queries test four nodes at a time with SSE and write into caller arrays without allocating.
+
+// Identifies an item in the tree; stable until the item is removed, including across rebuilds.
+typedef u32 ProxyId;
+
+const ProxyId invalid_proxy = 0xffffffff;
+
+// Distance leaves reach beyond their item's bounds unless configured otherwise.
+const f32 default_margin = 0.1f;
+
+struct BvhNode {
+  math::Aabb bounds;      // Leaves: the item's bounds plus the margin.
+  u32        parent;      // invalid_proxy for the root; the next free node while free.
+  u32        children[2]; // invalid_proxy for leaves.
+  u32        item;        // Leaves: the caller's value.
+  u32        height;      // 0 for leaves.
+  bool       dirty;       // Needs refitting; so do all its ancestors.
+};
+
+struct Bvh {
+  DArray<BvhNode> nodes{mem::TagScene};
+  u32             root       = invalid_proxy;
+  u32             free_list  = invalid_proxy;
+  u32             leaf_count = 0;
+  f32             margin     = default_margin;
+};
+
+bool bvh_create(Bvh &out_bvh, f32 margin = default_margin);
+void bvh_destroy(Bvh &bvh);
+
+/**
+ * Adds an item.
+ * @param bounds The item's bounds.
+ * @param item A value handed back by queries, e.g. an entity index.
+ * @returns The item's proxy.
+ */
+ProxyId bvh_insert(Bvh &bvh, const math::Aabb &bounds, u32 item);
+
+/**
+ * Adds many items at once, then rebuilds the tree: faster than inserting one by one, and a
+ * better tree.
+ * @param out_proxies Receives the `count` new proxies.
+ */
+void bvh_insert_bulk(Bvh &bvh, const math::Aabb *bounds, const u32 *items, u32 count,
+                     ProxyId *out_proxies);
+
+void bvh_remove(Bvh &bvh, ProxyId proxy);
+
+/**
+ * Updates an item's bounds. Ancestors are refitted by the next bvh_refit; until then queries may
+ * miss the item at its new place.
+ * @returns False if they still fit the leaf, which then is left as is; otherwise true.
+ */
+bool bvh_move(Bvh &bvh, ProxyId proxy, const math::Aabb &bounds);
+
+// Refits the boxes bvh_move left stale and rotates them. Call after the frame's moves, before
+// querying.
+void bvh_refit(Bvh &bvh);
+
+// Rebuilds the tree top-down with the binned surface area heuristic. Proxies stay valid.
+void bvh_rebuild(Bvh &bvh);
+
+/**
+ * The tree's surface area cost: the area of every internal node relative to the root's. Lower is
+ * better; comparing it to its value right after a rebuild tells when to rebuild again.
+ */
+f32 bvh_cost(const Bvh &bvh);
+
+inline u32 bvh_get_item(const Bvh &bvh, ProxyId proxy) { return bvh.nodes[proxy].item; }
+
+// Queries. Each writes the items it finds to `out_items`, at most `max_items` of them, and
+// returns how many it found in total, which may be more.
+
+// Items whose leaf overlaps the box.
+u32 bvh_query_box(const Bvh &bvh, const math::Aabb &box, u32 *out_items, u32 max_items);
+
+// Items whose leaf comes within `radius` of `center`.
+u32 bvh_query_sphere(const Bvh &bvh, const math::vec3 &center, f32 radius, u32 *out_items,
+                     u32 max_items);
+
+// Items whose leaf is at least partly inside the frustum.
+u32 bvh_query_frustum(const Bvh &bvh, const math::Frustum &frustum, u32 *out_items,
+                      u32 max_items);
+
+} // namespace hn::scene
@@ -0,0 +1,172 @@
+#include <container/darray_t.h>
+#include <core/log.h>
+#include <core/memory.h>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+// Decodes a binary log written with --binary-log into text, one message per line:
+//   log_decode <file>
+
+using namespace hn;
+
+// String definitions by id, each an offset into the character storage. Open addressing.
+struct StringTable {
+  DArray<u64>  ids;
+  DArray<u64>  offsets;
+  DArray<char> characters;
+  u64          count = 0;
+
+  StringTable() {
+    ids.resize(1024);
+    offsets.resize(1024);
+  }
+
+  void grow() {
+    DArray<u64> old_ids     = std::move(ids);
+    DArray<u64> old_offsets = std::move(offsets);
+    ids.resize(old_ids.size() * 2);
+    offsets.resize(old_ids.size() * 2);
+    count = 0;
+    for (u64 i = 0; i < old_ids.size(); ++i) {
+      if (old_ids[i]) {
+        insert(old_ids[i], old_offsets[i]);
+      }
+    }
+  }
+
+  void insert(u64 id, u64 offset) {
+    if ((count + 1) * 2 > ids.size()) {
+      grow();
+    }
+    u64 mask = ids.size() - 1;
+    for (u64 slot = (id * 0x9e3779b97f4a7c15ull >> 32) & mask;; slot = (slot + 1) & mask) {
+      if (ids[slot] == id || ids[slot] == 0) {
+        count += ids[slot] == 0;
+        ids[slot]     = id;
+        offsets[slot] = offset;
+        return;
+      }
+    }
+  }
+
+  const char *find(u64 id) const {
+    u64 mask = ids.size() - 1;
+    for (u64 slot = (id * 0x9e3779b97f4a7c15ull >> 32) & mask; ids[slot];
+         slot     = (slot + 1) & mask) {
+      if (ids[slot] == id) {
+        return characters.data() + offsets[slot];
+      }
+    }
+    return "?";
+  }
+};
+
+// Sequential reads from the file contents; reads past the end fail and stick.
+struct Reader {
+  const u8 *data;
+  u64       size;
+  u64       offset = 0;
+  bool      ok     = true;
+
+  bool read(void *out, u64 bytes) {
+    if (!ok || offset + bytes > size) {
+      ok = false;
+      return false;
+    }
+    memcpy(out, data + offset, bytes);
+    offset += bytes;
+    return true;
+  }
+
+  const u8 *skip(u64 bytes) {
+    if (!ok || offset + bytes > size) {
+      ok = false;
+      return nullptr;
+    }
+    const u8 *start = data + offset;
+    offset += bytes;
+    return start;
+  }
+};
+
+static const char *level_names[] = {"[D]", "[I]", "[W]", "[E]", "[F]"};
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <binary log>\n", argv[0]);
+    return 1;
+  }
+  FILE *file = fopen(argv[1], "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s.\n", argv[1]);
+    return 1;
+  }
+  mem::initialize();
+
+  DArray<u8> contents;
+  u8         chunk[64 * 1024];
+  for (u64 read; (read = fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+    contents.append(chunk, read);
+  }
+  fclose(file);
+
+  Reader reader{contents.data(), contents.size()};
+  u32    magic   = 0;
+  u32    version = 0;
+  if (!reader.read(&magic, sizeof(magic)) || !reader.read(&version, sizeof(version)) ||
+      magic != log::binary_magic || version != log::binary_version) {
+    fprintf(stderr, "%s is not a binary log of version %u.\n", argv[1], log::binary_version);
+    return 2;
+  }
+
+  StringTable strings;
+  char        message[log::max_message_length];
+  u64         start = 0;
+  u64         count = 0;
+  u8          entry;
+  while (reader.offset < reader.size && reader.read(&entry, sizeof(entry))) {
+    if (entry == log::BinaryString) {
+      u64 id;
+      u32 length;
+      reader.read(&id, sizeof(id));
+      reader.read(&length, sizeof(length));
+      const u8 *characters = reader.skip(length);
+      if (!characters) {
+        break;
+      }
+      strings.insert(id, strings.characters.size());
+      strings.characters.append((const char *)characters, length);
+      strings.characters.push_back('\0');
+    } else if (entry == log::BinaryRecord) {
+      u64 timestamp;
+      u8  level;
+      u32 line;
+      u64 ids[3];
+      u16 args_size;
+      reader.read(&timestamp, sizeof(timestamp));
+      reader.read(&level, sizeof(level));
+      reader.read(&line, sizeof(line));
+      reader.read(ids, sizeof(ids));
+      reader.read(&args_size, sizeof(args_size));
+      const u8 *args = reader.skip(args_size);
+      if (!args) {
+        break;
+      }
+      if (count++ == 0) {
+        start = timestamp;
+      }
+      log::format_arguments(message, sizeof(message), strings.find(ids[2]), args, args_size);
+      u32 level_index = level <= (u32)log::LevelFatal ? (u32)level : (u32)log::LevelFatal;
+      printf("%12.6f %s %s:%s:%u %s\n", (f64)(timestamp - start) / 1000000000.0,
+             level_names[level_index], strings.find(ids[0]), strings.find(ids[1]), line, message);
+    } else {
+      fprintf(stderr, "Unknown entry type %u at offset %llu.\n", entry, reader.offset - 1);
+      return 2;
+    }
+  }
+  if (!reader.ok) {
+    fprintf(stderr, "The log ends mid-entry; it may have been cut short.\n");
+  }
+  return 0;
+}